@@ -0,0 +1,523 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <functional>
+
+#define DEQUAN_USE_STDVECTOR
+#define DEQUAN_WITH_STATS
+#define DEQUAN_IMPLEMENTATION
+// Room for the table of BinaryTableConstraint
+#include "../dequan.h"
+
+/**
+ * Benchmark suite of standard CSP families at several sizes.
+ * Each instance is solved several times, and the median time is reported with node counts and search stats as JSON or CSV.
+ * Usage: dequan_bench [--csv] [--repeat N] [--filter substring] [--profile] [--presolve]
+ * --profile prints the propagation counters of each constraint kind on stderr, build with -DDEQUAN_WITH_CYCLE_STATS to also get cycles.
+ * --presolve finalizes the models with CSP::Presolve().
+ */
+
+/** Job-shop disjunction, tasks of durations d0 and d1 can't overlap : v0 + d0 <= v1 || v1 + d1 <= v0 */
+struct DisjunctiveConstraint : public dequan::Constraint
+{
+    DisjunctiveConstraint(dequan::VarId _v0, dequan::VarId _v1, int _d0, int _d1) : v0(_v0), v1(_v1), d0(_d0), d1(_d1) {}
+    virtual void LinkVars(dequan::Array<dequan::VarId>& linked_vars) const
+    {
+        linked_vars.push_back(v0);
+        linked_vars.push_back(v1);
+    }
+    virtual Eval Evaluate(const dequan::Array<dequan::InstVar>& inst_vars, dequan::VarId last_assigned_vid, int last_assigned_pos)
+    {
+        if (inst_vars[v0].value == dequan::InstVar::UNASSIGNED || inst_vars[v1].value == dequan::InstVar::UNASSIGNED)
+        {
+            return Eval::NA;
+        }
+        return (inst_vars[v0].value + d0 <= inst_vars[v1].value || inst_vars[v1].value + d1 <= inst_vars[v0].value) ? Eval::Passed : Eval::Failed;
+    }
+    virtual bool AplyArcConsistency(dequan::Assignment& a, dequan::VarId last_assigned_vid, int last_assigned_pos)
+    {
+        const dequan::Domain& dom0 = a.current_domains[v0];
+        const dequan::Domain& dom1 = a.current_domains[v1];
+        bool v0_first = (long long)dom0.Min() + d0 <= dom1.Max();
+        bool v1_first = (long long)dom1.Min() + d1 <= dom0.Max();
+        if (!v0_first && !v1_first)
+        {
+            return false;
+        }
+        if (!v0_first)
+        {
+            // v1 must come before v0
+            return a.ExcludeVarInf(v0, (long long)dom1.Min() + d1) && a.ExcludeVarSup(v1, (long long)dom0.Max() - d1 + 1);
+        }
+        if (!v1_first)
+        {
+            return a.ExcludeVarInf(v1, (long long)dom0.Min() + d0) && a.ExcludeVarSup(v0, (long long)dom1.Max() - d0 + 1);
+        }
+        return true;
+    }
+    virtual int GetWakeEvents() const { return EVENT_BOUNDS; }
+
+    dequan::VarId v0, v1;
+    int d0, d1;
+};
+
+/** Binary extensional constraint over [0, dom_size) values, allowed[val0 * dom_size + val1] != 0 for allowed pairs */
+struct BinaryTableConstraint : public dequan::Constraint
+{
+    BinaryTableConstraint(dequan::VarId _v0, dequan::VarId _v1, int _dom_size, const dequan::Array<int>& _allowed) : v0(_v0), v1(_v1), dom_size(_dom_size), allowed(_allowed) {}
+    virtual void LinkVars(dequan::Array<dequan::VarId>& linked_vars) const
+    {
+        linked_vars.push_back(v0);
+        linked_vars.push_back(v1);
+    }
+    virtual Eval Evaluate(const dequan::Array<dequan::InstVar>& inst_vars, dequan::VarId last_assigned_vid, int last_assigned_pos)
+    {
+        if (inst_vars[v0].value == dequan::InstVar::UNASSIGNED || inst_vars[v1].value == dequan::InstVar::UNASSIGNED)
+        {
+            return Eval::NA;
+        }
+        return IsAllowed(inst_vars[v0].value, inst_vars[v1].value) ? Eval::Passed : Eval::Failed;
+    }
+    virtual bool AplyArcConsistency(dequan::Assignment& a, dequan::VarId last_assigned_vid, int last_assigned_pos)
+    {
+        return Revise(a, v0, v1, false) && Revise(a, v1, v0, true);
+    }
+    virtual int GetWakeEvents() const { return EVENT_DOMAIN; }
+
+    bool IsAllowed(int val0, int val1) const
+    {
+        return allowed[val0 * dom_size + val1] != 0;
+    }
+    /** Remove values of 'vid' without support in 'oth_vid' */
+    bool Revise(dequan::Assignment& a, dequan::VarId vid, dequan::VarId oth_vid, bool reversed)
+    {
+        const dequan::Domain& dom = a.current_domains[vid];
+        const dequan::Domain& oth_dom = a.current_domains[oth_vid];
+        int val = dom.Min();
+        for (bool has_val = true; has_val; has_val = dom.NextValue(val, val))
+        {
+            bool supported = false;
+            int oth_val = oth_dom.Min();
+            for (bool has_oth = true; has_oth && !supported; has_oth = oth_dom.NextValue(oth_val, oth_val))
+            {
+                supported = reversed ? IsAllowed(oth_val, val) : IsAllowed(val, oth_val);
+            }
+            if (!supported && !a.ExcludeVar(vid, val))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    dequan::VarId v0, v1;
+    int dom_size;
+    dequan::Array<int> allowed;
+};
+
+struct BenchInstance
+{
+    std::string family;
+    std::string name;
+    int size = 0;
+    std::function<void(dequan::CSP&)> build;
+    dequan::SearchParams params;
+    /** Count all solutions instead of looking for the first one */
+    bool count_solutions = false;
+    /** Node budget of one run, zero for unlimited */
+    unsigned long long max_nodes = 0;
+};
+
+struct BenchResult
+{
+    double median_seconds = 0.0;
+    double min_seconds = 0.0;
+    unsigned long long nodes = 0;
+    unsigned long long solutions = 0;
+    const char* status = "";
+    dequan::Stats stats;
+    dequan::ConstraintStats kind_stats[dequan::CONSTRAINT_KIND_COUNT];
+};
+
+void BuildNQueens(dequan::CSP& csp, int num_queen)
+{
+    dequan::Array<dequan::VarId> qvars(num_queen);
+    for (int i = 0; i < num_queen; i++)
+    {
+        qvars[i] = csp.AddIntVar(0, num_queen);
+    }
+    for (int i = 0; i < num_queen; i++)
+    {
+        for (int j = i + 1; j < num_queen; j++)
+        {
+            csp.AddConstraint(dequan::OpConstraint(qvars[i], qvars[j], dequan::OpConstraint::Op::NotEqual, 0));
+            csp.AddConstraint(dequan::OpConstraint(qvars[i], qvars[j], dequan::OpConstraint::Op::NotEqual, j - i));
+            csp.AddConstraint(dequan::OpConstraint(qvars[i], qvars[j], dequan::OpConstraint::Op::NotEqual, i - j));
+        }
+    }
+}
+
+/** 9x9 sudoku with row, column and box all different constraints, 'grid' lists the 81 cells with '0' for empty ones */
+void BuildSudoku(dequan::CSP& csp, const char* grid, dequan::AllDifferentConstraint::Filtering filtering)
+{
+    const int num_row = 9;
+    dequan::Array<dequan::VarId> vars(num_row * num_row);
+    for (int c_idx = 0; c_idx < num_row * num_row; c_idx++)
+    {
+        int val = grid[c_idx] - '0';
+        vars[c_idx] = val == 0 ? csp.AddIntVar(1, num_row + 1) : csp.AddFixedVar(val);
+    }
+
+    dequan::Array<dequan::VarId> row_vars, col_vars, box_vars;
+    for (int g_idx = 0; g_idx < num_row; g_idx++)
+    {
+        row_vars.clear();
+        col_vars.clear();
+        box_vars.clear();
+        for (int i = 0; i < num_row; i++)
+        {
+            row_vars.push_back(vars[g_idx * num_row + i]);
+            col_vars.push_back(vars[i * num_row + g_idx]);
+            box_vars.push_back(vars[((g_idx / 3) * 3 + i / 3) * num_row + (g_idx % 3) * 3 + i % 3]);
+        }
+        csp.AddConstraint(dequan::AllDifferentConstraint(row_vars, filtering));
+        csp.AddConstraint(dequan::AllDifferentConstraint(col_vars, filtering));
+        csp.AddConstraint(dequan::AllDifferentConstraint(box_vars, filtering));
+    }
+}
+
+/** Random graph with 'num_nodes' nodes and edge probability 'density' (in percent), to color with 'num_colors' colors */
+void BuildGraphColoring(dequan::CSP& csp, int num_nodes, int density, int num_colors, unsigned int seed)
+{
+    dequan::Random random(seed);
+    dequan::Array<dequan::VarId> vars(num_nodes);
+    for (int i = 0; i < num_nodes; i++)
+    {
+        vars[i] = csp.AddIntVar(0, num_colors);
+    }
+    for (int i = 0; i < num_nodes; i++)
+    {
+        for (int j = i + 1; j < num_nodes; j++)
+        {
+            if ((int)random.Next(100) < density)
+            {
+                csp.AddConstraint(dequan::OpConstraint(vars[i], vars[j], dequan::OpConstraint::Op::NotEqual, 0));
+            }
+        }
+    }
+}
+
+/**
+ * Random job-shop of 'num_jobs' jobs going through all 'num_machines' machines in a random order, with durations in [1, 9].
+ * Decision version: all tasks must end before 'slack_percent' percent of the trivial lower bound of the makespan.
+ */
+void BuildJobShop(dequan::CSP& csp, int num_jobs, int num_machines, int slack_percent, unsigned int seed)
+{
+    dequan::Random random(seed);
+    dequan::Array<int> machines(num_jobs * num_machines), durations(num_jobs * num_machines);
+    dequan::Array<int> job_lengths(num_jobs, 0), machine_loads(num_machines, 0);
+    for (int j = 0; j < num_jobs; j++)
+    {
+        for (int m = 0; m < num_machines; m++)
+        {
+            machines[j * num_machines + m] = m;
+        }
+        for (int m = num_machines - 1; m > 0; m--)
+        {
+            int swap_idx = (int)random.Next((unsigned int)m + 1);
+            std::swap(machines[j * num_machines + m], machines[j * num_machines + swap_idx]);
+        }
+        for (int m = 0; m < num_machines; m++)
+        {
+            int duration = 1 + (int)random.Next(9);
+            durations[j * num_machines + m] = duration;
+            job_lengths[j] += duration;
+            machine_loads[machines[j * num_machines + m]] += duration;
+        }
+    }
+    int lower_bound = 0;
+    for (int j = 0; j < num_jobs; j++)
+    {
+        lower_bound = std::max(lower_bound, job_lengths[j]);
+    }
+    for (int m = 0; m < num_machines; m++)
+    {
+        lower_bound = std::max(lower_bound, machine_loads[m]);
+    }
+    int horizon = lower_bound * slack_percent / 100;
+
+    dequan::Array<dequan::VarId> starts(num_jobs * num_machines);
+    for (int t_idx = 0; t_idx < num_jobs * num_machines; t_idx++)
+    {
+        starts[t_idx] = csp.AddIntVar(0, horizon - durations[t_idx] + 1);
+    }
+    for (int j = 0; j < num_jobs; j++)
+    {
+        for (int m = 0; m + 1 < num_machines; m++)
+        {
+            int t_idx = j * num_machines + m;
+            csp.AddConstraint(dequan::OpConstraint(starts[t_idx + 1], starts[t_idx], dequan::OpConstraint::Op::SupEqual, durations[t_idx]));
+        }
+    }
+    for (int t0 = 0; t0 < num_jobs * num_machines; t0++)
+    {
+        for (int t1 = t0 + 1; t1 < num_jobs * num_machines; t1++)
+        {
+            if (machines[t0] == machines[t1])
+            {
+                csp.AddConstraint(DisjunctiveConstraint(starts[t0], starts[t1], durations[t0], durations[t1]));
+            }
+        }
+    }
+}
+
+/** Random binary CSP <n, d, p1, p2>: 'density' percent of var pairs are constrained, each forbidding 'tightness' percent of value pairs */
+void BuildRandomBinary(dequan::CSP& csp, int num_vars, int dom_size, int density, int tightness, unsigned int seed)
+{
+    dequan::Random random(seed);
+    dequan::Array<dequan::VarId> vars(num_vars);
+    for (int i = 0; i < num_vars; i++)
+    {
+        vars[i] = csp.AddIntVar(0, dom_size);
+    }
+    for (int i = 0; i < num_vars; i++)
+    {
+        for (int j = i + 1; j < num_vars; j++)
+        {
+            if ((int)random.Next(100) >= density)
+            {
+                continue;
+            }
+            dequan::Array<int> allowed(dom_size * dom_size);
+            for (int p_idx = 0; p_idx < dom_size * dom_size; p_idx++)
+            {
+                allowed[p_idx] = (int)random.Next(100) >= tightness ? 1 : 0;
+            }
+            csp.AddConstraint(BinaryTableConstraint(vars[i], vars[j], dom_size, allowed));
+        }
+    }
+}
+
+dequan::SearchParams MakeParams(dequan::VarHeuristic var_heuristic)
+{
+    dequan::SearchParams params;
+    params.var_heuristic = var_heuristic;
+    return params;
+}
+
+dequan::Array<BenchInstance> MakeInstances()
+{
+    dequan::Array<BenchInstance> instances;
+    auto Add = [&instances](const std::string& family, const std::string& name, int size, std::function<void(dequan::CSP&)> build,
+        dequan::VarHeuristic var_heuristic, bool count_solutions, unsigned long long max_nodes)
+    {
+        BenchInstance instance;
+        instance.family = family;
+        instance.name = name;
+        instance.size = size;
+        instance.build = build;
+        instance.params = MakeParams(var_heuristic);
+        instance.count_solutions = count_solutions;
+        instance.max_nodes = max_nodes;
+        instances.push_back(instance);
+    };
+
+    for (int n : { 8, 10 })
+    {
+        Add("nqueens", "nqueens-count-" + std::to_string(n), n, [n](dequan::CSP& csp) { BuildNQueens(csp, n); }, dequan::VarHeuristic::Static, true, 0);
+    }
+    for (int n : { 30, 60, 100 })
+    {
+        Add("nqueens", "nqueens-solve-" + std::to_string(n), n, [n](dequan::CSP& csp) { BuildNQueens(csp, n); }, dequan::VarHeuristic::Dom, false, 1000000);
+    }
+
+    struct SudokuGrid { const char* name; const char* grid; };
+    static const SudokuGrid sudoku_grids[] =
+    {
+        { "easy", "003020600900305001001806400008102900700000008006708200002609500800203009005010300" },
+        { "escargot", "100007090030020008009600500005300900010080002600004000300000010040000007007000300" },
+        { "inkala", "800000000003600000070090200050007000000045700000100030001000068008500010090000400" },
+    };
+    for (const SudokuGrid& sudoku : sudoku_grids)
+    {
+        const char* grid = sudoku.grid;
+        Add("sudoku", std::string("sudoku-") + sudoku.name + "-value", 9,
+            [grid](dequan::CSP& csp) { BuildSudoku(csp, grid, dequan::AllDifferentConstraint::Filtering::Value); }, dequan::VarHeuristic::Dom, false, 1000000);
+        Add("sudoku", std::string("sudoku-") + sudoku.name + "-domain", 9,
+            [grid](dequan::CSP& csp) { BuildSudoku(csp, grid, dequan::AllDifferentConstraint::Filtering::Domain); }, dequan::VarHeuristic::Dom, false, 1000000);
+    }
+
+    struct ColoringSize { int num_nodes, density, num_colors; };
+    for (ColoringSize c : { ColoringSize{ 40, 30, 5 }, ColoringSize{ 60, 20, 5 }, ColoringSize{ 100, 12, 5 } })
+    {
+        Add("coloring", "coloring-" + std::to_string(c.num_nodes) + "-" + std::to_string(c.density) + "-" + std::to_string(c.num_colors), c.num_nodes,
+            [c](dequan::CSP& csp) { BuildGraphColoring(csp, c.num_nodes, c.density, c.num_colors, 1234); }, dequan::VarHeuristic::DomWDeg, false, 200000);
+    }
+
+    for (int n : { 4, 6, 8 })
+    {
+        Add("jobshop", "jobshop-" + std::to_string(n) + "x" + std::to_string(n), n,
+            [n](dequan::CSP& csp) { BuildJobShop(csp, n, n, 125, 4321); }, dequan::VarHeuristic::DomWDeg, false, 200000);
+    }
+
+    struct RandomSize { int num_vars, dom_size, density, tightness; };
+    for (RandomSize r : { RandomSize{ 30, 8, 30, 35 }, RandomSize{ 50, 10, 15, 45 }, RandomSize{ 60, 10, 15, 40 } })
+    {
+        Add("random", "random-" + std::to_string(r.num_vars) + "-" + std::to_string(r.dom_size) + "-" + std::to_string(r.density) + "-" + std::to_string(r.tightness), r.num_vars,
+            [r](dequan::CSP& csp) { BuildRandomBinary(csp, r.num_vars, r.dom_size, r.density, r.tightness, 5678); }, dequan::VarHeuristic::DomWDeg, false, 200000);
+    }
+
+    return instances;
+}
+
+BenchResult RunInstance(const BenchInstance& instance, int repeat_count, bool presolve)
+{
+    dequan::CSP csp;
+    instance.build(csp);
+    csp.FinalizeModel(presolve);
+
+    BenchResult result;
+    dequan::Array<double> times;
+    for (int r_idx = 0; r_idx < repeat_count; r_idx++)
+    {
+        dequan::Assignment a;
+        a.params = instance.params;
+        a.Reset(csp);
+
+        auto t1 = std::chrono::high_resolution_clock::now();
+        if (instance.count_solutions)
+        {
+            result.solutions = csp.CountSolutions(a);
+            result.status = "counted";
+        }
+        else
+        {
+            dequan::SearchBudget budget;
+            budget.max_nodes = instance.max_nodes;
+            dequan::SearchStatus status = csp.Solve(a, budget);
+            result.solutions = status == dequan::SearchStatus::Solved ? 1 : 0;
+            result.status = status == dequan::SearchStatus::Solved ? "solved" : (status == dequan::SearchStatus::Infeasible ? "infeasible" : "paused");
+        }
+        auto t2 = std::chrono::high_resolution_clock::now();
+
+        times.push_back(std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count());
+        // Runs are deterministic, counters of the last one stand for all of them
+        result.nodes = a.search_nodes;
+        result.stats = a.stats;
+        for (int k_idx = 0; k_idx < dequan::CONSTRAINT_KIND_COUNT; k_idx++)
+        {
+            result.kind_stats[k_idx] = a.stats.GetKindStats(csp, (dequan::ConstraintKind)k_idx);
+        }
+    }
+
+    std::sort(times.begin(), times.end());
+    size_t mid_idx = times.size() / 2;
+    result.median_seconds = times.size() % 2 ? times[mid_idx] : 0.5 * (times[mid_idx - 1] + times[mid_idx]);
+    result.min_seconds = times[0];
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    bool csv_output = false;
+    int repeat_count = 5;
+    const char* filter = nullptr;
+    bool profile = false;
+    bool presolve = false;
+    for (int arg_idx = 1; arg_idx < argc; arg_idx++)
+    {
+        if (strcmp(argv[arg_idx], "--csv") == 0)
+        {
+            csv_output = true;
+        }
+        else if (strcmp(argv[arg_idx], "--json") == 0)
+        {
+            csv_output = false;
+        }
+        else if (strcmp(argv[arg_idx], "--repeat") == 0 && arg_idx + 1 < argc)
+        {
+            repeat_count = std::max(1, atoi(argv[++arg_idx]));
+        }
+        else if (strcmp(argv[arg_idx], "--filter") == 0 && arg_idx + 1 < argc)
+        {
+            filter = argv[++arg_idx];
+        }
+        else if (strcmp(argv[arg_idx], "--profile") == 0)
+        {
+            profile = true;
+        }
+        else if (strcmp(argv[arg_idx], "--presolve") == 0)
+        {
+            presolve = true;
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0] << " [--csv | --json] [--repeat N] [--filter substring] [--profile] [--presolve]\n";
+            return 1;
+        }
+    }
+
+    if (csv_output)
+    {
+        std::cout << "family,name,size,status,solutions,repeat,median_seconds,min_seconds,nodes,nodes_per_second,applied_arcs,validated_constraints,assigned_vars\n";
+    }
+    else
+    {
+        std::cout << "[\n";
+    }
+
+    bool first_result = true;
+    dequan::Array<BenchInstance> instances = MakeInstances();
+    for (const BenchInstance& instance : instances)
+    {
+        if (filter != nullptr && instance.name.find(filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        BenchResult result = RunInstance(instance, repeat_count, presolve);
+        double nodes_per_second = result.median_seconds > 0.0 ? (double)result.nodes / result.median_seconds : 0.0;
+        if (csv_output)
+        {
+            std::cout << instance.family << "," << instance.name << "," << instance.size << "," << result.status << "," << result.solutions << ","
+                << repeat_count << "," << result.median_seconds << "," << result.min_seconds << "," << result.nodes << "," << nodes_per_second << ","
+                << result.stats.applied_arcs << "," << result.stats.validated_constraints << "," << result.stats.assigned_vars << "\n";
+        }
+        else
+        {
+            std::cout << (first_result ? "" : ",\n")
+                << "  { \"family\": \"" << instance.family << "\", \"name\": \"" << instance.name << "\", \"size\": " << instance.size
+                << ", \"status\": \"" << result.status << "\", \"solutions\": " << result.solutions << ", \"repeat\": " << repeat_count
+                << ", \"median_seconds\": " << result.median_seconds << ", \"min_seconds\": " << result.min_seconds
+                << ", \"nodes\": " << result.nodes << ", \"nodes_per_second\": " << nodes_per_second
+                << ", \"stats\": { \"applied_arcs\": " << result.stats.applied_arcs << ", \"validated_constraints\": " << result.stats.validated_constraints
+                << ", \"assigned_vars\": " << result.stats.assigned_vars << " } }";
+        }
+        std::cout.flush();
+        first_result = false;
+
+        if (profile)
+        {
+            std::cerr << instance.name << "\n";
+            for (int k_idx = 0; k_idx < dequan::CONSTRAINT_KIND_COUNT; k_idx++)
+            {
+                const dequan::ConstraintStats& kind_stats = result.kind_stats[k_idx];
+                if (kind_stats.propagations == 0 && kind_stats.validations == 0)
+                {
+                    continue;
+                }
+                std::cerr << "  " << dequan::GetConstraintKindName((dequan::ConstraintKind)k_idx) << " : propagations " << kind_stats.propagations
+                    << ", prunings " << kind_stats.prunings << ", wipeouts " << kind_stats.wipeouts << ", validations " << kind_stats.validations
+                    << ", violations " << kind_stats.violations << ", cycles " << kind_stats.cycles << "\n";
+            }
+        }
+    }
+
+    if (!csv_output)
+    {
+        std::cout << "\n]\n";
+    }
+    return 0;
+}
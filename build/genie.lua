@@ -38,6 +38,37 @@ solution "dequan_test"
 		configuration "macosx"
 			SetTarget( "Debug", "native" )
 			SetTarget( "Release", "native" )
+
+		configuration "linux"
+			links { "pthread" }
+			
+		configuration "Debug"
+			defines { "_DEBUG" }
+			flags { "Symbols" }
+ 
+		configuration "Release"
+			defines { "NDEBUG" }
+			flags { "Optimize", "Symbols" }
+	project "dequan_bench"
+		kind "ConsoleApp"
+		language "C++"
+		
+		files
+		{
+			path.join(PROJ_DIR, "dequan.h"),
+			path.join(PROJ_DIR, "bench/*.cpp"),
+		}
+		
+		configuration "windows"
+			SetTarget( "Debug", "x64" )
+			SetTarget( "Release", "x64" )
+			
+		configuration "macosx"
+			SetTarget( "Debug", "native" )
+			SetTarget( "Release", "native" )
+
+		configuration "linux"
+			links { "pthread" }
 			
 		configuration "Debug"
 			defines { "_DEBUG" }
@@ -45,4 +76,4 @@ solution "dequan_test"
  
 		configuration "Release"
 			defines { "NDEBUG" }
-			flags { "Optimize", "Symbols" }
\ No newline at end of file
+			flags { "Optimize", "Symbols" }
@@ -22,10 +22,31 @@
 	Please define DEQUAN_IMPLEMENTATION before including this file in one C / C++ file to create the implementation.
 	Should be C++11 compatible.
 	DEQUAN_USE_STDVECTOR : #define this to use std vectors, otherwise you need provide your own implementation of the Array macros
-	DEQUAN_SET_CONSTRAINT_SIZE : #define this if you implement your own Constraint-derived classes and need more space than default (see MaxConstraint)
-	DEQUAN_WITH_STATS : #define this to retrieve various stats about the search algorithm
+	DEQUAN_ALLOCATOR : #define this to the name of an allocator template, e.g. MyAllocator for MyAllocator<T>, used by the std vectors of DEQUAN_USE_STDVECTOR
+	DEQUAN_WITH_POOL_ALLOCATOR : #define this along with DEQUAN_USE_STDVECTOR so that the std vectors allocate from thread-local caches of blocks, see PoolAllocator
+	DEQUAN_WITH_STATS : #define this to retrieve various stats about the search algorithm, global and per constraint counters, depth histograms
+	DEQUAN_WITH_CYCLE_STATS : #define this along with DEQUAN_WITH_STATS to also measure the cycles spent in each propagator
+	DEQUAN_WITH_TRACE : #define this to record a compact binary trace of the search tree in Assignment::trace, see TraceReader
+	DEQUAN_WITH_THREADS : #define this to enable parallel solving with std::thread
+	DEQUAN_WITH_MMAP : #define this to map saved models read-only from files with MappedFile, see CSP::LoadModel()
 */
 
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <type_traits>
+#ifdef DEQUAN_WITH_THREADS
+	#include <thread>
+	#include <mutex>
+	#include <condition_variable>
+#endif
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
 #ifdef DEQUAN_USE_STDVECTOR
 	#include <vector>
 	#include <algorithm>
@@ -45,45 +66,388 @@
 /**/
 namespace dequan
 {
-#ifdef DEQUAN_USE_STDVECTOR
+#ifdef DEQUAN_WITH_POOL_ALLOCATOR
+	/**
+	 * Thread-local caches of blocks behind PoolAllocator, one free list per power of two size class from 16 bytes to 64 KiB.
+	 * Freed blocks are kept in the cache of the freeing thread for the next allocations of their class, and only released when that thread exits.
+	 * The cache itself is trivially destructible, so that arrays destroyed after it during thread or program exit are still freed safely.
+	 */
+	struct PoolCache
+	{
+		static constexpr int CLASS_COUNT = 13;
+		static constexpr size_t MIN_BLOCK_SIZE = 16;
+
+		void* free_lists[CLASS_COUNT];
+		bool registered;
+		/** Set once the thread is exiting, blocks are then directly freed */
+		bool released;
+
+		static PoolCache& Get()
+		{
+			static thread_local PoolCache cache = {};
+			return cache;
+		}
+		/** Size class of a block of 'bytes' bytes, -1 for large blocks that bypass the cache */
+		static int GetSizeClass(size_t bytes)
+		{
+			int size_class = 0;
+			while (size_class < CLASS_COUNT && (MIN_BLOCK_SIZE << size_class) < bytes)
+			{
+				size_class++;
+			}
+			return size_class < CLASS_COUNT ? size_class : -1;
+		}
+		static void* Allocate(size_t bytes);
+		static void Deallocate(void* block, size_t bytes);
+		/** Register the releaser of the thread before the cache first holds a block, from an allocation or from a deallocation */
+		void Register();
+	};
+	/** Releases the blocks cached by a thread when it exits */
+	struct PoolCacheReleaser
+	{
+		~PoolCacheReleaser()
+		{
+			PoolCache& cache = PoolCache::Get();
+			for (int c_idx = 0; c_idx < PoolCache::CLASS_COUNT; c_idx++)
+			{
+				while (cache.free_lists[c_idx] != nullptr)
+				{
+					void* block = cache.free_lists[c_idx];
+					cache.free_lists[c_idx] = *(void**)block;
+					::operator delete(block);
+				}
+			}
+			cache.released = true;
+		}
+	};
+	inline void PoolCache::Register()
+	{
+		if (!registered && !released)
+		{
+			static thread_local PoolCacheReleaser releaser;
+			(void)releaser;
+			registered = true;
+		}
+	}
+	inline void* PoolCache::Allocate(size_t bytes)
+	{
+		int size_class = GetSizeClass(bytes);
+		if (size_class < 0)
+		{
+			return ::operator new(bytes);
+		}
+		PoolCache& cache = Get();
+		if (cache.free_lists[size_class] != nullptr)
+		{
+			void* block = cache.free_lists[size_class];
+			cache.free_lists[size_class] = *(void**)block;
+			return block;
+		}
+		cache.Register();
+		return ::operator new(MIN_BLOCK_SIZE << size_class);
+	}
+	inline void PoolCache::Deallocate(void* block, size_t bytes)
+	{
+		int size_class = GetSizeClass(bytes);
+		PoolCache& cache = Get();
+		if (size_class < 0 || cache.released)
+		{
+			::operator delete(block);
+			return;
+		}
+		// Blocks allocated by another thread may be the first ones cached by this thread
+		cache.Register();
+		*(void**)block = cache.free_lists[size_class];
+		cache.free_lists[size_class] = block;
+	}
+
+	/**
+	 * Allocator of the std vectors with DEQUAN_WITH_POOL_ALLOCATOR: growing the domains, trails and model arrays reuses the blocks freed before on the same thread
+	 * instead of going through malloc and free. Types aligned beyond the alignment of operator new are not supported, like with std::allocator in C++11.
+	 */
 	template<typename T>
-	using Array = std::vector<T>;
+	struct PoolAllocator
+	{
+		typedef T value_type;
+
+		PoolAllocator() = default;
+		template<typename U>
+		PoolAllocator(const PoolAllocator<U>&) {}
+
+		T* allocate(size_t count) { return (T*)PoolCache::Allocate(count * sizeof(T)); }
+		void deallocate(T* ptr, size_t count) { PoolCache::Deallocate(ptr, count * sizeof(T)); }
+
+		template<typename U>
+		bool operator==(const PoolAllocator<U>&) const { return true; }
+		template<typename U>
+		bool operator!=(const PoolAllocator<U>&) const { return false; }
+	};
+	#ifndef DEQUAN_ALLOCATOR
+		#define DEQUAN_ALLOCATOR PoolAllocator
+	#endif
+#endif
+
+#ifdef DEQUAN_USE_STDVECTOR
+	#ifdef DEQUAN_ALLOCATOR
+		template<typename T>
+		using Array = std::vector<T, DEQUAN_ALLOCATOR<T>>;
+	#else
+		template<typename T>
+		using Array = std::vector<T>;
+	#endif
 #endif
+
+	/**
+	 * Array of the domain values and constraint payloads: items are either owned, or referenced in a model image loaded by CSP::LoadModel(),
+	 * and copied on their first modification. Items are read-only through operator[] so that referenced items are never copied while searching.
+	 */
+	template<typename T>
+	class MappedArray
+	{
+	public:
+		MappedArray() = default;
+		MappedArray(const Array<T>& src) : owned(src) { Sync(); }
+		MappedArray(const MappedArray& other) { Assign(other.items, other.count); }
+		MappedArray(MappedArray&& other) noexcept { *this = std::move(other); }
+		MappedArray& operator=(const MappedArray& other)
+		{
+			if (this != &other)
+			{
+				Assign(other.items, other.count);
+			}
+			return *this;
+		}
+		MappedArray& operator=(MappedArray&& other) noexcept
+		{
+			if (this != &other)
+			{
+				owned = std::move(other.owned);
+				referenced = other.referenced;
+				items = other.items;
+				count = other.count;
+				if (!referenced)
+				{
+					Sync();
+				}
+				other.Clear();
+			}
+			return *this;
+		}
+		MappedArray& operator=(const Array<T>& src)
+		{
+			owned = src;
+			referenced = false;
+			Sync();
+			return *this;
+		}
+
+		int Size() const { return count; }
+		const T& operator[](int idx) const { return items[idx]; }
+		const T& Back() const { return items[count - 1]; }
+		const T* begin() const { return items; }
+		const T* end() const { return items + count; }
+		/** Whether the items are referenced instead of owned */
+		bool IsReferenced() const { return referenced; }
+		/** Reference 'src_count' items that must outlive the array instead of copying them */
+		void Reference(const T* src, int src_count)
+		{
+			DEQUAN_Array_Clear(owned);
+			items = src;
+			count = src_count;
+			referenced = true;
+		}
+		/** Copy 'src_count' items, reusing the owned storage */
+		void Assign(const T* src, int src_count)
+		{
+			DEQUAN_Array_Resize(owned, src_count);
+			for (int i_idx = 0; i_idx < src_count; i_idx++)
+			{
+				owned[i_idx] = src[i_idx];
+			}
+			referenced = false;
+			Sync();
+		}
+		/** Writable items, owned from now on */
+		T* Edit()
+		{
+			if (referenced)
+			{
+				Assign(items, count);
+			}
+			return count > 0 ? &owned[0] : nullptr;
+		}
+		void Set(int idx, const T& val) { Edit()[idx] = val; }
+		void Resize(int size)
+		{
+			Edit();
+			DEQUAN_Array_Resize(owned, size);
+			Sync();
+		}
+		void Clear()
+		{
+			DEQUAN_Array_Clear(owned);
+			referenced = false;
+			Sync();
+		}
+		void PushBack(const T& val)
+		{
+			Edit();
+			DEQUAN_Array_PushBack(owned, val);
+			Sync();
+		}
+		void Insert(int idx, const T& val)
+		{
+			Edit();
+			DEQUAN_Array_Insert(owned, idx, val);
+			Sync();
+		}
+		void Erase(int first, int last)
+		{
+			Edit();
+			DEQUAN_Array_Erase(owned, first, last);
+			Sync();
+		}
+		/** Replace the items in [first, last) by the 'src_count' items of 'src' */
+		void Splice(int first, int last, const T* src, int src_count)
+		{
+			Edit();
+			const int old_count = count;
+			const int shift = src_count - (last - first);
+			if (shift > 0)
+			{
+				DEQUAN_Array_Resize(owned, old_count + shift);
+				for (int i_idx = old_count - 1; i_idx >= last; i_idx--)
+				{
+					owned[i_idx + shift] = owned[i_idx];
+				}
+			}
+			else if (shift < 0)
+			{
+				DEQUAN_Array_Erase(owned, last + shift, last);
+			}
+			for (int i_idx = 0; i_idx < src_count; i_idx++)
+			{
+				owned[first + i_idx] = src[i_idx];
+			}
+			Sync();
+		}
+		template<typename LESS>
+		void Sort(LESS less)
+		{
+			Edit();
+			DEQUAN_Array_Sort(owned, less);
+		}
+
+	private:
+		void Sync()
+		{
+			count = (int)DEQUAN_Array_Size(owned);
+			items = count > 0 ? &owned[0] : nullptr;
+		}
+
+		Array<T> owned;
+		const T* items = nullptr;
+		int count = 0;
+		bool referenced = false;
+	};
+
 	using VarId = int;
 	struct Var;
 	class Assignment;
 	class CSP;
 
-#ifdef DEQUAN_WITH_STATS
-	/**
-	 * Various statistics for the search algorithm.
-	 */
-	struct Stats
+	/** Number of bits set in a 64-bit word */
+	inline int BitCount(unsigned long long word)
 	{
-		Stats() = default;
+#if defined(_MSC_VER)
+		return (int)__popcnt64(word);
+#else
+		return __builtin_popcountll(word);
+#endif
+	}
+	/** Index of the lowest bit set in a non-zero 64-bit word */
+	inline int BitScanForward(unsigned long long word)
+	{
+#if defined(_MSC_VER)
+		unsigned long idx;
+		_BitScanForward64(&idx, word);
+		return (int)idx;
+#else
+		return __builtin_ctzll(word);
+#endif
+	}
+	/** Index of the highest bit set in a non-zero 64-bit word */
+	inline int BitScanReverse(unsigned long long word)
+	{
+#if defined(_MSC_VER)
+		unsigned long idx;
+		_BitScanReverse64(&idx, word);
+		return (int)idx;
+#else
+		return 63 - __builtin_clzll(word);
+#endif
+	}
 
-		unsigned long long validated_constraints = 0;
-		unsigned long long applied_arcs = 0;
-		unsigned long long assigned_vars = 0;
+	/** Small xorshift random generator, deterministic for a given seed */
+	struct Random
+	{
+		explicit Random(unsigned int seed = 0) : state(seed != 0 ? seed : 0x9e3779b9u) {}
+		unsigned int Next()
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+		/** Random integer in range [0, range) */
+		unsigned int Next(unsigned int range) { return Next() % range; }
+
+		unsigned int state;
 	};
-#endif
+
 	enum class DomainType : int
 	{
 		Values = 0,
 		Ranges,
+		Bitset,
 	};
-	/** Domain represents either continuous ranges [min, max) of values or a set of values that a Var can take */
+	/**
+	 * Domain represents either continuous ranges [min, max) of values or a set of values that a Var can take.
+	 * Small dense domains can also be stored as a bitset, where exclusions and intersections are word operations.
+	 */
 	struct Domain
 	{
+		/** Maximum number of 64-bit words of a Bitset domain, i.e. a bitset domain can span at most 256 values */
+		static constexpr int BITSET_MAX_WORDS = 4;
+
 		Domain() = default;
 		Domain(DomainType t, const Array<int>& v) : type(t), values(v) {}
+		/** Create a Bitset domain with all values in range [min, max), max - min must be <= BITSET_MAX_WORDS * 64 */
+		static Domain MakeBitset(int min_val, int max_val);
 		int Size() const;
+		/** Whether the domain has been wiped out */
+		bool IsEmpty() const;
+		/** Whether the domain is reduced to a single value, cheaper than Size() == 1 */
+		bool IsFixed() const;
+		/** Smallest and largest values of a non-empty domain */
+		int Min() const;
+		int Max() const;
+		/** Find the smallest value of the domain strictly greater than 'prev', return false if there is none */
+		bool NextValue(int prev, int& next) const;
+		/** Find the largest value of the domain strictly lower than 'next', return false if there is none */
+		bool PrevValue(int next, int& prev) const;
+		/** Value of rank 'rank' in ascending order, 'rank' must be in [0, Size()) */
+		int GetValue(int rank) const;
+		/** Whether 'val' is in the domain */
+		bool Contains(int val) const;
 		/** Remove any value different from 'val' in the domain */
 		void Intersect(int val);
 		/** Remove any value different from 'val0' or 'val1' in the domain */
 		void Intersect(int val0, int val1);
 		/** Remove any value outside of [rmin, rmax) in the domain */
 		void IntersectRange(int rmin, int rmax);
+		/** Remove any value that is not one of the 'count' sorted values of 'sorted_vals' from the domain */
+		void IntersectValues(const int* sorted_vals, int count);
 		/** Remove 'val' value from the domain */
 		void Exclude(int val);
 		/** Remove any value >= rmax from the domain */
@@ -92,25 +456,51 @@ namespace dequan
 		void ExcludeInf(int rmin);
 
 		DomainType type = DomainType::Values;
-		Array<int> values;
+		/** Sorted values or [min, max) ranges, unused for Bitset domains */
+		MappedArray<int> values;
+		/** Bitset storage, bit i of the bitset represents value bits_min + i */
+		int bits_min = 0;
+		int bits_words = 0;
+		unsigned long long bits[BITSET_MAX_WORDS] = {};
 	};
-	/** Backup domain, that is used to restore variables domain when searching algo needs to backtrack */
-	struct SavedDomain
+	/**
+	 * Entry of the trail, undoing a modification of a domain in a step of the searching algo.
+	 * Bound cuts and exclusions only back up the values they remove, other modifications back up the whole domain before the first of them in the step.
+	 * Backed up values are stored in a pool shared by all entries, so that saving a domain never allocates once the pool has grown.
+	 */
+	struct TrailEntry
 	{
-		SavedDomain() = default;
-		SavedDomain(VarId vid, DomainType t, const Array<int>& v) : var_id(vid), type(t), values(v) {}
+		enum class Kind : int
+		{
+			Domain = 0,	// whole domain: values, ranges or bitset words
+			Splice,		// the 'new_count' values at 'values_pos' of the domain replaced the backed up ones
+			Removed,	// sorted values removed from a Values domain, merged back on restore
+		};
+
+		TrailEntry() = default;
+		TrailEntry(VarId vid, DomainType t, Kind k, int offset, int count) : var_id(vid), type(t), kind(k), values_offset(offset), values_count(count) {}
 
-		VarId var_id;
+		VarId var_id = -1;
+		/** Type of the domain before the modification */
 		DomainType type = DomainType::Values;
-		Array<int> values;
+		Kind kind = Kind::Domain;
+		/** Position and number of the backed up values in Assignment::trail_values */
+		int values_offset = 0;
+		int values_count = 0;
+		int values_pos = 0;
+		int new_count = 0;
+		/** Whether this is the first entry of the var since the trail stamp changed, var heuristics count modified vars once per step */
+		bool first_of_var = true;
 	};
-
-	/** Set of SavedDomains for one step of the searching algo */
-	struct SavedDomains
+	/** Entry of the trail of constraint states, backup of an int of Assignment::GetConstraintTrailedState() before its first modification in a step */
+	struct StateTrailEntry
 	{
-		SavedDomains() = default;
+		StateTrailEntry() = default;
+		StateTrailEntry(int _con_id, int idx, int val) : con_id(_con_id), state_idx(idx), value(val) {}
 
-		Array<SavedDomain> domains;
+		int con_id = -1;
+		int state_idx = 0;
+		int value = 0;
 	};
 
 	/**
@@ -126,10 +516,142 @@ namespace dequan
 		int value = InstVar::UNASSIGNED;
 	};
 
+	/** Type tag of the built-in constraints, which are stored by kind and dispatched without virtual calls. User constraints are tagged User. */
+	enum class ConstraintKind : int
+	{
+		User = 0,
+		Op,
+		Equality,
+		OrEquality,
+		CombinedEquality,
+		OrRange,
+		AllDifferent,
+		Linear,
+		Table,
+		Lex,
+	};
+	static const int CONSTRAINT_KIND_COUNT = (int)ConstraintKind::Lex + 1;
+	/** Readable name of a constraint kind, for profiles */
+	inline const char* GetConstraintKindName(ConstraintKind kind)
+	{
+		static const char* names[CONSTRAINT_KIND_COUNT] = { "User", "Op", "Equality", "OrEquality", "CombinedEquality", "OrRange", "AllDifferent", "Linear", "Table", "Lex" };
+		return names[(int)kind];
+	}
+
+#ifdef DEQUAN_WITH_CYCLE_STATS
+	/** Time stamp counter of the CPU, or a steady clock in nanoseconds where there is none */
+	inline unsigned long long ReadCycleCounter()
+	{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+		return __builtin_ia32_rdtsc();
+#else
+		return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+#endif
+
+#ifdef DEQUAN_WITH_STATS
+	/** Counters of one constraint, or of all the constraints of a kind */
+	struct ConstraintStats
+	{
+		ConstraintStats() = default;
+		void Add(const ConstraintStats& other);
+
+		/** Calls to the propagator, domains it reduced, and calls that wiped out a domain */
+		unsigned long long propagations = 0;
+		unsigned long long prunings = 0;
+		unsigned long long wipeouts = 0;
+		/** Evaluations when validating an assignment, and violations found */
+		unsigned long long validations = 0;
+		unsigned long long violations = 0;
+		/** Cycles spent in the propagator, only measured with DEQUAN_WITH_CYCLE_STATS */
+		unsigned long long cycles = 0;
+	};
+
+	/**
+	 * Various statistics for the search algorithm, cleared by Assignment::Reset() and Assignment::Rewind().
+	 */
+	struct Stats
+	{
+		Stats() = default;
+		/** Zero all the counters, and size them for a model */
+		void Clear(int con_count, int var_count);
+		/** Sum of the counters of the constraints of a kind */
+		ConstraintStats GetKindStats(const CSP& csp, ConstraintKind kind) const;
+		/** Counter value at the start of a propagator call, zero without DEQUAN_WITH_CYCLE_STATS */
+		unsigned long long StartTiming() const;
+		void RecordPropagation(int con_id, bool success, int pruned_vars, unsigned long long start_cycles);
+		void RecordValidation(int con_id, bool violated);
+
+		unsigned long long validated_constraints = 0;
+		unsigned long long applied_arcs = 0;
+		unsigned long long assigned_vars = 0;
+		/** Counters of each constraint, indexed by con_id */
+		Array<ConstraintStats> constraint_stats;
+		/** Number of assignments, and of failed assignments, at each depth of the search, i.e. for each number of vars already assigned */
+		Array<unsigned long long> depth_histogram;
+		Array<unsigned long long> backtrack_histogram;
+	};
+#endif
+
+#ifdef DEQUAN_WITH_TRACE
+	/** Records of the search trace */
+	enum class TraceEvent : int
+	{
+		Assign = 1,		// depth, var id and value of an assignment
+		Fail,			// the last assignment or split failed
+		Solution,		// all the vars are assigned
+		Restart,		// the search restarted from the root
+		SplitLow,		// depth, var id and pivot of a split reducing the domain to var <= pivot, the depth is the number of assigned vars
+		SplitHigh,		// same for var > pivot
+	};
+
+	struct TraceRecord
+	{
+		TraceEvent event = TraceEvent::Assign;
+		int depth = 0;
+		VarId var_id = -1;
+		int value = 0;
+	};
+
+	/**
+	 * Compact binary trace of the search tree, appended by the search and replayed offline with TraceReader.
+	 * Each record is a tag byte, followed for assignments and splits by the depth, var id and zigzag encoded value as LEB128 varints.
+	 */
+	struct SearchTrace
+	{
+		SearchTrace() = default;
+		void Clear();
+		void Record(TraceEvent event);
+		/** Record an Assign, SplitLow or SplitHigh event */
+		void RecordDecision(TraceEvent event, int depth, VarId vid, int val);
+		void WriteVarint(unsigned int value);
+
+		Array<unsigned char> bytes;
+	};
+
+	/** Decode the records of a trace, e.g. read back from a file */
+	class TraceReader
+	{
+	public:
+		TraceReader(const unsigned char* _bytes, size_t _size) : bytes(_bytes), size(_size) {}
+		/** Decode the next record, returns false at the end of the trace or if it is truncated */
+		bool Next(TraceRecord& record);
+
+	private:
+		bool ReadVarint(unsigned int& value);
+
+		const unsigned char* bytes = nullptr;
+		size_t size = 0;
+		size_t pos = 0;
+	};
+#endif
+
 	/**
 	 * Base class for representing constraints on variables.
-	 * You can define new derived constraints, but note that sizeof(YourNewConstraint) must be <= MAX_CONSTRAINT_SIZE.
-	 * Increase this value if you have larger constraint classes.
+	 * You can define new derived constraints of any size, they are stored in the ConstraintArena of the CSP.
 	 */
 	struct Constraint
 	{
@@ -140,34 +662,81 @@ namespace dequan
 			Failed
 		};
 
+		/** Domain changes of a linked var that can wake up a constraint, see GetWakeEvents() */
+		enum Event : int
+		{
+			EVENT_ASSIGNED	= 1 << 0,	// the var has been assigned by the search
+			EVENT_FIXED		= 1 << 1,	// the domain has been reduced to a single value
+			EVENT_BOUNDS	= 1 << 2,	// the min or max of the domain has changed
+			EVENT_DOMAIN	= 1 << 3,	// any value has been removed from the domain
+		};
+
 		Constraint() = default;
+		explicit Constraint(ConstraintKind _kind) : kind(_kind) {}
 		virtual ~Constraint() = default;
-		virtual void LinkVars(Array<Var>& vars) = 0;
-		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid) = 0;
-		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid) { return true; }
+		/** Append the vars referenced by the constraint to 'linked_vars', the position of a var in the constraint is its rank in this list */
+		virtual void LinkVars(Array<VarId>& linked_vars) const = 0;
+		/** Check the constraint once 'last_assigned_vid' has been assigned, 'last_assigned_pos' is the position of this var in the constraint */
+		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos) = 0;
+		/**
+		 * Restrict the current domains of the linked vars, 'last_assigned_vid' is the var whose change woke up the constraint, at position 'last_assigned_pos'.
+		 * Domains must be modified through Assignment::EnsureSavedDomain() or the Assignment::Exclude*() helpers. Returns false on domain wipe out.
+		 */
+		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos) { return true; }
+		/**
+		 * Combination of Event flags for which the constraint is queued for propagation.
+		 * Default only wakes up the constraint when one of its vars is assigned.
+		 */
+		virtual int GetWakeEvents() const { return EVENT_ASSIGNED; }
+		/**
+		 * Incremental state, e.g. occupied values or running sums, kept in Assignment::GetConstraintCounters() so that the CSP can be shared between threads.
+		 * If TracksAssignments() returns true, OnVarAssigned() and OnVarUnassigned() are called when the search assigns or unassigns the linked var at 'var_pos',
+		 * and EvaluateTracked() is used instead of Evaluate() to check the constraint after an assignment. Default falls back to Evaluate().
+		 */
+		virtual bool TracksAssignments() const { return false; }
+		virtual void OnVarAssigned(Assignment& a, VarId vid, int var_pos) {}
+		virtual void OnVarUnassigned(Assignment& a, VarId vid, int var_pos) {}
+		virtual Eval EvaluateTracked(Assignment& a, VarId last_assigned_vid, int last_assigned_pos);
+
+		/** Index of the constraint in CSP::constraints, set when the constraint is added to the model */
+		int con_id = -1;
+		/** Concrete type of a built-in constraint, User for any other derived class */
+		ConstraintKind kind = ConstraintKind::User;
 	};
 
 	/**
-	 * Can represent and store any Constraint derived class.
-	 * This class exists to avoid heap allocations while still supporting polymorphism when storing all constraints.
-	 * i.e. Array<GenericConstraint> instead of Array<Constraint*>
+	 * Bump allocator storing constraints of any Constraint derived class, each one taking exactly its size.
+	 * Memory is allocated by blocks that are never moved, so that constraint addresses stay valid while constraints are added.
+	 * This avoids a heap allocation per constraint while still supporting polymorphism.
 	 */
-	struct GenericConstraint
+	class ConstraintArena
 	{
-#ifdef DEQUAN_SET_CONSTRAINT_SIZE
-		static constexpr int MAX_CONSTRAINT_SIZE = DEQUAN_SET_CONSTRAINT_SIZE;
-#else
-		struct MaxConstraint
-		{
-			virtual ~MaxConstraint() {};
-			union { Array<int> a; int v[4]; };
-		};
-		static constexpr int MAX_CONSTRAINT_SIZE = sizeof(MaxConstraint);
-#endif
-		char buffer[MAX_CONSTRAINT_SIZE];
+	public:
+		static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+		ConstraintArena() = default;
+		ConstraintArena(const ConstraintArena&) = delete;
+		ConstraintArena& operator=(const ConstraintArena&) = delete;
+		ConstraintArena(ConstraintArena&& other);
+		ConstraintArena& operator=(ConstraintArena&& other);
+		~ConstraintArena();
+
+		/** Copy 'con' into the arena */
+		template <class T>
+		T* Create(const T& con);
+		/** Destroy all the constraints and release the memory */
+		void Clear();
+		/** All the constraints created in the arena, in creation order */
+		const Array<Constraint*>& GetConstraints() const { return constraints; }
+
+	private:
+		void* Allocate(size_t size, size_t alignment);
 
-		Constraint* operator->()	{ return (Constraint*)buffer; }
-		Constraint* get()			{ return (Constraint*)buffer; }
+		Array<char*> blocks;
+		/** Free space of the last block */
+		char* block_cursor = nullptr;
+		char* block_end = nullptr;
+		Array<Constraint*> constraints;
 	};
 
 	/** Constraint of the form : v0 (op) v1 + offset */
@@ -183,13 +752,11 @@ namespace dequan
 			Inf		// <
 		};
 
-		OpConstraint(VarId _v0, VarId _v1, Op _op,int _offset) : v0(_v0), v1(_v1), op(_op), offset(_offset)
-		{
-			static_assert(sizeof(OpConstraint) <= GenericConstraint::MAX_CONSTRAINT_SIZE, "");
-		}
-		virtual void LinkVars(Array<Var>& vars);
-		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid);
-		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid);
+		OpConstraint(VarId _v0, VarId _v1, Op _op,int _offset) : Constraint(ConstraintKind::Op), v0(_v0), v1(_v1), op(_op), offset(_offset) {}
+		virtual void LinkVars(Array<VarId>& linked_vars) const;
+		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos);
+		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos);
+		virtual int GetWakeEvents() const;
 
 		VarId v0, v1;
 		Op op = Op::Equal;
@@ -199,13 +766,11 @@ namespace dequan
 	/** Constraint of the form : v0 == v1 */
 	struct EqualityConstraint : public Constraint
 	{
-		EqualityConstraint(VarId _v0, VarId _v1) : v0(_v0), v1(_v1)
-		{
-			static_assert(sizeof(EqualityConstraint) <= GenericConstraint::MAX_CONSTRAINT_SIZE, "");
-		}
-		virtual void LinkVars(Array<Var>& vars);
-		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid);
-		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid);
+		EqualityConstraint(VarId _v0, VarId _v1) : Constraint(ConstraintKind::Equality), v0(_v0), v1(_v1) {}
+		virtual void LinkVars(Array<VarId>& linked_vars) const;
+		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos);
+		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos);
+		virtual int GetWakeEvents() const;
 
 		VarId v0, v1;
 	};
@@ -213,13 +778,11 @@ namespace dequan
 	/** Constraint of the form : v0 == v1 || v0 == v2 */
 	struct OrEqualityConstraint : public Constraint
 	{
-		OrEqualityConstraint(VarId _v0, VarId _v1, VarId _v2) : v0(_v0), v1(_v1), v2(_v2)
-		{
-			static_assert(sizeof(OrEqualityConstraint) <= GenericConstraint::MAX_CONSTRAINT_SIZE, "");
-		}
-		virtual void LinkVars(Array<Var>& vars);
-		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid);
-		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid);
+		OrEqualityConstraint(VarId _v0, VarId _v1, VarId _v2) : Constraint(ConstraintKind::OrEquality), v0(_v0), v1(_v1), v2(_v2) {}
+		virtual void LinkVars(Array<VarId>& linked_vars) const;
+		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos);
+		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos);
+		virtual int GetWakeEvents() const;
 
 		VarId v0, v1, v2;
 	};
@@ -227,13 +790,11 @@ namespace dequan
 	/** Constraint of the form : v0 == v1 + v2 - v3 */
 	struct CombinedEqualityConstraint : public Constraint
 	{
-		CombinedEqualityConstraint(VarId _v0, VarId _v1, VarId _v2, VarId _v3) : v0(_v0), v1(_v1), v2(_v2), v3(_v3)
-		{
-			static_assert(sizeof(CombinedEqualityConstraint) <= GenericConstraint::MAX_CONSTRAINT_SIZE, "");
-		};
-		virtual void LinkVars(Array<Var>& vars);
-		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid);
-		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid);
+		CombinedEqualityConstraint(VarId _v0, VarId _v1, VarId _v2, VarId _v3) : Constraint(ConstraintKind::CombinedEquality), v0(_v0), v1(_v1), v2(_v2), v3(_v3) {}
+		virtual void LinkVars(Array<VarId>& linked_vars) const;
+		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos);
+		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos);
+		virtual int GetWakeEvents() const;
 
 		VarId v0, v1, v2, v3;
 	};
@@ -241,13 +802,11 @@ namespace dequan
 	/** Constraint of the form : (v0 >= min && v0 < max) || (v1 >= min && v1 < max) */
 	struct OrRangeConstraint : public Constraint
 	{
-		OrRangeConstraint(VarId _v0, VarId _v1, int _min, int _max) : v0(_v0), v1(_v1), min(_min), max(_max)
-		{
-			static_assert(sizeof(OrRangeConstraint) <= GenericConstraint::MAX_CONSTRAINT_SIZE, "");
-		}
-		virtual void LinkVars(Array<Var>& vars);
-		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid);
-		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid);
+		OrRangeConstraint(VarId _v0, VarId _v1, int _min, int _max) : Constraint(ConstraintKind::OrRange), v0(_v0), v1(_v1), min(_min), max(_max) {}
+		virtual void LinkVars(Array<VarId>& linked_vars) const;
+		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos);
+		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos);
+		virtual int GetWakeEvents() const;
 
 		VarId v0, v1;
 		int min, max;
@@ -256,76 +815,603 @@ namespace dequan
 	/** Add an all different constraints to a bunch of variables. */
 	struct AllDifferentConstraint : public Constraint
 	{
-		AllDifferentConstraint(const Array<VarId>& vars) : alldiff_vars(vars)
+		/** How much the domains are filtered, stronger filterings cost more per propagation but prune more of the search tree */
+		enum class Filtering : int
 		{
-			static_assert(sizeof(AllDifferentConstraint) <= GenericConstraint::MAX_CONSTRAINT_SIZE, "");
-		}
-		virtual void LinkVars(Array<Var>& vars);
-		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid);
-		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid);
+			Value = 0,	// remove the value of fixed vars from the other vars
+			Bounds,		// bounds consistency, pushes the bounds of the vars out of Hall intervals
+			Domain,		// generalized arc consistency, with a bipartite matching of vars and values (Regin)
+		};
+		/** Domain filtering needs memory proportional to the span of the initial domains, bounds filtering is used above this span */
+		static constexpr int DOMAIN_FILTERING_MAX_SPAN = 1 << 16;
 
-		Array<VarId> alldiff_vars;
+		AllDifferentConstraint(const Array<VarId>& vars, Filtering _filtering = Filtering::Value) : Constraint(ConstraintKind::AllDifferent), alldiff_vars(vars), filtering(_filtering) {}
+		virtual void LinkVars(Array<VarId>& linked_vars) const;
+		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos);
+		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos);
+		virtual int GetWakeEvents() const;
+		virtual bool TracksAssignments() const { return true; }
+		virtual void OnVarAssigned(Assignment& a, VarId vid, int var_pos);
+		virtual void OnVarUnassigned(Assignment& a, VarId vid, int var_pos);
+		virtual Eval EvaluateTracked(Assignment& a, VarId last_assigned_vid, int last_assigned_pos);
+		bool ApplyValueFiltering(Assignment& a);
+		/** Bounds filtering keeps its var order at 'state_offset' in the constraint state */
+		bool ApplyBoundsFiltering(Assignment& a, int state_offset = 0);
+		bool ApplyDomainFiltering(Assignment& a);
+
+		MappedArray<VarId> alldiff_vars;
+		Filtering filtering = Filtering::Value;
 	};
 
-	/** Class for representing the different variables of the CSP to solve. */
-	struct Var
+	/**
+	 * Constraint of the form : coefs[0] * vars[0] + ... + coefs[n-1] * vars[n-1] (op) rhs, with as many coefs as vars.
+	 * Propagation is bounds consistent, linear in the number of terms.
+	 */
+	struct LinearConstraint : public Constraint
 	{
-		Var() = default;
-		Var(VarId vid, const Array<Constraint*>& lk) : var_id(vid), linked_constraints(lk) {}
+		LinearConstraint(const Array<VarId>& vars, const Array<int>& _coefs, OpConstraint::Op _op, int _rhs);
+		virtual void LinkVars(Array<VarId>& linked_vars) const;
+		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos);
+		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos);
+		virtual int GetWakeEvents() const;
+		virtual bool TracksAssignments() const { return true; }
+		virtual void OnVarAssigned(Assignment& a, VarId vid, int var_pos);
+		virtual void OnVarUnassigned(Assignment& a, VarId vid, int var_pos);
+		virtual Eval EvaluateTracked(Assignment& a, VarId last_assigned_vid, int last_assigned_pos);
+		Eval EvaluateSum(long long sum) const;
 
-		static const VarId INVALID = -1;
-
-		VarId var_id = Var::INVALID;
-		/** All the constraints where the variable is referenced */
-		Array<Constraint*> linked_constraints;
+		MappedArray<VarId> linear_vars;
+		MappedArray<int> coefs;
+		/** Strict inequalities are turned into SupEqual and InfEqual by shifting rhs */
+		OpConstraint::Op op = OpConstraint::Op::Equal;
+		long long rhs = 0;
 	};
 
 	/**
-	 * Assignment is a snapshot of the progression of the search algorithm.
-	 * All working variables of the search algorithm goes here.
+	 * Extensional constraint, the vars must take the values of one of the allowed tuples.
+	 * Propagation is generalized arc consistent with the Compact-Table algorithm: the valid tuples are a sparse bitset trailed in the Assignment,
+	 * and each value keeps the bitset of the tuples that contain it, so that tuples are filtered and values checked with 64-bit word operations.
 	 */
-	class Assignment
+	struct TableConstraint : public Constraint
 	{
-	public:
-		Assignment();
-		/** Reset the assignment and make it ready for a new solving. */
-		void Reset(const CSP& csp);
-		/** Whether all variables have been assigned. */
-		bool IsComplete();
-		int GetInstVarValue(VarId vid) const;
-		const Domain& GetCurrentDomain(VarId vid) const;
-		VarId NextUnassignedVar();
-		void AssignVar(VarId vid, int val);
-		void UnAssignVar(VarId vid);
-		/** Try and validate that none of the passed constraints is violated. */
-		bool ValidateVarConstraints(const Var& var) /*const*/;
-		/** Ensure that the variable's domain has been backed up once in this step before we modify it. */
-		void EnsureSavedDomain(VarId vid, const Domain& dom);
-		/** Restore all the domains saved during this step, typically when a backtrack is needed. */
-		void RestoreSavedDomainStep();
-
-		/** Current number of assigned variables, the search algo is finished when all variables have been assigned */
-		int assigned_var_count = 0;
-		/** Current instanced values of the variables */
-		Array<InstVar> inst_vars;
-		/** Current domains, starting from the initial domains and progressively reduced by the searching algo */
-		Array<Domain> current_domains;
-		/** Backed up domains, used to restore domains if the searching algo needs to backtrack */
-		Array<SavedDomains> saved_domains;
-		/** Order in which variables will be processed for assignments */
-		Array<VarId> assign_order;
+		/** 'tuples' lists the allowed tuples one after the other, each one with a value for every var of 'vars' */
+		TableConstraint(const Array<VarId>& vars, const Array<int>& tuples);
+		virtual void LinkVars(Array<VarId>& linked_vars) const;
+		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos);
+		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos);
+		virtual int GetWakeEvents() const { return EVENT_DOMAIN; }
+		/** Index of 'val' in the values of the var at 'var_pos', -1 if no tuple contains it */
+		int FindValueIdx(int var_pos, int val) const;
 
-#ifdef DEQUAN_WITH_STATS
-		Stats stats;
-#endif
+		MappedArray<VarId> table_vars;
+		int tuple_count = 0;
+		/** Number of 64-bit words of a bitset of tuples */
+		int word_count = 0;
+		/** Sorted distinct values of the tuples, the values of the var at position p are in [value_offsets[p], value_offsets[p + 1]) */
+		MappedArray<int> values;
+		MappedArray<int> value_offsets;
+		/** Bitset of the tuples containing each value, word_count words per value */
+		MappedArray<unsigned long long> supports;
 	};
 
 	/**
-	 * Class representing a Constraint Satisfying Problem.
-	 * This is where you model the problem using variables and constraints.
-	 * Once defined, CSP is static and never modified by the searching algorithm.
+	 * Lexicographic ordering of two vectors of vars of the same size: vars0 <=lex coef * vars1 + offset, or <lex when strict,
+	 * where coef is 1 or -1 so that the values of vars1 can be reflected. This is the symmetry breaking constraint of CSP::AddVarSymmetry().
+	 * Propagation is bounds consistent: positions are scanned up to the first one that is not fixed and equal on both sides,
+	 * and it is made strictly lower when the positions after it cannot be lower or equal anymore.
 	 */
-	class CSP
+	struct LexConstraint : public Constraint
+	{
+		LexConstraint(const Array<VarId>& _vars0, const Array<VarId>& _vars1, bool _strict = false, int _coef = 1, int _offset = 0)
+			: Constraint(ConstraintKind::Lex), vars0(_vars0), vars1(_vars1), strict(_strict), coef(_coef), offset(_offset) {}
+		/** Vars of vars0 come first, then the vars of vars1 */
+		virtual void LinkVars(Array<VarId>& linked_vars) const;
+		virtual Eval Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos);
+		virtual bool AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos);
+		virtual int GetWakeEvents() const { return EVENT_BOUNDS; }
+		/** Bounds of coef * vars1[pos] + offset */
+		void GetImageBounds(const Assignment& a, int pos, long long& image_min, long long& image_max) const;
+		/** Whether the positions from 'pos' can still be lexicographically lower, or equal if not strict */
+		bool CanSuffixHold(const Assignment& a, int pos) const;
+
+		MappedArray<VarId> vars0;
+		MappedArray<VarId> vars1;
+		bool strict = false;
+		int coef = 1;
+		int offset = 0;
+	};
+
+	/**
+	 * Call Evaluate() (or EvaluateTracked()) or AplyArcConsistency() on any constraint.
+	 * Built-in constraints are dispatched on their kind with non-virtual calls, user constraints go through the virtual interface.
+	 */
+	Constraint::Eval EvaluateConstraint(Constraint& con, Assignment& a, VarId last_assigned_vid, int last_assigned_pos);
+	bool ApplyConstraintArcConsistency(Constraint& con, Assignment& a, VarId last_assigned_vid, int last_assigned_pos);
+	/** Whether T is exactly one of the built-in constraint classes, which are dispatched on their kind wherever they are stored */
+	template <class T>
+	struct IsBuiltinConstraint
+	{
+		static constexpr bool value = std::is_same<T, OpConstraint>::value || std::is_same<T, EqualityConstraint>::value ||
+			std::is_same<T, OrEqualityConstraint>::value || std::is_same<T, CombinedEqualityConstraint>::value ||
+			std::is_same<T, OrRangeConstraint>::value || std::is_same<T, AllDifferentConstraint>::value ||
+			std::is_same<T, LinearConstraint>::value || std::is_same<T, TableConstraint>::value || std::is_same<T, LexConstraint>::value;
+	};
+
+	/** Entry of the var to constraint adjacency, see CSP::var_links */
+	struct ConstraintLink
+	{
+		Constraint* con = nullptr;
+		/** Position of the var in the constraint, see Constraint::LinkVars() */
+		int var_pos = 0;
+		/** Constraint::GetWakeEvents() of the constraint, copied here so that events can be filtered without touching the constraint */
+		int wake_events = 0;
+	};
+
+	/** Class for representing the different variables of the CSP to solve. */
+	struct Var
+	{
+		Var() = default;
+		Var(VarId vid) : var_id(vid) {}
+
+		static const VarId INVALID = -1;
+
+		VarId var_id = Var::INVALID;
+	};
+
+	/** Heuristics used to choose the next variable to assign */
+	enum class VarHeuristic : int
+	{
+		Static = 0,	// smallest initial domain first, the order is computed once in Reset()
+		Dom,		// smallest current domain first, ties broken by largest degree
+		DomWDeg,	// smallest current domain size / weighted degree, constraint weights are bumped on each failure
+		Activity,	// largest activity / current domain size, activity of a var is bumped each time its domain is reduced
+	};
+
+	/** Order in which CSP::Solve() tries the values of a var */
+	enum class ValueOrder : int
+	{
+		Min = 0,	// ascending values
+		Max,		// descending values
+		Median,		// median value of the domain first, then by increasing distance to it, the value above before the value below
+		Random,		// random value of the domain first, drawn from random_seed, then the following values in ascending order wrapping around to the smallest ones
+		Split,		// domains of at least split_min_size values are bisected into var <= mid and var > mid, smaller ones are enumerated in ascending order
+	};
+
+	/** Restart strategies of CSP::Solve(), the search restarts from the root each time the nodes since the last restart reach the current limit */
+	enum class RestartPolicy : int
+	{
+		None = 0,	// plain chronological backtracking
+		Luby,		// restart_base * luby(i) nodes before the i-th restart, i.e. 1 1 2 1 1 2 4 1 1 2 ... times restart_base
+		Geometric,	// restart_base * restart_factor^i nodes before the i-th restart
+	};
+
+	/**
+	 * Callback giving the value to try first when branching on 'vid', or InstVar::UNASSIGNED for none, see SearchParams::value_hint_callback.
+	 * Domain changes must not be done from the callback.
+	 */
+	typedef int (*ValueHintCallback)(const Assignment& a, VarId vid, void* user_data);
+
+	/** Parameters of the search algorithm, that can be changed for each solving */
+	struct SearchParams
+	{
+		SearchParams() = default;
+		/** Diversified parameters for the worker 'worker_idx' of a portfolio */
+		static SearchParams MakePortfolioParams(int worker_idx);
+
+		VarHeuristic var_heuristic = VarHeuristic::Static;
+		ValueOrder value_order = ValueOrder::Min;
+		/** Decay applied to var activities at each search node, for VarHeuristic::Activity */
+		double activity_decay = 0.999;
+		/** When not zero, ties between equally ranked vars are broken randomly instead of by var id, and shuffled again at each restart */
+		unsigned int random_seed = 0;
+		/**
+		 * Restarts of CSP::Solve(), ignored by ForwardCheckingStep(), when counting solutions, with ValueOrder::Split and by parallel tree searches.
+		 * Nogoods are recorded from the branch abandoned at each restart, so that explored subtrees are never searched again and the search stays complete.
+		 */
+		RestartPolicy restart_policy = RestartPolicy::None;
+		unsigned long long restart_base = 100;
+		double restart_factor = 1.5;
+		/** Last conflict: the var whose assignment last failed is chosen again until it is successfully assigned. Ignored by VarHeuristic::Static. */
+		bool last_conflict = false;
+		/**
+		 * Value tried first for each var by CSP::Solve() before following value_order, indexed by var id, InstVar::UNASSIGNED or missing for no hint.
+		 * Typically the values of a previous solution, so that re-solving a slightly different model reaches it first. Ignored by parallel tree searches.
+		 */
+		Array<int> value_hints;
+		/** When not null, called each time a var is chosen for branching to get its value hint, instead of reading value_hints */
+		ValueHintCallback value_hint_callback = nullptr;
+		void* value_hint_user_data = nullptr;
+		/** Smallest domain size bisected by ValueOrder::Split, must be at least 2 */
+		int split_min_size = 8;
+		/** Use the values of a solution as value hints */
+		void SetSolutionHint(const Array<InstVar>& solution);
+	};
+
+	/** Result of CSP::Solve() */
+	enum class SearchStatus : int
+	{
+		Solved = 0,	// all variables are assigned, call Solve() again to look for the next solution
+		Infeasible,	// the whole search space has been explored, there is no (more) solution
+		Paused,		// the node or backtrack budget ran out, call Solve() again to resume the search where it stopped
+		Timeout,	// the time budget or the deadline has been reached, the search can be resumed like when Paused
+		Cancelled,	// the stop flag has been raised, the search can be resumed like when Paused
+	};
+	/** Whether the search stopped before finding a solution or exhausting the search space, and can be resumed */
+	inline bool IsSearchInterrupted(SearchStatus status) { return status == SearchStatus::Paused || status == SearchStatus::Timeout || status == SearchStatus::Cancelled; }
+
+	/** Budget for one call to CSP::Solve(), zero means unlimited */
+	struct SearchBudget
+	{
+		SearchBudget() = default;
+
+		unsigned long long max_nodes = 0;
+		/** Number of failed assignments, see Assignment::search_backtracks */
+		unsigned long long max_backtracks = 0;
+		double max_seconds = 0.0;
+		/** Absolute time after which the search stops, none by default. The earliest of the deadline and max_seconds applies. */
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+		/** When not null, the search is cancelled as soon as the flag is raised, possibly from another thread */
+		const std::atomic<bool>* stop_flag = nullptr;
+
+		/** Absolute time at which a search started at 'start_time' must stop, the earliest of deadline and max_seconds */
+		std::chrono::steady_clock::time_point GetDeadline(std::chrono::steady_clock::time_point start_time) const;
+	};
+
+	/** Result of one instance of CSP::SolveBatch() */
+	struct BatchResult
+	{
+		SearchStatus status = SearchStatus::Paused;
+		unsigned long long search_nodes = 0;
+		/** Index in BatchResults::values of the value of the first var of the solution, the other vars follow. Only meaningful when Solved. */
+		int values_offset = 0;
+	};
+
+	/** Results of CSP::SolveBatch() in the order of the instances, the buffers are kept allocated when passed again to the next batch */
+	struct BatchResults
+	{
+		Array<BatchResult> results;
+		/** Solution values of all the instances, one after the other */
+		Array<int> values;
+	};
+
+	/** What the presolve of CSP::FinalizeModel() removed from the model */
+	struct PresolveStats
+	{
+		/** Vars fixed by the root propagation, and vars aliased to the smallest var of their chain of EqualityConstraints */
+		int fixed_vars = 0;
+		int aliased_vars = 0;
+		/** Fixed vars substituted out of LinearConstraints and AllDifferentConstraints */
+		int substituted_terms = 0;
+		/** Constraints disabled as duplicates or dominated by another constraint, and as entailed by the domains */
+		int merged_constraints = 0;
+		int entailed_constraints = 0;
+		/** Whether the root propagation failed, the model is then left as it was after aliasing */
+		bool infeasible = false;
+	};
+
+	/** Direction of the objective of CSP::Optimize() */
+	enum class ObjectiveSense : int
+	{
+		Minimize = 0,
+		Maximize,
+	};
+
+	/** Where CSP::Solve() resumes the search */
+	enum class SearchPoint : int
+	{
+		Descend = 0,	// choose a new var to assign
+		NextValue,		// try next value of the var on top of the search stack
+		Finished,		// search space exhausted
+	};
+
+	/** One decision of the iterative search: var being assigned and current value, or var whose domain is split */
+	struct SearchFrame
+	{
+		SearchFrame() = default;
+		SearchFrame(VarId vid, int val) : var_id(vid), value(val) {}
+
+		VarId var_id = -1;
+		/** Value currently tried, InstVar::UNASSIGNED if none has been tried yet. For split frames, 0 while var <= pivot is tried and 1 for var > pivot. */
+		int value = InstVar::UNASSIGNED;
+		/** The domain of the var is bisected at the pivot instead of assigning the var, which is chosen again by a later frame */
+		bool split = false;
+		/** Split point of split frames, or first value of ValueOrder::Median and Random */
+		int pivot = 0;
+		/** Value tried first, see SearchParams::value_hints */
+		int hint = InstVar::UNASSIGNED;
+		/** Only values in [value_min, value_max) are tried, so that the values of a var can be split between several searches */
+		int value_min = INT_MIN;
+		int value_max = INT_MAX;
+		/** Start of the values of this frame that have already been refuted in Assignment::search_refuted, only recorded with restarts */
+		int refuted_start = 0;
+	};
+
+	/** Part of the search tree: decisions leading to it, and var whose values in the frame window remain to be explored */
+	struct SearchTask
+	{
+		SearchTask() = default;
+
+		Array<SearchFrame> prefix;
+		/** Var and window of values to explore, or var_id == -1 to search the whole tree */
+		SearchFrame frame;
+	};
+
+	/**
+	 * Assignment is a snapshot of the progression of the search algorithm.
+	 * All working variables of the search algorithm goes here.
+	 */
+	class Assignment
+	{
+	public:
+		Assignment();
+		/** Reset the assignment and make it ready for a new solving. */
+		void Reset(const CSP& csp);
+		/**
+		 * Make the assignment ready for a new solving of the model of the last Reset(), keeping all the buffers allocated.
+		 * Only the domains modified since are copied back from the model, and the tie-breaks and static order of Reset() are kept.
+		 * Falls back to Reset() if the model has been edited since.
+		 */
+		void Rewind();
+		/**
+		 * Reduce the root domain of a var to 'val' and propagate it, after Reset() or Rewind() and before the first Solve().
+		 * Returns false if the model becomes infeasible, in which case Solve() fails right away. Undone by the next Rewind().
+		 */
+		bool FixVar(VarId vid, int val);
+		/** Whether all variables have been assigned. */
+		bool IsComplete();
+		int GetInstVarValue(VarId vid) const;
+		const Domain& GetCurrentDomain(VarId vid) const;
+		VarId NextUnassignedVar();
+		void AssignVar(VarId vid, int val);
+		void UnAssignVar(VarId vid);
+		/** Update the incremental state of the constraints that track the assignments of 'vid', see Constraint::TracksAssignments() */
+		void NotifyVarAssigned(VarId vid);
+		void NotifyVarUnassigned(VarId vid);
+		/** Assign a var, validate and propagate its constraints. On failure, the var is left assigned and domains are not restored. */
+		bool TryAssignVar(VarId vid, int val);
+		/** Reduce the domain of a var to the values <= pivot, or > pivot if 'upper', and propagate it. On failure, domains are not restored. */
+		bool TrySplitVar(VarId vid, int pivot, bool upper);
+		/** Try and validate that none of the passed constraints is violated. */
+		bool ValidateVarConstraints(const Var& var) /*const*/;
+		/**
+		 * Reduce the domain of a var that has just been assigned to its value and propagate the domain changes:
+		 * constraints woken up by the changes are queued and applied until no more domain changes, or a domain is wiped out.
+		 */
+		bool PropagateVarConstraints(const Var& var);
+		/** Queue the constraints woken up by the domain changes recorded since the last call. */
+		void FlushDomainEvents();
+		/** Forget the domain changes recorded since the last FlushDomainEvents() */
+		void ClearDomainEvents();
+		/** Copy the bounds and size of the current domain of a var to var_mins, var_maxs and var_sizes */
+		void RefreshVarBounds(VarId vid);
+		/** Apply the queued constraints until fixpoint, or until a constraint fails in which case pending propagation is cleared */
+		bool PropagateQueuedConstraints();
+		/** Forget the queued constraints and the pending domain changes */
+		void ClearPropagation();
+		/** Add a constraint at the back of the propagation queue if it is not already queued, 'wake_pos' is the position of 'wake_vid' in the constraint */
+		void QueueConstraint(Constraint* con, VarId wake_vid, int wake_pos);
+		Constraint* PopQueuedConstraint();
+		/** Helpers for constraint propagators, filter a domain if needed and return false on domain wipe out */
+		bool ExcludeVarInf(VarId vid, long long rmin);
+		bool ExcludeVarSup(VarId vid, long long rmax);
+		bool IntersectVar(VarId vid, long long val);
+		bool ExcludeVar(VarId vid, long long val);
+		/** Keep only the 'count' sorted values of 'sorted_vals' in the domain of a var */
+		bool IntersectVarValues(VarId vid, const int* sorted_vals, int count);
+		/** Notify that a constraint has been violated or has wiped out a domain, so that var heuristics can learn from it. */
+		void OnConstraintFailure(const Constraint& con);
+		/** Working memory of a constraint, kept between nodes and never restored on backtrack, empty after Reset() */
+		Array<int>& GetConstraintState(int con_id) { return con_states[con_id]; }
+		/** Incremental state of a constraint that tracks assignments, see Constraint::TracksAssignments(). Empty after Reset(). */
+		Array<int>& GetConstraintCounters(int con_id) { return con_counters[con_id]; }
+		/** Working memory of a constraint that is restored on backtrack like the domains, empty after Reset(). Modify it with SetConstraintTrailedState() once initialized. */
+		Array<int>& GetConstraintTrailedState(int con_id) { return con_trailed_states[con_id]; }
+		/** Change an int of the trailed state of a constraint, its previous value is backed up once per step */
+		void SetConstraintTrailedState(int con_id, int state_idx, int value);
+		/** Ensure that the variable's domain has been backed up once in this step before we modify it, and record the change for propagation. */
+		void EnsureSavedDomain(VarId vid, const Domain& dom);
+		/** Record the change of a var for propagation, before its domain is modified */
+		void TouchVar(VarId vid, const Domain& dom);
+		/** Back up the values [first, last) of a Values or Ranges domain that are about to be replaced by 'new_count' values, unless the whole domain is already saved in this step */
+		void SaveDomainSplice(VarId vid, const Domain& dom, int first, int last, int new_count);
+		/** Start a new step, domains modified from now on will be backed up on the trail. */
+		void PushSavedDomainStep();
+		/** Restore all the domains saved during this step, typically when a backtrack is needed. The step stays opened. */
+		void RestoreSavedDomainStep();
+		/** Restore all the domains saved during this step and close it. */
+		void PopSavedDomainStep();
+		/** Start a new trail stamp, so that domains are backed up again before their next modification. */
+		void NextTrailStamp();
+
+		/** Compute the key of a var for the dynamic var heuristic, smaller keys are assigned first. */
+		double ComputeVarOrderKey(VarId vid) const;
+		/** Recompute the key of a var and update its position in the order heap, if it is still unassigned. */
+		void UpdateVarOrder(VarId vid);
+		/** Update the order heap with all the domains modified since the last call. */
+		void SyncVarOrder();
+		void OrderHeapInsert(VarId vid);
+		void OrderHeapRemove(VarId vid);
+		void OrderHeapSiftUp(int heap_idx);
+		void OrderHeapSiftDown(int heap_idx);
+		bool OrderHeapBefore(VarId vid0, VarId vid1) const { return order_keys[vid0] < order_keys[vid1] || (order_keys[vid0] == order_keys[vid1] && var_tie_ranks[vid0] < var_tie_ranks[vid1]); }
+		/** New frame branching on 'vid': window tightened to its domain, value hint, and pivot or split according to params.value_order */
+		SearchFrame MakeSearchFrame(VarId vid);
+		/** First value to try for the var of a frame, the value hint if any and then according to params.value_order. The first half to try for split frames. */
+		bool SelectFirstValue(const SearchFrame& frame, int& val) const;
+		/** Next value to try for the var of a frame after frame.value */
+		bool SelectNextValue(const SearchFrame& frame, int& val) const;
+		/** Value hint of the var of a frame, if it remains to be tried in the window of the frame */
+		bool GetValueHint(const SearchFrame& frame, int& hint) const;
+		/** First value, and next value after 'prev_val', in the window of a frame according to params.value_order */
+		bool SelectFirstOrderedValue(const SearchFrame& frame, int& val) const;
+		bool SelectNextOrderedValue(const SearchFrame& frame, int prev_val, int& val) const;
+		/** Replay the decisions of a task and make it the root of the search. Returns false if the task is infeasible. */
+		bool StartSearchTask(const SearchTask& task);
+		/** Give away the upper half of the untried values of the shallowest frame that has some, with ValueOrder::Min. */
+		bool SplitSearchTask(SearchTask& task);
+		/** Shuffle the tie-break ranks of the vars with the random generator */
+		void ShuffleVarTieRanks();
+		/** Sort the vars by initial domain size for VarHeuristic::Static, ties broken by rank */
+		void SortAssignOrder();
+		/** Reset the weights, activities and order heap of the dynamic var heuristics */
+		void ResetVarHeuristics();
+		/** Whether the restart policy asks for a restart now */
+		bool ShouldRestart() const;
+		/** Record the nogoods of the current branch, unwind the search stack to the root and compute the next restart limit */
+		void Restart();
+		/** Record that the decisions of the 'depth' first search frames and 'vid' = 'val' cannot hold together */
+		void AddNogood(int depth, VarId vid, int val);
+		/** Check the nogoods watching 'vid' once it is assigned, and exclude the values that would complete a nogood. Returns false if a nogood holds. */
+		bool PropagateNogoods(VarId vid);
+		/** Set the objective of CSP::Optimize(), the incumbent is forgotten if the objective changes */
+		void SetObjective(VarId vid, ObjectiveSense sense);
+		/** Make the current complete assignment the incumbent, later solutions must be strictly better */
+		void RecordIncumbent();
+		/** Exclude the objective values that are not better than the incumbent and propagate. Returns false on domain wipe out. */
+		bool ApplyObjectiveBound();
+
+		/** Current number of assigned variables, the search algo is finished when all variables have been assigned */
+		int assigned_var_count = 0;
+		/** Current instanced values of the variables */
+		Array<InstVar> inst_vars;
+		/** Current domains, starting from the initial domains and progressively reduced by the searching algo */
+		Array<Domain> current_domains;
+		/**
+		 * Min, max and size of the current domain of each var, in separate contiguous arrays so that scans over all the vars read dense memory.
+		 * Updated when domain changes are flushed: they are exact between propagations, propagators must read current_domains instead.
+		 * Min and max are left unchanged when a domain is wiped out.
+		 */
+		Array<int> var_mins;
+		Array<int> var_maxs;
+		Array<int> var_sizes;
+		/** Trail of backed up domains, undone in LIFO order if the searching algo needs to backtrack */
+		Array<TrailEntry> trail;
+		/** Pool of backed up domain values, referenced by the trail entries */
+		Array<int> trail_values;
+		/** Size of the trail at the beginning of each step */
+		Array<int> trail_steps;
+		/** Stamp of the step where each var domain was last saved on the trail, and where it was last backed up as a whole, so that a domain is saved only once per step */
+		Array<unsigned int> trail_var_stamps;
+		Array<unsigned int> trail_domain_stamps;
+		unsigned int trail_stamp = 1;
+		/** Order in which variables will be processed for assignments, for VarHeuristic::Static */
+		Array<VarId> assign_order;
+		/** Decision stack of CSP::Solve(), and where the search will resume */
+		Array<SearchFrame> search_stack;
+		SearchPoint search_point = SearchPoint::Descend;
+		/** Frames below this depth are fixed decisions of the current task, they are never backtracked */
+		int search_root_depth = 0;
+		/** Number of var assignments tried since Reset() */
+		unsigned long long search_nodes = 0;
+		/** Number of var assignments that failed since Reset(), each one makes the search backtrack */
+		unsigned long long search_backtracks = 0;
+		/** Number of restarts since Reset(), and node count triggering the next one */
+		unsigned long long search_restarts = 0;
+		unsigned long long restart_node_limit = 0;
+		/** Values already refuted for each frame of the search stack, see SearchFrame::refuted_start */
+		Array<int> search_refuted;
+		/** Nogoods recorded at restarts, as (var, value) literals that cannot all hold. Literals of nogood i are the pairs [nogood_offsets[i], nogood_offsets[i + 1]) of nogood_literals. */
+		Array<int> nogood_literals;
+		Array<int> nogood_offsets;
+		/** Nogoods watching each var, the first two literals of a nogood are its watched literals */
+		Array<Array<int>> nogood_watches;
+		/** Var whose assignment failed last, for SearchParams::last_conflict */
+		VarId last_conflict_var = -1;
+		/** Objective of CSP::Optimize(), -1 if none */
+		VarId objective_var = -1;
+		ObjectiveSense objective_sense = ObjectiveSense::Minimize;
+		/** Best solution found so far by CSP::Optimize(), and its objective value */
+		bool has_incumbent = false;
+		int incumbent_value = 0;
+		Array<InstVar> incumbent;
+
+		/** Parameters of the search algorithm, should be set before calling Reset() */
+		SearchParams params;
+		/** The model being solved, and its CSP::model_revision, set in Reset() */
+		const CSP* csp = nullptr;
+		unsigned int model_revision = 0;
+		/** Rank of each var to break ties between equally ranked vars, either var id or random */
+		Array<int> var_tie_ranks;
+		Random random;
+		/** Unassigned vars stored as a binary heap on order_keys, for dynamic var heuristics */
+		Array<VarId> order_heap;
+		/** Position of each var in order_heap, -1 when the var is not in the heap */
+		Array<int> order_heap_pos;
+		Array<double> order_keys;
+		/** Trail position up to which modified domains have been accounted for in the order heap */
+		int order_trail_pos = 0;
+		/** Weights of the constraints, and sum of the weights of the constraints linked to each var, for VarHeuristic::DomWDeg */
+		Array<double> con_weights;
+		Array<double> var_wdeg;
+		/** Activity of the vars and current bump increment, for VarHeuristic::Activity */
+		Array<double> var_activity;
+		double activity_inc = 1.0;
+		/** Propagation queue, a ring buffer of constraints where each constraint is queued at most once */
+		Array<Constraint*> prop_queue;
+		int prop_queue_head = 0;
+		int prop_queue_count = 0;
+		/** Whether each constraint is in the propagation queue, and which var change woke it up, with its position in the constraint */
+		Array<char> prop_queued;
+		Array<VarId> prop_wake_vids;
+		Array<int> prop_wake_pos;
+		/** Vars whose domain may have changed since the last FlushDomainEvents(), their var_mins, var_maxs and var_sizes are still those before the change */
+		Array<VarId> touched_vars;
+		/** Position of each var in touched_vars, -1 if not touched */
+		Array<int> touched_var_pos;
+		/** Working memory of each constraint, see GetConstraintState() */
+		Array<Array<int>> con_states;
+		Array<Array<int>> con_counters;
+		/** Trailed working memory of each constraint, with the stamp of the step where each int was last backed up, see GetConstraintTrailedState() */
+		Array<Array<int>> con_trailed_states;
+		Array<Array<unsigned int>> con_trailed_stamps;
+		/** Trail of backed up constraint states, and its size at the beginning of each step */
+		Array<StateTrailEntry> state_trail;
+		Array<int> state_trail_steps;
+		/** Scratch memory of the propagators, content is undefined between two calls */
+		Array<unsigned long long> prop_scratch_words;
+		Array<int> prop_scratch_values;
+
+#ifdef DEQUAN_WITH_STATS
+		Stats stats;
+#endif
+#ifdef DEQUAN_WITH_TRACE
+		SearchTrace trace;
+#endif
+	};
+
+#ifdef DEQUAN_WITH_MMAP
+	/** Read-only memory mapping of a whole file, the pages are shared by all the processes mapping the same file */
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		/** Map the file at 'path', returns false if it can't be opened or is empty */
+		bool Open(const char* path);
+		void Close();
+		/** Start of the mapping, page aligned */
+		const void* GetData() const { return data; }
+		size_t GetSize() const { return size; }
+
+	private:
+		const void* data = nullptr;
+		size_t size = 0;
+#if defined(_WIN32)
+		void* file_handle = nullptr;
+		void* mapping_handle = nullptr;
+#endif
+	};
+#endif
+
+	/**
+	 * Class representing a Constraint Satisfying Problem.
+	 * This is where you model the problem using variables and constraints.
+	 * Once defined, CSP is static and never modified by the searching algorithm.
+	 */
+	class CSP
 	{
 	public:
 		CSP() = default;
@@ -341,832 +1427,5930 @@ namespace dequan
 		/** Add a new constraint derived from the Constraint class */
 		template <class T>
 		void AddConstraint(const T& con);
-		/** You need to call FinalizeModel() once all var and constraints have been added. */
-		void FinalizeModel();
-		/** Recursive method to solve the CSP. */
+		/** Storage of AddConstraint(), built-in constraints are sorted by kind and any other class is stored in the arena */
+		template <class T>
+		T& StoreConstraint(const T& con);
+		OpConstraint& StoreConstraint(const OpConstraint& con);
+		EqualityConstraint& StoreConstraint(const EqualityConstraint& con);
+		OrEqualityConstraint& StoreConstraint(const OrEqualityConstraint& con);
+		CombinedEqualityConstraint& StoreConstraint(const CombinedEqualityConstraint& con);
+		OrRangeConstraint& StoreConstraint(const OrRangeConstraint& con);
+		AllDifferentConstraint& StoreConstraint(const AllDifferentConstraint& con);
+		LinearConstraint& StoreConstraint(const LinearConstraint& con);
+		TableConstraint& StoreConstraint(const TableConstraint& con);
+		LexConstraint& StoreConstraint(const LexConstraint& con);
+		/**
+		 * Symmetry breaking, declared like constraints before or after FinalizeModel(). Only one solution of each class of symmetric solutions is kept,
+		 * the lexicographically smallest one in var id order, so all the symmetries of a model must be declared through these calls to stay consistent.
+		 * Interchangeable vars: the values of 'vars' can be permuted in any solution, they are ordered by var id with OpConstraints, strictly if 'all_different'.
+		 */
+		void AddInterchangeableVars(const Array<VarId>& vars, bool all_different = false);
+		/**
+		 * Symmetry mapping each solution to another one, where vars[k] takes the value of images[k], or reflection_sum minus that value if 'reflect_values'.
+		 * 'images' must be a permutation of 'vars', and the other vars keep their values. Posts the lex-leader LexConstraint of the symmetry.
+		 * e.g. for n queens on vars q[i], the vertical mirror maps q[i] to q[n - 1 - i], and the horizontal mirror maps q[i] to itself with reflection_sum = n - 1.
+		 * Returns false, without adding anything, if 'images' is not a permutation of 'vars'.
+		 */
+		bool AddVarSymmetry(const Array<VarId>& vars, const Array<VarId>& images, bool reflect_values = false, int reflection_sum = 0);
+		/**
+		 * You need to call FinalizeModel() once all var and constraints have been added.
+		 * With 'presolve', the model is also simplified before the search, see Presolve().
+		 */
+		void FinalizeModel(bool presolve = false);
+		/** Gather the vars of the constraints and link the enabled constraints to their vars */
+		void BuildAdjacency();
+		/**
+		 * Rewrite the model into a smaller one with the same solutions:
+		 * - vars linked by EqualityConstraints are aliased to the smallest one, the other constraints are rewritten on it, and each alias keeps one equality to it,
+		 * - the initial domains are reduced by a propagation of all the constraints to fixpoint,
+		 * - fixed vars, e.g. from AddFixedVar(), are substituted out of the linear and all different constraints,
+		 * - duplicate OpConstraints, or dominated ones on the same two vars, are disabled, and so are the constraints entailed by the domains.
+		 * Domains and constraints are edited in place, so relaxing the model afterwards, by disabling a constraint or widening a domain, is not supported.
+		 * User constraints are neither rewritten nor applied without a woken var, they only see the domain events they listen to.
+		 * Results are in presolve_stats, returns false if the model is proven infeasible.
+		 */
+		bool Presolve();
+		/**
+		 * Edits of a finalized model, AddIntVar() and AddConstraint() can also be called at any time: adjacency is updated locally instead of being rebuilt.
+		 * Constraint ids never change, so removing a constraint is disabling it for good. Assignments must be Reset() or Rewind() after an edit.
+		 */
+		/** Unlink a constraint from its vars, it is then ignored by the search until enabled again */
+		void DisableConstraint(int con_id);
+		void EnableConstraint(int con_id);
+		bool IsConstraintEnabled(int con_id) const { return constraint_enabled[con_id] != 0; }
+		/** Replace the initial domain of a var, e.g. to retract a fixed var */
+		void SetVarDomain(VarId vid, const Domain& domain);
+		/** Link a constraint added to a finalized model, or enabled again, to its vars */
+		void LinkConstraint(int con_id);
+		/** Recompute the union of the wake events of the constraints linked to a var */
+		void UpdateVarWakeEvents(VarId vid);
+		/**
+		 * Flat binary image of a finalized model, with the vars, domains, constraint payloads and adjacency, see LoadModel().
+		 * Returns false if the model is not finalized or has user constraints, which can't be serialized.
+		 */
+		bool SaveModel(Array<unsigned char>& bytes) const;
+		/**
+		 * Replace the model by an image written by SaveModel(), e.g. a file mapped with MappedFile. 'data' must be 8-byte aligned.
+		 * The image is only read, so that one mapping can be shared by several processes, and the adjacency is copied instead of being rebuilt.
+		 * Domain values and constraint payloads reference the image instead of being copied, so it must outlive the model or the next LoadModel().
+		 * Returns false, leaving an empty model, if the image is truncated, corrupted or of another format version.
+		 */
+		bool LoadModel(const void* data, size_t size);
+		/** Version of the SaveModel() format, bumped whenever the layout changes */
+		static constexpr unsigned int MODEL_FORMAT_VERSION = 1;
+		/** Recursive method to solve the CSP, without any limit, following the value order and hints of the params. Use Solve() with a SearchBudget to bound the search. */
 		bool ForwardCheckingStep(Assignment& a) const;
+		/**
+		 * Iterative method to solve the CSP, same search as ForwardCheckingStep() but with an explicit stack.
+		 * The search can be limited by a budget and resumed later by calling Solve() again with the same Assignment.
+		 */
+		SearchStatus Solve(Assignment& a, const SearchBudget& budget = SearchBudget()) const;
+		/**
+		 * Stream solutions to 'callback', a callable taking a 'const Array<InstVar>&' view of the solution and returning false to stop.
+		 * Search stops after 'max_solutions' solutions if not zero. Returns the number of solutions found.
+		 */
+		template <class F>
+		unsigned long long EnumerateSolutions(Assignment& a, F callback, unsigned long long max_solutions = 0) const;
+		/**
+		 * Count solutions without materializing them: values of the last unassigned var are only validated, not assigned.
+		 * Search stops after 'max_solutions' solutions if not zero, or when the budget runs out, in which case the status of the interrupted search is returned in 'status'.
+		 */
+		unsigned long long CountSolutions(Assignment& a, unsigned long long max_solutions = 0, const SearchBudget& budget = SearchBudget(), SearchStatus* status = nullptr) const;
+		/**
+		 * Branch-and-bound in a single search: minimize or maximize the value of 'objective_var'.
+		 * Each solution becomes the incumbent in Assignment::incumbent, and the rest of the search only looks for strictly better ones:
+		 * the bound is applied to the objective domain at every node and propagated like any other domain change.
+		 * 'on_incumbent' is called with each new incumbent, returning false stops the search.
+		 * Returns Solved once the incumbent is proven optimal, Infeasible if there is no solution at all, Cancelled if stopped by the callback,
+		 * or the status of an interrupted search, which can be resumed by calling Optimize() again. The budget applies to the whole call.
+		 */
+		template <class F>
+		SearchStatus Optimize(Assignment& a, VarId objective_var, ObjectiveSense sense, F on_incumbent, const SearchBudget& budget = SearchBudget()) const;
+		SearchStatus Optimize(Assignment& a, VarId objective_var, ObjectiveSense sense, const SearchBudget& budget = SearchBudget()) const;
+		/** Search loop behind Solve() and CountSolutions(), solutions are counted in 'leaf_count' instead of being reported when it is not null. */
+		SearchStatus Search(Assignment& a, const SearchBudget& budget, unsigned long long* leaf_count, unsigned long long max_count) const;
+#ifdef DEQUAN_WITH_THREADS
+		/**
+		 * Portfolio solving: each assignment is reset with its own params and solved in its own thread.
+		 * The first thread to find a solution or prove infeasibility stops the others, its index is returned in 'winner_idx' (-1 if none).
+		 */
+		SearchStatus SolvePortfolio(Array<Assignment>& assignments, int& winner_idx, const SearchBudget& budget = SearchBudget()) const;
+		/**
+		 * Parallel tree search: one thread per assignment, idle threads steal the untried values of the other searches.
+		 * All threads use the params of the first assignment, with ValueOrder::Min. The first solution found stops the search.
+		 */
+		SearchStatus SolveParallel(Array<Assignment>& assignments, int& winner_idx, const SearchBudget& budget = SearchBudget()) const;
+		/** Count solutions with a parallel tree search, see SolveParallel(). */
+		unsigned long long CountSolutionsParallel(Array<Assignment>& assignments, const SearchBudget& budget = SearchBudget()) const;
+		/** Work stealing loop behind SolveParallel() and CountSolutionsParallel(), solutions are counted if 'solution_count' is not null. */
+		SearchStatus ParallelSearch(Array<Assignment>& assignments, int& winner_idx, unsigned long long* solution_count, const SearchBudget& budget) const;
+#endif
+		/**
+		 * Batch solving of many instances of this model, instance i fixes the vars fixed_vars[fixed_offsets[i]] to fixed_vars[fixed_offsets[i + 1]]
+		 * to the values at the same index of 'fixed_values', so 'fixed_offsets' has one more entry than there are instances.
+		 * The first solution of each instance is searched with 'budget', whose deadline and stop flag apply to the whole batch:
+		 * instances that have not started by then get the status Timeout or Cancelled.
+		 * Instances are handed out in chunks to one thread per assignment, and each assignment is only rewound between its instances.
+		 * All the assignments should have the same params, so that the results do not depend on the thread solving each instance.
+		 * Without DEQUAN_WITH_THREADS, the instances are solved in order with the first assignment.
+		 */
+		void SolveBatch(Array<Assignment>& assignments, const Array<int>& fixed_offsets, const Array<VarId>& fixed_vars, const Array<int>& fixed_values,
+			BatchResults& results, const SearchBudget& budget = SearchBudget()) const;
+		/** Batch solving of independent models, same as the other SolveBatch() but each assignment is reset for each model, keeping its buffers allocated */
+		static void SolveBatch(Array<Assignment>& assignments, const Array<const CSP*>& models, BatchResults& results, const SearchBudget& budget = SearchBudget());
 
 		/** All the variables in the model */
 		Array<Var> vars;
-		/** All the constraints in the model */
-		Array<GenericConstraint> constraints;
+		/** All the constraints in the model, indexed by con_id. Pointers are only valid once FinalizeModel() has been called. */
+		Array<Constraint*> constraints;
+		/** Built-in constraints, each kind in its own contiguous array */
+		Array<OpConstraint> op_constraints;
+		Array<EqualityConstraint> equality_constraints;
+		Array<OrEqualityConstraint> or_equality_constraints;
+		Array<CombinedEqualityConstraint> combined_equality_constraints;
+		Array<OrRangeConstraint> or_range_constraints;
+		Array<AllDifferentConstraint> alldiff_constraints;
+		Array<LinearConstraint> linear_constraints;
+		Array<TableConstraint> table_constraints;
+		Array<LexConstraint> lex_constraints;
+		/** Constraints of any other class */
+		ConstraintArena user_constraints;
 		/** Domains of the variables, stored at the same index at the corresponding var */
 		Array<Domain> domains;
+		/** Vars referenced by each constraint by position, constraint_vars[constraint_vars_offsets[con_id]] to constraint_vars[constraint_vars_offsets[con_id + 1]] */
+		Array<int> constraint_vars_offsets;
+		Array<VarId> constraint_vars;
+		/**
+		 * Enabled constraints where each var is referenced, var_links[var_links_offsets[vid]] to var_links[var_links_ends[vid]].
+		 * FinalizeModel() packs the links of all the vars in var order, model edits may move the links of a var to the back of the array with some spare capacity.
+		 */
+		Array<int> var_links_offsets;
+		Array<int> var_links_ends;
+		Array<int> var_links_capacities;
+		Array<ConstraintLink> var_links;
+		/** Subset of var_links with the constraints that track assignments, see Constraint::TracksAssignments() */
+		Array<int> tracked_links_offsets;
+		Array<int> tracked_links_ends;
+		Array<int> tracked_links_capacities;
+		Array<ConstraintLink> tracked_links;
+		/** Whether each constraint is linked to its vars, see DisableConstraint() */
+		Array<char> constraint_enabled;
+		/** Whether FinalizeModel() has been called, vars and constraints are then linked as soon as they are added */
+		bool finalized = false;
+		/** Incremented by each edit of a finalized model, so that Assignment::Rewind() knows when the assignment must be Reset() */
+		unsigned int model_revision = 0;
+		/** Constraint::TracksAssignments() of each constraint, cached by FinalizeModel() */
+		Array<char> constraint_tracks_assignments;
+		/** Constraint::GetWakeEvents() of each constraint, cached by FinalizeModel() */
+		Array<int> constraint_wake_events;
+		/** Union of the wake events of the constraints linked to each var, so that changes nobody listens to are skipped */
+		Array<int> var_wake_events;
+		/** Result of the last Presolve() */
+		PresolveStats presolve_stats;
 	};
 
+	template <class F>
+	unsigned long long CSP::EnumerateSolutions(Assignment& a, F callback, unsigned long long max_solutions) const
+	{
+		unsigned long long solution_count = 0;
+		while ((max_solutions == 0 || solution_count < max_solutions) && Solve(a) == SearchStatus::Solved)
+		{
+			solution_count++;
+			const Array<InstVar>& solution = a.inst_vars;
+			if (!callback(solution))
+			{
+				break;
+			}
+		}
+		return solution_count;
+	}
+
+	template <class F>
+	SearchStatus CSP::Optimize(Assignment& a, VarId objective_var, ObjectiveSense sense, F on_incumbent, const SearchBudget& budget) const
+	{
+		a.SetObjective(objective_var, sense);
+
+		// Each improving solution ends a call to Search(), the budget is turned into absolute limits for the whole optimization
+		const unsigned long long node_limit = budget.max_nodes > 0 ? a.search_nodes + budget.max_nodes : 0;
+		const unsigned long long backtrack_limit = budget.max_backtracks > 0 ? a.search_backtracks + budget.max_backtracks : 0;
+		SearchBudget step_budget = budget;
+		step_budget.max_seconds = 0.0;
+		step_budget.deadline = budget.GetDeadline(std::chrono::steady_clock::now());
+		while (true)
+		{
+			if ((node_limit > 0 && a.search_nodes >= node_limit) || (backtrack_limit > 0 && a.search_backtracks >= backtrack_limit))
+			{
+				return SearchStatus::Paused;
+			}
+			step_budget.max_nodes = node_limit > 0 ? node_limit - a.search_nodes : 0;
+			step_budget.max_backtracks = backtrack_limit > 0 ? backtrack_limit - a.search_backtracks : 0;
+			SearchStatus status = Search(a, step_budget, nullptr, 0);
+			if (status != SearchStatus::Solved)
+			{
+				// Exhausting the search space proves the optimality of the incumbent
+				return status == SearchStatus::Infeasible && a.has_incumbent ? SearchStatus::Solved : status;
+			}
+			a.RecordIncumbent();
+			const Array<InstVar>& incumbent = a.incumbent;
+			if (!on_incumbent(incumbent))
+			{
+				return SearchStatus::Cancelled;
+			}
+		}
+	}
+
 }; /*namespace dequan*/
 
 #ifdef DEQUAN_IMPLEMENTATION
 
+#ifdef DEQUAN_WITH_MMAP
+	#if defined(_WIN32)
+		#ifndef NOMINMAX
+			#define NOMINMAX
+		#endif
+		#ifndef WIN32_LEAN_AND_MEAN
+			#define WIN32_LEAN_AND_MEAN
+		#endif
+		#include <windows.h>
+	#else
+		#include <sys/mman.h>
+		#include <sys/stat.h>
+		#include <fcntl.h>
+		#include <unistd.h>
+	#endif
+#endif
+
 namespace dequan
 {
-	Assignment::Assignment() {}
-
-	void Assignment::Reset(const CSP& csp)
+#ifdef DEQUAN_WITH_STATS
+	void ConstraintStats::Add(const ConstraintStats& other)
 	{
-		assigned_var_count = 0;
-
-		DEQUAN_Array_Clear(inst_vars);
-		DEQUAN_Array_Resize(inst_vars, DEQUAN_Array_Size(csp.vars));
-
-		current_domains = csp.domains;
-		DEQUAN_Array_Clear(saved_domains);
-		DEQUAN_Array_Reserve(saved_domains, DEQUAN_Array_Size(csp.vars));
-
-		// Compute order of assignements, smaller domains go first (especially constant variables)
-		DEQUAN_Array_Clear(assign_order);
-		DEQUAN_Array_Resize(assign_order, DEQUAN_Array_Size(csp.vars));
-		for (int d_idx = 0; d_idx < DEQUAN_Array_Size(assign_order); d_idx++)
+		propagations += other.propagations;
+		prunings += other.prunings;
+		wipeouts += other.wipeouts;
+		validations += other.validations;
+		violations += other.violations;
+		cycles += other.cycles;
+	}
+	void Stats::Clear(int con_count, int var_count)
+	{
+		validated_constraints = 0;
+		applied_arcs = 0;
+		assigned_vars = 0;
+		DEQUAN_Array_Clear(constraint_stats);
+		DEQUAN_Array_Resize(constraint_stats, con_count);
+		DEQUAN_Array_Clear(depth_histogram);
+		DEQUAN_Array_Resize(depth_histogram, var_count);
+		DEQUAN_Array_Clear(backtrack_histogram);
+		DEQUAN_Array_Resize(backtrack_histogram, var_count);
+	}
+	ConstraintStats Stats::GetKindStats(const CSP& csp, ConstraintKind kind) const
+	{
+		ConstraintStats kind_stats;
+		for (int c_idx = 0; c_idx < DEQUAN_Array_Size(constraint_stats); c_idx++)
 		{
-			assign_order[d_idx] = d_idx;
-		}
-
-		DEQUAN_Array_Sort(assign_order,
-			[this](const VarId& a, const VarId& b) -> bool
+			if (csp.constraints[c_idx]->kind == kind)
 			{
-				int sa = current_domains[a].Size();
-				int sb = current_domains[b].Size();
-				if (sa == sb)
-				{
-					return a < b;
-				}
-				return sa < sb;
-			});
+				kind_stats.Add(constraint_stats[c_idx]);
+			}
+		}
+		return kind_stats;
 	}
-
-	bool Assignment::IsComplete()
+	unsigned long long Stats::StartTiming() const
 	{
-		return assigned_var_count == DEQUAN_Array_Size(inst_vars);
+#ifdef DEQUAN_WITH_CYCLE_STATS
+		return ReadCycleCounter();
+#else
+		return 0;
+#endif
 	}
-
-	const Domain& Assignment::GetCurrentDomain(VarId vid) const
+	void Stats::RecordPropagation(int con_id, bool success, int pruned_vars, unsigned long long start_cycles)
 	{
-		return current_domains[vid];
+		ConstraintStats& con_stats = constraint_stats[con_id];
+		con_stats.propagations++;
+		if (success)
+		{
+			con_stats.prunings += pruned_vars;
+		}
+		else
+		{
+			con_stats.wipeouts++;
+		}
+#ifdef DEQUAN_WITH_CYCLE_STATS
+		con_stats.cycles += ReadCycleCounter() - start_cycles;
+#endif
 	}
-	int Assignment::GetInstVarValue(VarId vid) const
+	void Stats::RecordValidation(int con_id, bool violated)
 	{
-		return inst_vars[vid].value;
+		ConstraintStats& con_stats = constraint_stats[con_id];
+		con_stats.validations++;
+		con_stats.violations += violated ? 1 : 0;
 	}
+#endif
 
-	VarId Assignment::NextUnassignedVar()
+#ifdef DEQUAN_WITH_TRACE
+	void SearchTrace::Clear()
 	{
-		return assign_order[assigned_var_count];
+		DEQUAN_Array_Clear(bytes);
 	}
-
-	void Assignment::AssignVar(VarId vid, int val)
+	void SearchTrace::Record(TraceEvent event)
 	{
-		inst_vars[vid].value = val;
-		assigned_var_count++;
-#ifdef DEQUAN_WITH_STATS
-		stats.assigned_vars++;
-#endif
+		DEQUAN_Array_PushBack(bytes, (unsigned char)event);
 	}
-
-	void Assignment::UnAssignVar(VarId vid)
+	void SearchTrace::RecordDecision(TraceEvent event, int depth, VarId vid, int val)
 	{
-		inst_vars[vid].value = InstVar::UNASSIGNED;
-		assigned_var_count--;
+		DEQUAN_Array_PushBack(bytes, (unsigned char)event);
+		WriteVarint((unsigned int)depth);
+		WriteVarint((unsigned int)vid);
+		// Zigzag encoding keeps small negative values short
+		WriteVarint(((unsigned int)val << 1) ^ (unsigned int)(val >> 31));
 	}
-
-	void Assignment::RestoreSavedDomainStep()
+	void SearchTrace::WriteVarint(unsigned int value)
 	{
-		SavedDomains& domain_step = DEQUAN_Array_Back(saved_domains);
-		for (int d_idx = 0; d_idx < DEQUAN_Array_Size(domain_step.domains); d_idx++)
+		while (value >= 0x80)
 		{
-			VarId vid = domain_step.domains[d_idx].var_id;
-			current_domains[vid].type = domain_step.domains[d_idx].type;
-			current_domains[vid].values = domain_step.domains[d_idx].values;
+			DEQUAN_Array_PushBack(bytes, (unsigned char)(value | 0x80));
+			value >>= 7;
 		}
+		DEQUAN_Array_PushBack(bytes, (unsigned char)value);
 	}
-
-	void Assignment::EnsureSavedDomain(VarId vid, const Domain& dom)
+	bool TraceReader::Next(TraceRecord& record)
 	{
-		SavedDomains& domain_step = DEQUAN_Array_Back(saved_domains);
-		for (int d_idx = 0; d_idx < DEQUAN_Array_Size(domain_step.domains); d_idx++)
+		if (pos >= size)
 		{
-			if (domain_step.domains[d_idx].var_id == vid)
-				return;
+			return false;
 		}
-		SavedDomain new_dom{ vid, dom.type, dom.values };
-		DEQUAN_Array_PushBack(domain_step.domains, std::move(new_dom));
-	}
-
-	VarId CSP::AddIntVar(const Domain& domain)
-	{
-		Var new_var = { (VarId)DEQUAN_Array_Size(vars), {} };
-		DEQUAN_Array_PushBack(vars, new_var);
-		DEQUAN_Array_PushBack(domains, domain);
-
-		return new_var.var_id;
-	}
-	VarId CSP::AddIntVar(int min_val, int max_val)
-	{
-		Domain new_dom = { DomainType::Ranges, {min_val, max_val} };
-		return AddIntVar(new_dom);
+		record.event = (TraceEvent)bytes[pos++];
+		if (record.event != TraceEvent::Assign && record.event != TraceEvent::SplitLow && record.event != TraceEvent::SplitHigh)
+		{
+			return true;
+		}
+		unsigned int depth = 0, vid = 0, zigzag = 0;
+		if (!ReadVarint(depth) || !ReadVarint(vid) || !ReadVarint(zigzag))
+		{
+			return false;
+		}
+		record.depth = (int)depth;
+		record.var_id = (VarId)vid;
+		record.value = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+		return true;
 	}
-	VarId CSP::AddFixedVar(int val)
+	bool TraceReader::ReadVarint(unsigned int& value)
 	{
-		Domain new_dom = { DomainType::Values, {val} };
-		return AddIntVar(new_dom);
+		value = 0;
+		for (int shift = 0; shift < 35 && pos < size; shift += 7)
+		{
+			unsigned char byte = bytes[pos++];
+			value |= (unsigned int)(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
 	}
-	VarId CSP::AddBoolVar()
+#endif
+
+	Assignment::Assignment() {}
+
+	void Assignment::Reset(const CSP& _csp)
 	{
-		Domain new_dom = { DomainType::Values, {0, 1} };
-		return AddIntVar(new_dom);
-	}
-	template <class T>
-	void CSP::AddConstraint(const T& con)
+		const CSP& csp = _csp;
+		this->csp = &_csp;
+		model_revision = csp.model_revision;
+		assigned_var_count = 0;
+
+		DEQUAN_Array_Clear(inst_vars);
+		DEQUAN_Array_Resize(inst_vars, DEQUAN_Array_Size(csp.vars));
+
+		current_domains = csp.domains;
+		DEQUAN_Array_Resize(var_mins, DEQUAN_Array_Size(csp.vars));
+		DEQUAN_Array_Resize(var_maxs, DEQUAN_Array_Size(csp.vars));
+		DEQUAN_Array_Resize(var_sizes, DEQUAN_Array_Size(csp.vars));
+		for (int v_idx = 0; v_idx < DEQUAN_Array_Size(csp.vars); v_idx++)
+		{
+			RefreshVarBounds(v_idx);
+		}
+		DEQUAN_Array_Clear(trail);
+		DEQUAN_Array_Clear(trail_values);
+		DEQUAN_Array_Clear(trail_steps);
+		DEQUAN_Array_Reserve(trail_steps, DEQUAN_Array_Size(csp.vars));
+		DEQUAN_Array_Clear(trail_var_stamps);
+		DEQUAN_Array_Resize(trail_var_stamps, DEQUAN_Array_Size(csp.vars));
+		DEQUAN_Array_Clear(trail_domain_stamps);
+		DEQUAN_Array_Resize(trail_domain_stamps, DEQUAN_Array_Size(csp.vars));
+		trail_stamp = 1;
+
+		DEQUAN_Array_Clear(search_stack);
+		DEQUAN_Array_Reserve(search_stack, DEQUAN_Array_Size(csp.vars));
+		search_point = SearchPoint::Descend;
+		search_root_depth = 0;
+		search_nodes = 0;
+		search_backtracks = 0;
+		search_restarts = 0;
+		restart_node_limit = params.restart_base;
+		DEQUAN_Array_Clear(search_refuted);
+		DEQUAN_Array_Clear(nogood_literals);
+		DEQUAN_Array_Clear(nogood_offsets);
+		DEQUAN_Array_PushBack(nogood_offsets, 0);
+		DEQUAN_Array_Clear(nogood_watches);
+		DEQUAN_Array_Resize(nogood_watches, DEQUAN_Array_Size(csp.vars));
+		last_conflict_var = -1;
+		objective_var = -1;
+		has_incumbent = false;
+#ifdef DEQUAN_WITH_STATS
+		stats.Clear((int)DEQUAN_Array_Size(csp.constraints), (int)DEQUAN_Array_Size(csp.vars));
+#endif
+#ifdef DEQUAN_WITH_TRACE
+		trace.Clear();
+#endif
+
+		// Tie-break ranks of the vars, shuffled if a random seed is given
+		random = Random(params.random_seed);
+		DEQUAN_Array_Clear(var_tie_ranks);
+		DEQUAN_Array_Resize(var_tie_ranks, DEQUAN_Array_Size(csp.vars));
+		for (int v_idx = 0; v_idx < DEQUAN_Array_Size(var_tie_ranks); v_idx++)
+		{
+			var_tie_ranks[v_idx] = v_idx;
+		}
+		if (params.random_seed != 0)
+		{
+			ShuffleVarTieRanks();
+		}
+
+		// Compute order of assignements, smaller domains go first (especially constant variables)
+		DEQUAN_Array_Clear(assign_order);
+		DEQUAN_Array_Resize(assign_order, DEQUAN_Array_Size(csp.vars));
+		for (int d_idx = 0; d_idx < DEQUAN_Array_Size(assign_order); d_idx++)
+		{
+			assign_order[d_idx] = d_idx;
+		}
+		SortAssignOrder();
+
+		// Propagation queue, each constraint is queued at most once
+		int con_count = (int)DEQUAN_Array_Size(csp.constraints);
+		DEQUAN_Array_Clear(prop_queue);
+		DEQUAN_Array_Resize(prop_queue, con_count);
+		DEQUAN_Array_Clear(prop_queued);
+		DEQUAN_Array_Resize(prop_queued, con_count);
+		DEQUAN_Array_Clear(prop_wake_vids);
+		DEQUAN_Array_Resize(prop_wake_vids, con_count);
+		DEQUAN_Array_Clear(prop_wake_pos);
+		DEQUAN_Array_Resize(prop_wake_pos, con_count);
+		prop_queue_head = 0;
+		prop_queue_count = 0;
+		DEQUAN_Array_Clear(con_states);
+		DEQUAN_Array_Resize(con_states, con_count);
+		DEQUAN_Array_Clear(con_counters);
+		DEQUAN_Array_Resize(con_counters, con_count);
+		DEQUAN_Array_Clear(con_trailed_states);
+		DEQUAN_Array_Resize(con_trailed_states, con_count);
+		DEQUAN_Array_Clear(con_trailed_stamps);
+		DEQUAN_Array_Resize(con_trailed_stamps, con_count);
+		DEQUAN_Array_Clear(state_trail);
+		DEQUAN_Array_Clear(state_trail_steps);
+		DEQUAN_Array_Clear(touched_vars);
+		DEQUAN_Array_Clear(touched_var_pos);
+		DEQUAN_Array_Resize(touched_var_pos, DEQUAN_Array_Size(csp.vars));
+		for (int v_idx = 0; v_idx < DEQUAN_Array_Size(touched_var_pos); v_idx++)
+		{
+			touched_var_pos[v_idx] = -1;
+		}
+
+		ResetVarHeuristics();
+	}
+
+	void Assignment::ResetVarHeuristics()
+	{
+		const CSP& csp = *this->csp;
+		DEQUAN_Array_Clear(order_heap);
+		DEQUAN_Array_Clear(order_heap_pos);
+		DEQUAN_Array_Clear(order_keys);
+		order_trail_pos = 0;
+		if (params.var_heuristic != VarHeuristic::Static)
+		{
+			int var_count = (int)DEQUAN_Array_Size(csp.vars);
+			DEQUAN_Array_Clear(con_weights);
+			DEQUAN_Array_Resize(con_weights, DEQUAN_Array_Size(csp.constraints));
+			for (int c_idx = 0; c_idx < DEQUAN_Array_Size(con_weights); c_idx++)
+			{
+				con_weights[c_idx] = 1.0;
+			}
+			DEQUAN_Array_Clear(var_wdeg);
+			DEQUAN_Array_Clear(var_activity);
+			DEQUAN_Array_Resize(var_wdeg, var_count);
+			DEQUAN_Array_Resize(var_activity, var_count);
+			activity_inc = 1.0;
+
+			DEQUAN_Array_Resize(order_heap_pos, var_count);
+			DEQUAN_Array_Resize(order_keys, var_count);
+			DEQUAN_Array_Reserve(order_heap, var_count);
+			for (int v_idx = 0; v_idx < var_count; v_idx++)
+			{
+				var_wdeg[v_idx] = (double)(csp.var_links_ends[v_idx] - csp.var_links_offsets[v_idx]);
+				var_activity[v_idx] = 0.0;
+				order_heap_pos[v_idx] = -1;
+				OrderHeapInsert(v_idx);
+			}
+		}
+	}
+
+	void Assignment::Rewind()
+	{
+		const CSP& csp = *this->csp;
+		if (model_revision != csp.model_revision || (params.var_heuristic != VarHeuristic::Static && DEQUAN_Array_Size(order_heap_pos) != DEQUAN_Array_Size(csp.vars)))
+		{
+			// The model has been edited, or the heuristic changed and its buffers are missing
+			Reset(csp);
+			return;
+		}
+
+		// Every modified domain has been backed up on the trail, including the root changes of FixVar() and restarts
+		for (int t_idx = 0; t_idx < DEQUAN_Array_Size(trail); t_idx++)
+		{
+			VarId vid = trail[t_idx].var_id;
+			current_domains[vid] = csp.domains[vid];
+			RefreshVarBounds(vid);
+		}
+		DEQUAN_Array_Clear(trail);
+		DEQUAN_Array_Clear(trail_values);
+		DEQUAN_Array_Clear(trail_steps);
+		DEQUAN_Array_Clear(state_trail);
+		DEQUAN_Array_Clear(state_trail_steps);
+		NextTrailStamp();
+
+		for (int v_idx = 0; v_idx < DEQUAN_Array_Size(inst_vars); v_idx++)
+		{
+			inst_vars[v_idx].value = InstVar::UNASSIGNED;
+		}
+		assigned_var_count = 0;
+
+		DEQUAN_Array_Clear(search_stack);
+		search_point = SearchPoint::Descend;
+		search_root_depth = 0;
+		search_nodes = 0;
+		search_backtracks = 0;
+		search_restarts = 0;
+		restart_node_limit = params.restart_base;
+		DEQUAN_Array_Clear(search_refuted);
+		DEQUAN_Array_Clear(nogood_literals);
+		DEQUAN_Array_Clear(nogood_offsets);
+		DEQUAN_Array_PushBack(nogood_offsets, 0);
+		for (int v_idx = 0; v_idx < DEQUAN_Array_Size(nogood_watches); v_idx++)
+		{
+			DEQUAN_Array_Clear(nogood_watches[v_idx]);
+		}
+		last_conflict_var = -1;
+		objective_var = -1;
+		has_incumbent = false;
+#ifdef DEQUAN_WITH_STATS
+		stats.Clear((int)DEQUAN_Array_Size(csp.constraints), (int)DEQUAN_Array_Size(csp.vars));
+#endif
+#ifdef DEQUAN_WITH_TRACE
+		trace.Clear();
+#endif
+
+		// Constraint states are emptied but keep their storage
+		ClearPropagation();
+		for (int c_idx = 0; c_idx < DEQUAN_Array_Size(con_states); c_idx++)
+		{
+			DEQUAN_Array_Clear(con_states[c_idx]);
+			DEQUAN_Array_Clear(con_counters[c_idx]);
+			DEQUAN_Array_Clear(con_trailed_states[c_idx]);
+			DEQUAN_Array_Clear(con_trailed_stamps[c_idx]);
+		}
+
+		ResetVarHeuristics();
+	}
+
+	bool Assignment::FixVar(VarId vid, int val)
+	{
+		if (search_point == SearchPoint::Finished)
+		{
+			// A previous call already made the model infeasible, domains may be wiped out
+			return false;
+		}
+		bool success = IntersectVar(vid, val);
+		if (success)
+		{
+			FlushDomainEvents();
+			success = PropagateQueuedConstraints();
+		}
+		else
+		{
+			ClearPropagation();
+		}
+		if (!success)
+		{
+			search_point = SearchPoint::Finished;
+		}
+		return success;
+	}
+
+	void Assignment::ShuffleVarTieRanks()
+	{
+		for (int v_idx = (int)DEQUAN_Array_Size(var_tie_ranks) - 1; v_idx > 0; v_idx--)
+		{
+			int swap_idx = (int)random.Next((unsigned int)v_idx + 1);
+			int rank = var_tie_ranks[v_idx];
+			var_tie_ranks[v_idx] = var_tie_ranks[swap_idx];
+			var_tie_ranks[swap_idx] = rank;
+		}
+	}
+	void Assignment::SortAssignOrder()
+	{
+		DEQUAN_Array_Sort(assign_order,
+			[this](const VarId& a, const VarId& b) -> bool
+			{
+				int sa = var_sizes[a];
+				int sb = var_sizes[b];
+				if (sa == sb)
+				{
+					return var_tie_ranks[a] < var_tie_ranks[b];
+				}
+				return sa < sb;
+			});
+	}
+
+	bool Assignment::IsComplete()
+	{
+		return assigned_var_count == DEQUAN_Array_Size(inst_vars);
+	}
+
+	const Domain& Assignment::GetCurrentDomain(VarId vid) const
+	{
+		return current_domains[vid];
+	}
+	int Assignment::GetInstVarValue(VarId vid) const
+	{
+		return inst_vars[vid].value;
+	}
+
+	VarId Assignment::NextUnassignedVar()
+	{
+		if (params.var_heuristic == VarHeuristic::Static)
+		{
+			return assign_order[assigned_var_count];
+		}
+
+		SyncVarOrder();
+		if (params.var_heuristic == VarHeuristic::Activity)
+		{
+			// Decay all activities at each node, by increasing the bump increment instead
+			activity_inc /= params.activity_decay;
+		}
+		if (params.last_conflict && last_conflict_var >= 0 && inst_vars[last_conflict_var].value == InstVar::UNASSIGNED)
+		{
+			return last_conflict_var;
+		}
+		return order_heap[0];
+	}
+
+	void Assignment::AssignVar(VarId vid, int val)
+	{
+		inst_vars[vid].value = val;
+		NotifyVarAssigned(vid);
+		assigned_var_count++;
+		search_nodes++;
+		if (params.var_heuristic != VarHeuristic::Static)
+		{
+			OrderHeapRemove(vid);
+		}
+#ifdef DEQUAN_WITH_STATS
+		stats.assigned_vars++;
+		stats.depth_histogram[assigned_var_count - 1]++;
+#endif
+	}
+
+	void Assignment::UnAssignVar(VarId vid)
+	{
+		NotifyVarUnassigned(vid);
+		inst_vars[vid].value = InstVar::UNASSIGNED;
+		assigned_var_count--;
+		if (params.var_heuristic != VarHeuristic::Static)
+		{
+			OrderHeapInsert(vid);
+		}
+	}
+
+	void Assignment::NotifyVarAssigned(VarId vid)
+	{
+		for (int l_idx = csp->tracked_links_offsets[vid]; l_idx < csp->tracked_links_ends[vid]; l_idx++)
+		{
+			const ConstraintLink& link = csp->tracked_links[l_idx];
+			link.con->OnVarAssigned(*this, vid, link.var_pos);
+		}
+	}
+	void Assignment::NotifyVarUnassigned(VarId vid)
+	{
+		for (int l_idx = csp->tracked_links_offsets[vid]; l_idx < csp->tracked_links_ends[vid]; l_idx++)
+		{
+			const ConstraintLink& link = csp->tracked_links[l_idx];
+			link.con->OnVarUnassigned(*this, vid, link.var_pos);
+		}
+	}
+	bool Assignment::TryAssignVar(VarId vid, int val)
+	{
+		const Var& var = csp->vars[vid];
+#ifdef DEQUAN_WITH_TRACE
+		trace.RecordDecision(TraceEvent::Assign, assigned_var_count, vid, val);
+#endif
+		AssignVar(vid, val);
+		// Restrict domain of other variables, by removing values that would violate linked constraints
+		if (ValidateVarConstraints(var) && PropagateVarConstraints(var))
+		{
+			if (last_conflict_var == vid)
+			{
+				last_conflict_var = -1;
+			}
+			return true;
+		}
+		search_backtracks++;
+		last_conflict_var = vid;
+#ifdef DEQUAN_WITH_STATS
+		stats.backtrack_histogram[assigned_var_count - 1]++;
+#endif
+#ifdef DEQUAN_WITH_TRACE
+		trace.Record(TraceEvent::Fail);
+#endif
+		return false;
+	}
+
+	bool Assignment::TrySplitVar(VarId vid, int pivot, bool upper)
+	{
+#ifdef DEQUAN_WITH_TRACE
+		trace.RecordDecision(upper ? TraceEvent::SplitHigh : TraceEvent::SplitLow, assigned_var_count, vid, pivot);
+#endif
+		search_nodes++;
+		// Both halves of the domain are non-empty, only propagation can fail
+		bool success = upper ? ExcludeVarInf(vid, (long long)pivot + 1) : ExcludeVarSup(vid, (long long)pivot + 1);
+		if (success)
+		{
+			FlushDomainEvents();
+			if (has_incumbent)
+			{
+				success = ApplyObjectiveBound();
+			}
+		}
+		if (!success)
+		{
+			ClearPropagation();
+		}
+		if (success && PropagateQueuedConstraints())
+		{
+			if (last_conflict_var == vid)
+			{
+				last_conflict_var = -1;
+			}
+			return true;
+		}
+		search_backtracks++;
+		last_conflict_var = vid;
+#ifdef DEQUAN_WITH_STATS
+		stats.backtrack_histogram[assigned_var_count]++;
+#endif
+#ifdef DEQUAN_WITH_TRACE
+		trace.Record(TraceEvent::Fail);
+#endif
+		return false;
+	}
+
+	SearchFrame Assignment::MakeSearchFrame(VarId vid)
+	{
+		SearchFrame frame(vid, InstVar::UNASSIGNED);
+		const Domain& dom = current_domains[vid];
+		if (dom.IsEmpty())
+		{
+			return frame;
+		}
+		// Tighten the window to the domain, so that it can be split evenly
+		const int dom_min = var_mins[vid];
+		const int dom_max = var_maxs[vid];
+		frame.value_min = dom_min;
+		frame.value_max = dom_max < INT_MAX ? dom_max + 1 : INT_MAX;
+
+		if (params.value_hint_callback != nullptr)
+		{
+			frame.hint = params.value_hint_callback(*this, vid, params.value_hint_user_data);
+		}
+		else if (vid < DEQUAN_Array_Size(params.value_hints))
+		{
+			frame.hint = params.value_hints[vid];
+		}
+
+		if (params.value_order == ValueOrder::Split)
+		{
+			frame.split = var_sizes[vid] >= (params.split_min_size > 2 ? params.split_min_size : 2);
+			// Midpoint of the bounds, rounded down, so that both halves are non-empty
+			frame.pivot = (int)(((long long)dom_min + dom_max) >> 1);
+		}
+		else if (params.value_order == ValueOrder::Median)
+		{
+			frame.pivot = dom.GetValue((var_sizes[vid] - 1) / 2);
+		}
+		else if (params.value_order == ValueOrder::Random)
+		{
+			frame.pivot = dom.GetValue((int)random.Next((unsigned int)var_sizes[vid]));
+		}
+		return frame;
+	}
+
+	bool Assignment::SelectFirstValue(const SearchFrame& frame, int& val) const
+	{
+		if (frame.split)
+		{
+			// The half containing the hint first
+			int hint = 0;
+			val = GetValueHint(frame, hint) && hint > frame.pivot ? 1 : 0;
+			return true;
+		}
+		return GetValueHint(frame, val) || SelectFirstOrderedValue(frame, val);
+	}
+
+	bool Assignment::SelectNextValue(const SearchFrame& frame, int& val) const
+	{
+		if (frame.split)
+		{
+			int first_half = 0;
+			SelectFirstValue(frame, first_half);
+			val = 1 - first_half;
+			return frame.value == first_half;
+		}
+		int hint = 0;
+		if (!GetValueHint(frame, hint))
+		{
+			return SelectNextOrderedValue(frame, frame.value, val);
+		}
+		// The hint is tried first, and skipped when it comes in order
+		bool has_value = frame.value == hint ? SelectFirstOrderedValue(frame, val) : SelectNextOrderedValue(frame, frame.value, val);
+		if (has_value && val == hint)
+		{
+			has_value = SelectNextOrderedValue(frame, hint, val);
+		}
+		return has_value;
+	}
+
+	bool Assignment::GetValueHint(const SearchFrame& frame, int& hint) const
+	{
+		hint = frame.hint;
+		return hint != InstVar::UNASSIGNED && hint >= frame.value_min && hint < frame.value_max && current_domains[frame.var_id].Contains(hint);
+	}
+
+	bool Assignment::SelectFirstOrderedValue(const SearchFrame& frame, int& val) const
+	{
+		const Domain& dom = current_domains[frame.var_id];
+		if (dom.IsEmpty())
+		{
+			return false;
+		}
+		if (params.value_order == ValueOrder::Max)
+		{
+			val = dom.Max();
+			return (val < frame.value_max || dom.PrevValue(frame.value_max, val)) && val >= frame.value_min;
+		}
+		if (params.value_order == ValueOrder::Median || params.value_order == ValueOrder::Random)
+		{
+			if (frame.pivot >= frame.value_min && frame.pivot < frame.value_max && dom.Contains(frame.pivot))
+			{
+				val = frame.pivot;
+				return true;
+			}
+			// The pivot is not in the window, continue in order as if it had been tried
+			return SelectNextOrderedValue(frame, frame.pivot, val);
+		}
+		val = dom.Min();
+		return (val >= frame.value_min || dom.NextValue(frame.value_min - 1, val)) && val < frame.value_max;
+	}
+
+	/** Rank of a value in ValueOrder::Median: 0 for the pivot, then 1 for the next value above, 2 for the next one below... */
+	static long long MedianOrderRank(long long val, long long pivot)
+	{
+		return val <= pivot ? 2 * (pivot - val) : 2 * (val - pivot) - 1;
+	}
+
+	bool Assignment::SelectNextOrderedValue(const SearchFrame& frame, int prev_val, int& val) const
+	{
+		const Domain& dom = current_domains[frame.var_id];
+		if (params.value_order == ValueOrder::Max)
+		{
+			return dom.PrevValue(prev_val, val) && val >= frame.value_min;
+		}
+		if (params.value_order == ValueOrder::Median)
+		{
+			// Closest values of larger rank below and above the pivot, the one of smaller rank comes next
+			const long long prev_rank = MedianOrderRank(prev_val, frame.pivot);
+			const long long below_limit = (long long)frame.pivot - prev_rank / 2;
+			const long long above_limit = (long long)frame.pivot + (prev_rank + 1) / 2;
+			int below = 0, above = 0;
+			bool has_below = below_limit > frame.value_min && dom.PrevValue((int)below_limit, below) && below >= frame.value_min;
+			bool has_above = above_limit < frame.value_max && dom.NextValue((int)above_limit, above) && above < frame.value_max;
+			if (has_below && (!has_above || MedianOrderRank(below, frame.pivot) < MedianOrderRank(above, frame.pivot)))
+			{
+				val = below;
+				return true;
+			}
+			val = above;
+			return has_above;
+		}
+		if (params.value_order == ValueOrder::Random && prev_val >= frame.pivot)
+		{
+			// Values above the random pivot, then wrap around to the values below it
+			if (dom.NextValue(prev_val, val) && val < frame.value_max)
+			{
+				return true;
+			}
+			val = dom.Min();
+			return (val >= frame.value_min || dom.NextValue(frame.value_min - 1, val)) && val < frame.value_max && val < frame.pivot;
+		}
+		if (params.value_order == ValueOrder::Random)
+		{
+			return dom.NextValue(prev_val, val) && val < frame.value_max && val < frame.pivot;
+		}
+		return dom.NextValue(prev_val, val) && val < frame.value_max;
+	}
+
+	/** i-th term of the Luby sequence, starting at i = 1: 1 1 2 1 1 2 4 1 1 2 1 1 2 4 8 ... */
+	static unsigned long long LubySequence(unsigned long long i)
+	{
+		unsigned long long size = 1;
+		int exponent = 0;
+		while (size < i + 1)
+		{
+			size = 2 * size + 1;
+			exponent++;
+		}
+		while (size - 1 != i)
+		{
+			size = (size - 1) >> 1;
+			exponent--;
+			i = i % size;
+		}
+		return 1ull << exponent;
+	}
+	bool Assignment::ShouldRestart() const
+	{
+		return search_nodes >= restart_node_limit;
+	}
+	void Assignment::Restart()
+	{
+		// nld-nogoods of the branch: the decisions above a frame cannot hold together with any value already refuted in this frame
+		for (int f_idx = 1; f_idx < DEQUAN_Array_Size(search_stack); f_idx++)
+		{
+			const SearchFrame& frame = search_stack[f_idx];
+			int refuted_end = f_idx + 1 < DEQUAN_Array_Size(search_stack) ? search_stack[f_idx + 1].refuted_start : (int)DEQUAN_Array_Size(search_refuted);
+			for (int r_idx = frame.refuted_start; r_idx < refuted_end; r_idx++)
+			{
+				AddNogood(f_idx, frame.var_id, search_refuted[r_idx]);
+			}
+		}
+
+		// Undo all the decisions, the var of every frame is assigned at this point
+		const VarId root_vid = search_stack[0].var_id;
+		const int root_refuted_end = DEQUAN_Array_Size(search_stack) > 1 ? search_stack[1].refuted_start : (int)DEQUAN_Array_Size(search_refuted);
+		while (DEQUAN_Array_Size(search_stack) > 0)
+		{
+			UnAssignVar(DEQUAN_Array_Back(search_stack).var_id);
+			PopSavedDomainStep();
+			DEQUAN_Array_PopBack(search_stack);
+		}
+		search_point = SearchPoint::Descend;
+
+		// Refuted values of the first frame are unary nogoods, removed from the root domain once and for all and propagated
+		bool root_success = true;
+		for (int r_idx = 0; r_idx < root_refuted_end && root_success; r_idx++)
+		{
+			AddNogood(0, root_vid, search_refuted[r_idx]);
+			root_success = !current_domains[root_vid].IsEmpty();
+		}
+		if (root_success && DEQUAN_Array_Size(touched_vars) > 0)
+		{
+			FlushDomainEvents();
+			root_success = PropagateQueuedConstraints();
+		}
+		if (!root_success)
+		{
+			ClearPropagation();
+			search_point = SearchPoint::Finished;
+		}
+		DEQUAN_Array_Clear(search_refuted);
+
+		// New tie-breaks diversify the next runs
+		if (params.random_seed != 0)
+		{
+			ShuffleVarTieRanks();
+			if (params.var_heuristic == VarHeuristic::Static)
+			{
+				SortAssignOrder();
+			}
+			else
+			{
+				for (int h_idx = 0; h_idx < DEQUAN_Array_Size(order_heap); h_idx++)
+				{
+					order_heap_pos[order_heap[h_idx]] = -1;
+				}
+				DEQUAN_Array_Clear(order_heap);
+				for (int v_idx = 0; v_idx < DEQUAN_Array_Size(inst_vars); v_idx++)
+				{
+					OrderHeapInsert(v_idx);
+				}
+			}
+		}
+
+		search_restarts++;
+#ifdef DEQUAN_WITH_TRACE
+		trace.Record(TraceEvent::Restart);
+#endif
+		double run_nodes = (double)params.restart_base;
+		if (params.restart_policy == RestartPolicy::Luby)
+		{
+			run_nodes *= (double)LubySequence(search_restarts + 1);
+		}
+		else
+		{
+			for (unsigned long long r_idx = 0; r_idx < search_restarts; r_idx++)
+			{
+				run_nodes *= params.restart_factor;
+			}
+		}
+		restart_node_limit = search_nodes + (unsigned long long)(run_nodes < 1.0 ? 1.0 : run_nodes > 1e18 ? 1e18 : run_nodes);
+	}
+	void Assignment::AddNogood(int depth, VarId vid, int val)
+	{
+		if (depth == 0)
+		{
+			// Unary nogood, only added at the root where no step is opened: the change stays on the trail until the next Rewind()
+			ExcludeVar(vid, val);
+			return;
+		}
+
+
+		// Watch the refuted value and the deepest decision, which are the last ones to be assigned again
+		DEQUAN_Array_PushBack(nogood_literals, vid);
+		DEQUAN_Array_PushBack(nogood_literals, val);
+		for (int f_idx = depth - 1; f_idx >= 0; f_idx--)
+		{
+			DEQUAN_Array_PushBack(nogood_literals, search_stack[f_idx].var_id);
+			DEQUAN_Array_PushBack(nogood_literals, search_stack[f_idx].value);
+		}
+		int nogood_idx = (int)DEQUAN_Array_Size(nogood_offsets) - 1;
+		DEQUAN_Array_PushBack(nogood_offsets, (int)DEQUAN_Array_Size(nogood_literals) / 2);
+		DEQUAN_Array_PushBack(nogood_watches[vid], nogood_idx);
+		DEQUAN_Array_PushBack(nogood_watches[search_stack[depth - 1].var_id], nogood_idx);
+	}
+	bool Assignment::PropagateNogoods(VarId vid)
+	{
+		const int val = inst_vars[vid].value;
+		Array<int>& watches = nogood_watches[vid];
+		for (int w_idx = 0; w_idx < DEQUAN_Array_Size(watches); )
+		{
+			int nogood_idx = watches[w_idx];
+			int* literals = &nogood_literals[2 * nogood_offsets[nogood_idx]];
+			int literal_count = nogood_offsets[nogood_idx + 1] - nogood_offsets[nogood_idx];
+
+			// Make the literal of 'vid' the second watched literal
+			if (literals[0] == vid)
+			{
+				int watch_val = literals[1];
+				literals[0] = literals[2];
+				literals[1] = literals[3];
+				literals[2] = vid;
+				literals[3] = watch_val;
+			}
+			if (literals[3] != val)
+			{
+				// The literal is false, the nogood cannot hold
+				w_idx++;
+				continue;
+			}
+
+			// Watch another literal that does not hold yet
+			bool watch_moved = false;
+			for (int l_idx = 2; l_idx < literal_count && !watch_moved; l_idx++)
+			{
+				VarId other_vid = literals[2 * l_idx];
+				if (inst_vars[other_vid].value != literals[2 * l_idx + 1])
+				{
+					literals[2] = other_vid;
+					literals[3] = literals[2 * l_idx + 1];
+					literals[2 * l_idx] = vid;
+					literals[2 * l_idx + 1] = val;
+					DEQUAN_Array_PushBack(nogood_watches[other_vid], nogood_idx);
+					watches[w_idx] = DEQUAN_Array_Back(watches);
+					DEQUAN_Array_PopBack(watches);
+					watch_moved = true;
+				}
+			}
+			if (watch_moved)
+			{
+				continue;
+			}
+
+			// All the literals hold but the first watched one, which must not hold
+			int first_value = inst_vars[literals[0]].value;
+			if (first_value == literals[1])
+			{
+				return false;
+			}
+			if (first_value == InstVar::UNASSIGNED && !ExcludeVar(literals[0], literals[1]))
+			{
+				return false;
+			}
+			w_idx++;
+		}
+		return true;
+	}
+	void Assignment::SetObjective(VarId vid, ObjectiveSense sense)
+	{
+		if (objective_var != vid || objective_sense != sense)
+		{
+			objective_var = vid;
+			objective_sense = sense;
+			has_incumbent = false;
+		}
+	}
+	void Assignment::RecordIncumbent()
+	{
+		incumbent = inst_vars;
+		incumbent_value = inst_vars[objective_var].value;
+		has_incumbent = true;
+	}
+	bool Assignment::ApplyObjectiveBound()
+	{
+		// The domains above the current node were reduced before the last incumbent, so the bound is checked again at each node
+		bool success = objective_sense == ObjectiveSense::Minimize ?
+			ExcludeVarSup(objective_var, incumbent_value) :
+			ExcludeVarInf(objective_var, (long long)incumbent_value + 1);
+		if (success && DEQUAN_Array_Size(touched_vars) > 0)
+		{
+			FlushDomainEvents();
+		}
+		return success;
+	}
+
+	bool Assignment::StartSearchTask(const SearchTask& task)
+	{
+		for (int f_idx = 0; f_idx < DEQUAN_Array_Size(task.prefix); f_idx++)
+		{
+			const SearchFrame& frame = task.prefix[f_idx];
+			PushSavedDomainStep();
+			DEQUAN_Array_PushBack(search_stack, frame);
+			if (!TryAssignVar(frame.var_id, frame.value))
+			{
+				return false;
+			}
+		}
+		search_root_depth = (int)DEQUAN_Array_Size(search_stack);
+		if (task.frame.var_id == Var::INVALID)
+		{
+			search_point = SearchPoint::Descend;
+		}
+		else
+		{
+			PushSavedDomainStep();
+			DEQUAN_Array_PushBack(search_stack, task.frame);
+			search_point = SearchPoint::NextValue;
+		}
+		return true;
+	}
+
+	bool Assignment::SplitSearchTask(SearchTask& task)
+	{
+		for (int f_idx = search_root_depth; f_idx < DEQUAN_Array_Size(search_stack); f_idx++)
+		{
+			SearchFrame& frame = search_stack[f_idx];
+			if (frame.value == InstVar::UNASSIGNED)
+			{
+				continue;
+			}
+			// With ValueOrder::Min, untried values are in (value, value_max)
+			long long untried_min = (long long)frame.value + 1;
+			long long untried_max = frame.value_max;
+			if (untried_max > untried_min)
+			{
+				int split_val = (int)(untried_min + (untried_max - untried_min) / 2);
+				DEQUAN_Array_Clear(task.prefix);
+				for (int p_idx = 0; p_idx < f_idx; p_idx++)
+				{
+					DEQUAN_Array_PushBack(task.prefix, search_stack[p_idx]);
+				}
+				task.frame = SearchFrame(frame.var_id, InstVar::UNASSIGNED);
+				task.frame.value_min = split_val;
+				task.frame.value_max = frame.value_max;
+				frame.value_max = split_val;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	SearchParams SearchParams::MakePortfolioParams(int worker_idx)
+	{
+		// Cycle through var heuristics first, then value orders, and randomize ties with restarts for all workers but the first ones
+		static const VarHeuristic heuristics[] = { VarHeuristic::DomWDeg, VarHeuristic::Dom, VarHeuristic::Activity, VarHeuristic::Static };
+		SearchParams params;
+		params.var_heuristic = heuristics[worker_idx % 4];
+		params.value_order = (worker_idx / 4) % 2 == 0 ? ValueOrder::Min : ValueOrder::Max;
+		params.random_seed = worker_idx < 8 ? 0 : (unsigned int)worker_idx;
+		params.restart_policy = worker_idx < 8 ? RestartPolicy::None : RestartPolicy::Luby;
+		params.last_conflict = worker_idx >= 8;
+		return params;
+	}
+
+	void SearchParams::SetSolutionHint(const Array<InstVar>& solution)
+	{
+		DEQUAN_Array_Clear(value_hints);
+		DEQUAN_Array_Resize(value_hints, DEQUAN_Array_Size(solution));
+		for (int v_idx = 0; v_idx < DEQUAN_Array_Size(solution); v_idx++)
+		{
+			value_hints[v_idx] = solution[v_idx].value;
+		}
+	}
+
+	double Assignment::ComputeVarOrderKey(VarId vid) const
+	{
+		double size = (double)var_sizes[vid];
+		switch (params.var_heuristic)
+		{
+		case VarHeuristic::Dom:
+		{
+			// Degree is a static tie-break, lower than any size difference
+			double degree = (double)(csp->var_links_ends[vid] - csp->var_links_offsets[vid]);
+			return size - degree / (degree + 1.0);
+		}
+		case VarHeuristic::DomWDeg:
+			return size / var_wdeg[vid];
+		case VarHeuristic::Activity:
+			return size / (1.0 + var_activity[vid]);
+		default:
+			return size;
+		}
+	}
+
+	void Assignment::UpdateVarOrder(VarId vid)
+	{
+		int heap_idx = order_heap_pos[vid];
+		if (heap_idx < 0)
+		{
+			return;
+		}
+		order_keys[vid] = ComputeVarOrderKey(vid);
+		OrderHeapSiftUp(heap_idx);
+		OrderHeapSiftDown(order_heap_pos[vid]);
+	}
+
+	void Assignment::SyncVarOrder()
+	{
+		for (int t_idx = order_trail_pos; t_idx < DEQUAN_Array_Size(trail); t_idx++)
+		{
+			if (!trail[t_idx].first_of_var)
+			{
+				continue;
+			}
+			VarId vid = trail[t_idx].var_id;
+			if (params.var_heuristic == VarHeuristic::Activity)
+			{
+				var_activity[vid] += activity_inc;
+			}
+			UpdateVarOrder(vid);
+		}
+		order_trail_pos = (int)DEQUAN_Array_Size(trail);
+
+		if (params.var_heuristic == VarHeuristic::Activity && activity_inc > 1e100)
+		{
+			// Rescale activities before they overflow
+			for (int v_idx = 0; v_idx < DEQUAN_Array_Size(var_activity); v_idx++)
+			{
+				var_activity[v_idx] *= 1e-100;
+			}
+			activity_inc *= 1e-100;
+			for (int h_idx = 0; h_idx < DEQUAN_Array_Size(order_heap); h_idx++)
+			{
+				UpdateVarOrder(order_heap[h_idx]);
+			}
+		}
+	}
+
+	void Assignment::OrderHeapInsert(VarId vid)
+	{
+		order_keys[vid] = ComputeVarOrderKey(vid);
+		order_heap_pos[vid] = (int)DEQUAN_Array_Size(order_heap);
+		DEQUAN_Array_PushBack(order_heap, vid);
+		OrderHeapSiftUp(order_heap_pos[vid]);
+	}
+
+	void Assignment::OrderHeapRemove(VarId vid)
+	{
+		int heap_idx = order_heap_pos[vid];
+		VarId last_vid = DEQUAN_Array_Back(order_heap);
+		DEQUAN_Array_PopBack(order_heap);
+		order_heap_pos[vid] = -1;
+		if (last_vid != vid)
+		{
+			order_heap[heap_idx] = last_vid;
+			order_heap_pos[last_vid] = heap_idx;
+			OrderHeapSiftUp(heap_idx);
+			OrderHeapSiftDown(order_heap_pos[last_vid]);
+		}
+	}
+
+	void Assignment::OrderHeapSiftUp(int heap_idx)
+	{
+		VarId vid = order_heap[heap_idx];
+		while (heap_idx > 0)
+		{
+			int parent_idx = (heap_idx - 1) / 2;
+			VarId parent_vid = order_heap[parent_idx];
+			if (!OrderHeapBefore(vid, parent_vid))
+			{
+				break;
+			}
+			order_heap[heap_idx] = parent_vid;
+			order_heap_pos[parent_vid] = heap_idx;
+			heap_idx = parent_idx;
+		}
+		order_heap[heap_idx] = vid;
+		order_heap_pos[vid] = heap_idx;
+	}
+
+	void Assignment::OrderHeapSiftDown(int heap_idx)
+	{
+		int heap_size = (int)DEQUAN_Array_Size(order_heap);
+		VarId vid = order_heap[heap_idx];
+		while (true)
+		{
+			int child_idx = 2 * heap_idx + 1;
+			if (child_idx >= heap_size)
+			{
+				break;
+			}
+			if (child_idx + 1 < heap_size && OrderHeapBefore(order_heap[child_idx + 1], order_heap[child_idx]))
+			{
+				child_idx++;
+			}
+			VarId child_vid = order_heap[child_idx];
+			if (!OrderHeapBefore(child_vid, vid))
+			{
+				break;
+			}
+			order_heap[heap_idx] = child_vid;
+			order_heap_pos[child_vid] = heap_idx;
+			heap_idx = child_idx;
+		}
+		order_heap[heap_idx] = vid;
+		order_heap_pos[vid] = heap_idx;
+	}
+
+	void Assignment::OnConstraintFailure(const Constraint& con)
+	{
+		if (params.var_heuristic != VarHeuristic::DomWDeg)
+		{
+			return;
+		}
+		con_weights[con.con_id] += 1.0;
+		for (int v_idx = csp->constraint_vars_offsets[con.con_id]; v_idx < csp->constraint_vars_offsets[con.con_id + 1]; v_idx++)
+		{
+			VarId vid = csp->constraint_vars[v_idx];
+			var_wdeg[vid] += 1.0;
+			UpdateVarOrder(vid);
+		}
+	}
+
+	/**
+	 * Rank of the first entry >= 'val' among the sorted entries values[offset], values[offset + stride]... of a domain, their count if there is none.
+	 * With stride 2, offsets 0 and 1 search the starts and the ends of Ranges domains, which are sorted as well.
+	 */
+	static int FindFirstAtLeast(const MappedArray<int>& values, int offset, int stride, long long val)
+	{
+		int lo = 0, hi = ((int)values.Size() - offset + stride - 1) / stride;
+		while (lo < hi)
+		{
+			int mid = (lo + hi) / 2;
+			if (values[offset + mid * stride] < val)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+	void Assignment::PushSavedDomainStep()
+	{
+		DEQUAN_Array_PushBack(trail_steps, (int)DEQUAN_Array_Size(trail));
+		DEQUAN_Array_PushBack(state_trail_steps, (int)DEQUAN_Array_Size(state_trail));
+		NextTrailStamp();
+	}
+
+	void Assignment::RestoreSavedDomainStep()
+	{
+		int step_start = DEQUAN_Array_Back(trail_steps);
+		if (step_start < DEQUAN_Array_Size(trail))
+		{
+			// Undo modifications in LIFO order, a domain may have been saved more than once in the same step
+			for (int t_idx = (int)DEQUAN_Array_Size(trail) - 1; t_idx >= step_start; t_idx--)
+			{
+				const TrailEntry& entry = trail[t_idx];
+				Domain& dom = current_domains[entry.var_id];
+				const int* saved_values = entry.values_count > 0 ? &trail_values[entry.values_offset] : nullptr;
+				dom.type = entry.type;
+				if (entry.kind == TrailEntry::Kind::Splice)
+				{
+					dom.values.Splice(entry.values_pos, entry.values_pos + entry.new_count, saved_values, entry.values_count);
+				}
+				else if (entry.kind == TrailEntry::Kind::Removed)
+				{
+					// Both lists are sorted, merge them from the back in place
+					const int kept_count = dom.values.Size();
+					dom.values.Resize(kept_count + entry.values_count);
+					int* items = dom.values.Edit();
+					for (int write_idx = kept_count + entry.values_count - 1, kept_idx = kept_count - 1, saved_idx = entry.values_count - 1; saved_idx >= 0; write_idx--)
+					{
+						items[write_idx] = kept_idx >= 0 && items[kept_idx] > saved_values[saved_idx] ? items[kept_idx--] : saved_values[saved_idx--];
+					}
+				}
+				else if (entry.type == DomainType::Bitset)
+				{
+					// Bitset words are saved as pairs of 32-bit values
+					for (int w_idx = 0; w_idx < dom.bits_words; w_idx++)
+					{
+						unsigned long long low = (unsigned int)trail_values[entry.values_offset + 2 * w_idx];
+						unsigned long long high = (unsigned int)trail_values[entry.values_offset + 2 * w_idx + 1];
+						dom.bits[w_idx] = low | (high << 32);
+					}
+				}
+				else
+				{
+					dom.values.Assign(saved_values, entry.values_count);
+				}
+				RefreshVarBounds(entry.var_id);
+			}
+			if (params.var_heuristic != VarHeuristic::Static)
+			{
+				for (int t_idx = step_start; t_idx < DEQUAN_Array_Size(trail); t_idx++)
+				{
+					if (!trail[t_idx].first_of_var)
+					{
+						continue;
+					}
+					// Domain reductions of failed nodes also count in the activity of the vars
+					if (params.var_heuristic == VarHeuristic::Activity && t_idx >= order_trail_pos)
+					{
+						var_activity[trail[t_idx].var_id] += activity_inc;
+					}
+					UpdateVarOrder(trail[t_idx].var_id);
+				}
+				order_trail_pos = order_trail_pos < step_start ? order_trail_pos : step_start;
+			}
+			DEQUAN_Array_Resize(trail_values, trail[step_start].values_offset);
+			DEQUAN_Array_Resize(trail, step_start);
+		}
+		int state_step_start = DEQUAN_Array_Back(state_trail_steps);
+		for (int t_idx = (int)DEQUAN_Array_Size(state_trail) - 1; t_idx >= state_step_start; t_idx--)
+		{
+			const StateTrailEntry& entry = state_trail[t_idx];
+			con_trailed_states[entry.con_id][entry.state_idx] = entry.value;
+		}
+		DEQUAN_Array_Resize(state_trail, state_step_start);
+		// Domains restored must be saved again if modified later in this step
+		NextTrailStamp();
+	}
+
+	void Assignment::PopSavedDomainStep()
+	{
+		RestoreSavedDomainStep();
+		DEQUAN_Array_PopBack(trail_steps);
+		DEQUAN_Array_PopBack(state_trail_steps);
+	}
+
+	void Assignment::NextTrailStamp()
+	{
+		trail_stamp++;
+		if (trail_stamp == 0)
+		{
+			// Stamp wrapped around, make sure no var is considered as already saved
+			for (int v_idx = 0; v_idx < DEQUAN_Array_Size(trail_var_stamps); v_idx++)
+			{
+				trail_var_stamps[v_idx] = 0;
+				trail_domain_stamps[v_idx] = 0;
+			}
+			for (int c_idx = 0; c_idx < DEQUAN_Array_Size(con_trailed_stamps); c_idx++)
+			{
+				DEQUAN_Array_Clear(con_trailed_stamps[c_idx]);
+			}
+			trail_stamp = 1;
+		}
+	}
+
+	void Assignment::TouchVar(VarId vid, const Domain& dom)
+	{
+		// Bounds of the domain before the change stay in var_mins, var_maxs and var_sizes until FlushDomainEvents() tells what changed
+		if (touched_var_pos[vid] < 0 && !dom.IsEmpty())
+		{
+			touched_var_pos[vid] = (int)DEQUAN_Array_Size(touched_vars);
+			DEQUAN_Array_PushBack(touched_vars, vid);
+		}
+	}
+
+	void Assignment::SaveDomainSplice(VarId vid, const Domain& dom, int first, int last, int new_count)
+	{
+		TouchVar(vid, dom);
+		if (trail_domain_stamps[vid] == trail_stamp)
+		{
+			return;
+		}
+		TrailEntry entry{ vid, dom.type, TrailEntry::Kind::Splice, (int)DEQUAN_Array_Size(trail_values), last - first };
+		entry.values_pos = first;
+		entry.new_count = new_count;
+		entry.first_of_var = trail_var_stamps[vid] != trail_stamp;
+		trail_var_stamps[vid] = trail_stamp;
+		for (int v_idx = first; v_idx < last; v_idx++)
+		{
+			DEQUAN_Array_PushBack(trail_values, dom.values[v_idx]);
+		}
+		DEQUAN_Array_PushBack(trail, entry);
+	}
+
+	void Assignment::EnsureSavedDomain(VarId vid, const Domain& dom)
+	{
+		TouchVar(vid, dom);
+		if (trail_domain_stamps[vid] == trail_stamp)
+		{
+			return;
+		}
+		trail_domain_stamps[vid] = trail_stamp;
+
+		TrailEntry entry{ vid, dom.type, TrailEntry::Kind::Domain, (int)DEQUAN_Array_Size(trail_values), 0 };
+		entry.first_of_var = trail_var_stamps[vid] != trail_stamp;
+		trail_var_stamps[vid] = trail_stamp;
+		if (dom.type == DomainType::Bitset)
+		{
+			entry.values_count = 2 * dom.bits_words;
+			for (int w_idx = 0; w_idx < dom.bits_words; w_idx++)
+			{
+				DEQUAN_Array_PushBack(trail_values, (int)(unsigned int)(dom.bits[w_idx] & 0xffffffffull));
+				DEQUAN_Array_PushBack(trail_values, (int)(unsigned int)(dom.bits[w_idx] >> 32));
+			}
+		}
+		else
+		{
+			entry.values_count = (int)dom.values.Size();
+			for (int v_idx = 0; v_idx < dom.values.Size(); v_idx++)
+			{
+				DEQUAN_Array_PushBack(trail_values, dom.values[v_idx]);
+			}
+		}
+		DEQUAN_Array_PushBack(trail, entry);
+	}
+
+	void Assignment::SetConstraintTrailedState(int con_id, int state_idx, int value)
+	{
+		Array<int>& state = con_trailed_states[con_id];
+		Array<unsigned int>& stamps = con_trailed_stamps[con_id];
+		if (DEQUAN_Array_Size(stamps) < DEQUAN_Array_Size(state))
+		{
+			DEQUAN_Array_Resize(stamps, DEQUAN_Array_Size(state));
+		}
+		if (stamps[state_idx] != trail_stamp)
+		{
+			stamps[state_idx] = trail_stamp;
+			DEQUAN_Array_PushBack(state_trail, StateTrailEntry(con_id, state_idx, state[state_idx]));
+		}
+		state[state_idx] = value;
+	}
+
+	VarId CSP::AddIntVar(const Domain& domain)
+	{
+		Var new_var((VarId)DEQUAN_Array_Size(vars));
+		DEQUAN_Array_PushBack(vars, new_var);
+		DEQUAN_Array_PushBack(domains, domain);
+		if (finalized)
+		{
+			// New var without any link yet
+			DEQUAN_Array_PushBack(var_links_offsets, (int)DEQUAN_Array_Size(var_links));
+			DEQUAN_Array_PushBack(var_links_ends, (int)DEQUAN_Array_Size(var_links));
+			DEQUAN_Array_PushBack(var_links_capacities, 0);
+			DEQUAN_Array_PushBack(tracked_links_offsets, (int)DEQUAN_Array_Size(tracked_links));
+			DEQUAN_Array_PushBack(tracked_links_ends, (int)DEQUAN_Array_Size(tracked_links));
+			DEQUAN_Array_PushBack(tracked_links_capacities, 0);
+			DEQUAN_Array_PushBack(var_wake_events, 0);
+			model_revision++;
+		}
+		if (domain.type == DomainType::Values)
+		{
+			// Search and domain operations rely on values being sorted
+			DEQUAN_Array_Back(domains).values.Sort([](const int& a, const int& b) -> bool { return a < b; });
+		}
+
+		return new_var.var_id;
+	}
+	VarId CSP::AddIntVar(int min_val, int max_val)
+	{
+		// Small dense domains are faster to filter as bitsets
+		if (max_val > min_val && (long long)max_val - min_val <= Domain::BITSET_MAX_WORDS * 64)
+		{
+			return AddIntVar(Domain::MakeBitset(min_val, max_val));
+		}
+		Domain new_dom = { DomainType::Ranges, {min_val, max_val} };
+		return AddIntVar(new_dom);
+	}
+	VarId CSP::AddFixedVar(int val)
+	{
+		Domain new_dom = { DomainType::Values, {val} };
+		return AddIntVar(new_dom);
+	}
+	VarId CSP::AddBoolVar()
+	{
+		return AddIntVar(0, 2);
+	}
+	template <class T>
+	T* ConstraintArena::Create(const T& con)
+	{
+		static_assert(std::is_base_of<Constraint, T>::value, "constraints must derive from the Constraint class");
+		T* new_con = new(Allocate(sizeof(T), alignof(T))) T(con);
+		DEQUAN_Array_PushBack(constraints, new_con);
+		return new_con;
+	}
+	void* ConstraintArena::Allocate(size_t size, size_t alignment)
+	{
+		uintptr_t cursor = ((uintptr_t)block_cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		if (block_cursor == nullptr || cursor + size > (uintptr_t)block_end)
+		{
+			// Oversized constraints get a block of their own
+			size_t block_size = size + alignment > BLOCK_SIZE ? size + alignment : BLOCK_SIZE;
+			char* block = new char[block_size];
+			DEQUAN_Array_PushBack(blocks, block);
+			block_cursor = block;
+			block_end = block + block_size;
+			cursor = ((uintptr_t)block_cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		}
+		block_cursor = (char*)(cursor + size);
+		return (void*)cursor;
+	}
+	ConstraintArena::ConstraintArena(ConstraintArena&& other)
+	{
+		*this = std::move(other);
+	}
+	ConstraintArena& ConstraintArena::operator=(ConstraintArena&& other)
+	{
+		if (this != &other)
+		{
+			Clear();
+			blocks = std::move(other.blocks);
+			constraints = std::move(other.constraints);
+			block_cursor = other.block_cursor;
+			block_end = other.block_end;
+			DEQUAN_Array_Clear(other.blocks);
+			DEQUAN_Array_Clear(other.constraints);
+			other.block_cursor = nullptr;
+			other.block_end = nullptr;
+		}
+		return *this;
+	}
+	ConstraintArena::~ConstraintArena()
+	{
+		Clear();
+	}
+	void ConstraintArena::Clear()
+	{
+		for (int c_idx = 0; c_idx < DEQUAN_Array_Size(constraints); c_idx++)
+		{
+			constraints[c_idx]->~Constraint();
+		}
+		for (int b_idx = 0; b_idx < DEQUAN_Array_Size(blocks); b_idx++)
+		{
+			delete[] blocks[b_idx];
+		}
+		DEQUAN_Array_Clear(constraints);
+		DEQUAN_Array_Clear(blocks);
+		block_cursor = nullptr;
+		block_end = nullptr;
+	}
+
+	template <class T>
+	void CSP::AddConstraint(const T& con)
+	{
+		if (finalized)
+		{
+			// Built-in arrays could be reallocated under the links, the arena never moves its constraints
+			T* new_con = user_constraints.Create(con);
+			if (!IsBuiltinConstraint<T>::value)
+			{
+				new_con->kind = ConstraintKind::User;
+			}
+			new_con->con_id = (int)DEQUAN_Array_Size(constraints);
+			DEQUAN_Array_PushBack(constraints, new_con);
+			DEQUAN_Array_PushBack(constraint_vars_offsets, DEQUAN_Array_Back(constraint_vars_offsets));
+			new_con->LinkVars(constraint_vars);
+			DEQUAN_Array_Back(constraint_vars_offsets) = (int)DEQUAN_Array_Size(constraint_vars);
+			DEQUAN_Array_PushBack(constraint_wake_events, new_con->GetWakeEvents());
+			DEQUAN_Array_PushBack(constraint_tracks_assignments, new_con->TracksAssignments() ? 1 : 0);
+			DEQUAN_Array_PushBack(constraint_enabled, 0);
+			LinkConstraint(new_con->con_id);
+			return;
+		}
+		T& new_con = StoreConstraint(con);
+		new_con.con_id = (int)DEQUAN_Array_Size(constraints);
+		DEQUAN_Array_PushBack(constraints, nullptr);
+		DEQUAN_Array_PushBack(constraint_enabled, 1);
+	}
+	template <class T>
+	T& CSP::StoreConstraint(const T& con)
+	{
+		T* new_con = user_constraints.Create(con);
+		// Classes derived from a built-in constraint may override its methods, so they must be dispatched as user constraints
+		new_con->kind = ConstraintKind::User;
+		return *new_con;
+	}
+	OpConstraint& CSP::StoreConstraint(const OpConstraint& con)
+	{
+		DEQUAN_Array_PushBack(op_constraints, con);
+		return DEQUAN_Array_Back(op_constraints);
+	}
+	EqualityConstraint& CSP::StoreConstraint(const EqualityConstraint& con)
+	{
+		DEQUAN_Array_PushBack(equality_constraints, con);
+		return DEQUAN_Array_Back(equality_constraints);
+	}
+	OrEqualityConstraint& CSP::StoreConstraint(const OrEqualityConstraint& con)
+	{
+		DEQUAN_Array_PushBack(or_equality_constraints, con);
+		return DEQUAN_Array_Back(or_equality_constraints);
+	}
+	CombinedEqualityConstraint& CSP::StoreConstraint(const CombinedEqualityConstraint& con)
+	{
+		DEQUAN_Array_PushBack(combined_equality_constraints, con);
+		return DEQUAN_Array_Back(combined_equality_constraints);
+	}
+	OrRangeConstraint& CSP::StoreConstraint(const OrRangeConstraint& con)
+	{
+		DEQUAN_Array_PushBack(or_range_constraints, con);
+		return DEQUAN_Array_Back(or_range_constraints);
+	}
+	AllDifferentConstraint& CSP::StoreConstraint(const AllDifferentConstraint& con)
+	{
+		DEQUAN_Array_PushBack(alldiff_constraints, con);
+		return DEQUAN_Array_Back(alldiff_constraints);
+	}
+	LinearConstraint& CSP::StoreConstraint(const LinearConstraint& con)
+	{
+		DEQUAN_Array_PushBack(linear_constraints, con);
+		return DEQUAN_Array_Back(linear_constraints);
+	}
+	TableConstraint& CSP::StoreConstraint(const TableConstraint& con)
+	{
+		DEQUAN_Array_PushBack(table_constraints, con);
+		return DEQUAN_Array_Back(table_constraints);
+	}
+	LexConstraint& CSP::StoreConstraint(const LexConstraint& con)
+	{
+		DEQUAN_Array_PushBack(lex_constraints, con);
+		return DEQUAN_Array_Back(lex_constraints);
+	}
+	void CSP::AddInterchangeableVars(const Array<VarId>& vars, bool all_different)
+	{
+		Array<VarId> sorted_vars = vars;
+		DEQUAN_Array_Sort(sorted_vars, [](const VarId& a, const VarId& b) -> bool { return a < b; });
+		for (int v_idx = 1; v_idx < DEQUAN_Array_Size(sorted_vars); v_idx++)
+		{
+			if (sorted_vars[v_idx - 1] != sorted_vars[v_idx])
+			{
+				AddConstraint(OpConstraint(sorted_vars[v_idx - 1], sorted_vars[v_idx], all_different ? OpConstraint::Op::Inf : OpConstraint::Op::InfEqual, 0));
+			}
+		}
+	}
+	bool CSP::AddVarSymmetry(const Array<VarId>& vars, const Array<VarId>& images, bool reflect_values, int reflection_sum)
+	{
+		const int size = (int)DEQUAN_Array_Size(vars);
+		if (size != (int)DEQUAN_Array_Size(images))
+		{
+			return false;
+		}
+		Array<int> order;
+		DEQUAN_Array_Resize(order, size);
+		for (int p_idx = 0; p_idx < size; p_idx++)
+		{
+			order[p_idx] = p_idx;
+		}
+		Array<VarId> sorted_images = images;
+		DEQUAN_Array_Sort(order, [&vars](const int& a, const int& b) -> bool { return vars[a] < vars[b]; });
+		DEQUAN_Array_Sort(sorted_images, [](const VarId& a, const VarId& b) -> bool { return a < b; });
+		for (int p_idx = 0; p_idx < size; p_idx++)
+		{
+			VarId vid = vars[order[p_idx]];
+			if (vid < 0 || vid >= (int)DEQUAN_Array_Size(domains) || sorted_images[p_idx] != vid || (p_idx > 0 && vars[order[p_idx - 1]] == vid))
+			{
+				return false;
+			}
+		}
+
+		// Lex-leader in var id order: each solution must be lower or equal to its image, vars mapped to themselves are always equal
+		Array<VarId> vars0, vars1;
+		for (int p_idx = 0; p_idx < size; p_idx++)
+		{
+			if (reflect_values || vars[order[p_idx]] != images[order[p_idx]])
+			{
+				DEQUAN_Array_PushBack(vars0, vars[order[p_idx]]);
+				DEQUAN_Array_PushBack(vars1, images[order[p_idx]]);
+			}
+		}
+		if (DEQUAN_Array_Size(vars0) != 0)
+		{
+			AddConstraint(LexConstraint(vars0, vars1, false, reflect_values ? -1 : 1, reflect_values ? reflection_sum : 0));
+		}
+		return true;
+	}
+	void CSP::FinalizeModel(bool presolve)
+	{
+		// Once we know that the constraint arrays won't change (and won't be reallocated),
+		// we can gather the constraint adresses and link them with the variables.
+		auto GatherConstraints = [this](Constraint& con) { constraints[con.con_id] = &con; };
+		for (OpConstraint& con : op_constraints) { GatherConstraints(con); }
+		for (EqualityConstraint& con : equality_constraints) { GatherConstraints(con); }
+		for (OrEqualityConstraint& con : or_equality_constraints) { GatherConstraints(con); }
+		for (CombinedEqualityConstraint& con : combined_equality_constraints) { GatherConstraints(con); }
+		for (OrRangeConstraint& con : or_range_constraints) { GatherConstraints(con); }
+		for (AllDifferentConstraint& con : alldiff_constraints) { GatherConstraints(con); }
+		for (LinearConstraint& con : linear_constraints) { GatherConstraints(con); }
+		for (TableConstraint& con : table_constraints) { GatherConstraints(con); }
+		for (LexConstraint& con : lex_constraints) { GatherConstraints(con); }
+		for (Constraint* con : user_constraints.GetConstraints()) { GatherConstraints(*con); }
+
+		BuildAdjacency();
+		if (presolve)
+		{
+			Presolve();
+		}
+		finalized = true;
+		model_revision++;
+	}
+	void CSP::BuildAdjacency()
+	{
+		// Gather the vars of each constraint, in the order of their positions
+		int con_count = (int)DEQUAN_Array_Size(constraints);
+		int var_count = (int)DEQUAN_Array_Size(vars);
+		DEQUAN_Array_Clear(constraint_vars_offsets);
+		DEQUAN_Array_Resize(constraint_vars_offsets, con_count + 1);
+		DEQUAN_Array_Clear(constraint_vars);
+		for (int c_idx = 0; c_idx < con_count; c_idx++)
+		{
+			constraint_vars_offsets[c_idx] = (int)DEQUAN_Array_Size(constraint_vars);
+			constraints[c_idx]->LinkVars(constraint_vars);
+		}
+		constraint_vars_offsets[con_count] = (int)DEQUAN_Array_Size(constraint_vars);
+
+		DEQUAN_Array_Clear(constraint_wake_events);
+		DEQUAN_Array_Resize(constraint_wake_events, con_count);
+		for (int c_idx = 0; c_idx < con_count; c_idx++)
+		{
+			constraint_wake_events[c_idx] = constraints[c_idx]->GetWakeEvents();
+		}
+
+		// Reverse the links to know the constraints of each var, in a single array for all the vars
+		DEQUAN_Array_Clear(var_links_offsets);
+		DEQUAN_Array_Resize(var_links_offsets, var_count + 1);
+		for (int c_idx = 0; c_idx < con_count; c_idx++)
+		{
+			for (int l_idx = constraint_vars_offsets[c_idx]; l_idx < constraint_vars_offsets[c_idx + 1] && constraint_enabled[c_idx]; l_idx++)
+			{
+				var_links_offsets[constraint_vars[l_idx] + 1]++;
+			}
+		}
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			var_links_offsets[v_idx + 1] += var_links_offsets[v_idx];
+		}
+		Array<int> fill_offsets = var_links_offsets;
+		DEQUAN_Array_Clear(var_links);
+		DEQUAN_Array_Resize(var_links, var_links_offsets[var_count]);
+		for (int c_idx = 0; c_idx < con_count; c_idx++)
+		{
+			for (int l_idx = constraint_vars_offsets[c_idx]; l_idx < constraint_vars_offsets[c_idx + 1] && constraint_enabled[c_idx]; l_idx++)
+			{
+				ConstraintLink& link = var_links[fill_offsets[constraint_vars[l_idx]]++];
+				link.con = constraints[c_idx];
+				link.var_pos = l_idx - constraint_vars_offsets[c_idx];
+				link.wake_events = constraint_wake_events[c_idx];
+			}
+		}
+		// Packed ranges, without spare capacity until a var gets a new link
+		DEQUAN_Array_PopBack(var_links_offsets);
+		var_links_ends = fill_offsets;
+		DEQUAN_Array_PopBack(var_links_ends);
+		DEQUAN_Array_Clear(var_links_capacities);
+		DEQUAN_Array_Resize(var_links_capacities, var_count);
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			var_links_capacities[v_idx] = var_links_ends[v_idx] - var_links_offsets[v_idx];
+		}
+
+		DEQUAN_Array_Clear(constraint_tracks_assignments);
+		DEQUAN_Array_Resize(constraint_tracks_assignments, con_count);
+		for (int c_idx = 0; c_idx < con_count; c_idx++)
+		{
+			constraint_tracks_assignments[c_idx] = constraints[c_idx]->TracksAssignments() ? 1 : 0;
+		}
+		DEQUAN_Array_Clear(tracked_links_offsets);
+		DEQUAN_Array_Resize(tracked_links_offsets, var_count);
+		DEQUAN_Array_Clear(tracked_links_ends);
+		DEQUAN_Array_Resize(tracked_links_ends, var_count);
+		DEQUAN_Array_Clear(tracked_links_capacities);
+		DEQUAN_Array_Resize(tracked_links_capacities, var_count);
+		DEQUAN_Array_Clear(tracked_links);
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			tracked_links_offsets[v_idx] = (int)DEQUAN_Array_Size(tracked_links);
+			for (int l_idx = var_links_offsets[v_idx]; l_idx < var_links_ends[v_idx]; l_idx++)
+			{
+				if (constraint_tracks_assignments[var_links[l_idx].con->con_id])
+				{
+					DEQUAN_Array_PushBack(tracked_links, var_links[l_idx]);
+				}
+			}
+			tracked_links_ends[v_idx] = (int)DEQUAN_Array_Size(tracked_links);
+			tracked_links_capacities[v_idx] = tracked_links_ends[v_idx] - tracked_links_offsets[v_idx];
+		}
+
+		DEQUAN_Array_Clear(var_wake_events);
+		DEQUAN_Array_Resize(var_wake_events, var_count);
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			UpdateVarWakeEvents(v_idx);
+		}
+	}
+
+	/** Same OpConstraint v0 (op) v1 + offset with v0 < v1, strict inequalities shifted into SupEqual and InfEqual, so that equivalent constraints compare equal */
+	struct NormalizedOpConstraint
+	{
+		VarId v0, v1;
+		OpConstraint::Op op;
+		long long offset;
+		int con_id;
+	};
+	static NormalizedOpConstraint NormalizeOpConstraint(const OpConstraint& con)
+	{
+		NormalizedOpConstraint norm = { con.v0, con.v1, con.op, con.offset, con.con_id };
+		if (norm.op == OpConstraint::Op::Sup)
+		{
+			norm.op = OpConstraint::Op::SupEqual;
+			norm.offset++;
+		}
+		else if (norm.op == OpConstraint::Op::Inf)
+		{
+			norm.op = OpConstraint::Op::InfEqual;
+			norm.offset--;
+		}
+		if (norm.v0 > norm.v1)
+		{
+			// v0 >= v1 + offset is v1 <= v0 - offset
+			VarId vid = norm.v0;
+			norm.v0 = norm.v1;
+			norm.v1 = vid;
+			norm.offset = -norm.offset;
+			norm.op = norm.op == OpConstraint::Op::SupEqual ? OpConstraint::Op::InfEqual : norm.op == OpConstraint::Op::InfEqual ? OpConstraint::Op::SupEqual : norm.op;
+		}
+		return norm;
+	}
+	/** Whether every pair of values of the domains satisfies the constraint */
+	static bool IsOpConstraintEntailed(const OpConstraint& con, const Array<Domain>& domains)
+	{
+		const Domain& dom0 = domains[con.v0];
+		const Domain& dom1 = domains[con.v1];
+		long long min0 = dom0.Min(), max0 = dom0.Max();
+		long long min1 = (long long)dom1.Min() + con.offset, max1 = (long long)dom1.Max() + con.offset;
+		switch (con.op)
+		{
+		case OpConstraint::Op::Equal:
+			return con.v0 == con.v1 ? con.offset == 0 : dom0.IsFixed() && dom1.IsFixed() && min0 == min1;
+		case OpConstraint::Op::NotEqual:
+			// Bounds are checked first, so that the fixed value is in the range of the other domain
+			if (con.v0 == con.v1)
+			{
+				return con.offset != 0;
+			}
+			return max0 < min1 || min0 > max1 || (dom1.IsFixed() && !dom0.Contains((int)min1)) || (dom0.IsFixed() && !dom1.Contains((int)(min0 - con.offset)));
+		case OpConstraint::Op::SupEqual:	return min0 >= max1;
+		case OpConstraint::Op::Sup:			return min0 > max1;
+		case OpConstraint::Op::InfEqual:	return max0 <= min1;
+		case OpConstraint::Op::Inf:			return max0 < min1;
+		};
+		return false;
+	}
+	bool CSP::Presolve()
+	{
+		presolve_stats = PresolveStats();
+		const int var_count = (int)DEQUAN_Array_Size(vars);
+		const int con_count = (int)DEQUAN_Array_Size(constraints);
+		auto DisableLinks = [this](int con_id, int& counter)
+		{
+			// Links are rebuilt once the presolve is done
+			constraint_enabled[con_id] = 0;
+			counter++;
+		};
+
+		// Equalities of each var, then a breadth first search of each chain from its smallest var.
+		// The equality that reaches a var first is rewritten between the var and its alias, the others are implied by these ones.
+		Array<int> eq_offsets;
+		Array<int> eq_cons;
+		DEQUAN_Array_Resize(eq_offsets, var_count + 1);
+		for (EqualityConstraint& con : equality_constraints)
+		{
+			if (constraint_enabled[con.con_id] && con.v0 != con.v1)
+			{
+				eq_offsets[con.v0 + 1]++;
+				eq_offsets[con.v1 + 1]++;
+			}
+		}
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			eq_offsets[v_idx + 1] += eq_offsets[v_idx];
+		}
+		Array<int> fill_offsets = eq_offsets;
+		DEQUAN_Array_Resize(eq_cons, eq_offsets[var_count]);
+		for (EqualityConstraint& con : equality_constraints)
+		{
+			if (constraint_enabled[con.con_id] && con.v0 != con.v1)
+			{
+				eq_cons[fill_offsets[con.v0]++] = con.con_id;
+				eq_cons[fill_offsets[con.v1]++] = con.con_id;
+			}
+		}
+		Array<VarId> aliases;
+		DEQUAN_Array_Resize(aliases, var_count);
+		Array<char> tree_cons;
+		DEQUAN_Array_Resize(tree_cons, con_count);
+		Array<VarId> chain;
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			aliases[v_idx] = -1;
+		}
+		for (VarId root = 0; root < var_count; root++)
+		{
+			if (aliases[root] >= 0 || eq_offsets[root] == eq_offsets[root + 1])
+			{
+				continue;
+			}
+			aliases[root] = root;
+			DEQUAN_Array_Clear(chain);
+			DEQUAN_Array_PushBack(chain, root);
+			for (int c_idx = 0; c_idx < DEQUAN_Array_Size(chain); c_idx++)
+			{
+				VarId vid = chain[c_idx];
+				for (int e_idx = eq_offsets[vid]; e_idx < eq_offsets[vid + 1]; e_idx++)
+				{
+					EqualityConstraint& con = *static_cast<EqualityConstraint*>(constraints[eq_cons[e_idx]]);
+					VarId other = con.v0 == vid ? con.v1 : con.v0;
+					if (aliases[other] >= 0)
+					{
+						continue;
+					}
+					aliases[other] = root;
+					con.v0 = root;
+					con.v1 = other;
+					tree_cons[con.con_id] = 1;
+					DEQUAN_Array_PushBack(chain, other);
+					presolve_stats.aliased_vars++;
+				}
+			}
+		}
+		if (presolve_stats.aliased_vars > 0)
+		{
+			for (EqualityConstraint& con : equality_constraints)
+			{
+				if (constraint_enabled[con.con_id] && con.v0 != con.v1 && !tree_cons[con.con_id])
+				{
+					DisableLinks(con.con_id, presolve_stats.merged_constraints);
+				}
+			}
+			auto Alias = [&aliases](VarId& vid)
+			{
+				if (aliases[vid] >= 0)
+				{
+					vid = aliases[vid];
+				}
+			};
+			auto AliasAll = [&Alias](MappedArray<VarId>& vids)
+			{
+				VarId* items = vids.Edit();
+				for (int v_idx = 0; v_idx < vids.Size(); v_idx++)
+				{
+					Alias(items[v_idx]);
+				}
+			};
+			// All different constraints keep their vars, an aliased pair of them must stay visible as two vars to be detected
+			for (OpConstraint& con : op_constraints) { Alias(con.v0); Alias(con.v1); }
+			for (OrEqualityConstraint& con : or_equality_constraints) { Alias(con.v0); Alias(con.v1); Alias(con.v2); }
+			for (CombinedEqualityConstraint& con : combined_equality_constraints) { Alias(con.v0); Alias(con.v1); Alias(con.v2); Alias(con.v3); }
+			for (OrRangeConstraint& con : or_range_constraints) { Alias(con.v0); Alias(con.v1); }
+			for (LinearConstraint& con : linear_constraints) { AliasAll(con.linear_vars); }
+			for (TableConstraint& con : table_constraints) { AliasAll(con.table_vars); }
+			for (LexConstraint& con : lex_constraints) { AliasAll(con.vars0); AliasAll(con.vars1); }
+			BuildAdjacency();
+		}
+
+		// Root propagation of all the constraints, the reduced domains become the initial ones.
+		// No var is assigned yet, so only the built-in constraints that listen to domain changes are queued, user constraints are only woken by the events they listen to.
+		Assignment root;
+		root.Reset(*this);
+		for (int c_idx = 0; c_idx < con_count; c_idx++)
+		{
+			if (constraint_enabled[c_idx] && constraint_vars_offsets[c_idx] < constraint_vars_offsets[c_idx + 1] && constraints[c_idx]->kind != ConstraintKind::User
+				&& (constraint_wake_events[c_idx] & ~Constraint::EVENT_ASSIGNED) != 0)
+			{
+				root.QueueConstraint(constraints[c_idx], constraint_vars[constraint_vars_offsets[c_idx]], 0);
+			}
+		}
+		if (!root.PropagateQueuedConstraints())
+		{
+			presolve_stats.infeasible = true;
+			return false;
+		}
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			const Domain& dom = root.current_domains[v_idx];
+			if (dom.Size() != domains[v_idx].Size())
+			{
+				presolve_stats.fixed_vars += dom.IsFixed() ? 1 : 0;
+				domains[v_idx] = dom;
+			}
+		}
+
+		// Substitute the fixed vars out of the linear constraints, merging the terms of a same var
+		Array<int> term_idxs;
+		DEQUAN_Array_Resize(term_idxs, var_count);
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			term_idxs[v_idx] = -1;
+		}
+		Array<VarId> new_vars;
+		Array<long long> new_coefs;
+		for (LinearConstraint& con : linear_constraints)
+		{
+			if (!constraint_enabled[con.con_id])
+			{
+				continue;
+			}
+			DEQUAN_Array_Clear(new_vars);
+			DEQUAN_Array_Clear(new_coefs);
+			long long fixed_sum = 0;
+			for (int t_idx = 0; t_idx < con.linear_vars.Size(); t_idx++)
+			{
+				VarId vid = con.linear_vars[t_idx];
+				if (domains[vid].IsFixed())
+				{
+					fixed_sum += (long long)con.coefs[t_idx] * domains[vid].Min();
+				}
+				else if (term_idxs[vid] >= 0)
+				{
+					new_coefs[term_idxs[vid]] += con.coefs[t_idx];
+				}
+				else
+				{
+					term_idxs[vid] = (int)DEQUAN_Array_Size(new_vars);
+					DEQUAN_Array_PushBack(new_vars, vid);
+					DEQUAN_Array_PushBack(new_coefs, (long long)con.coefs[t_idx]);
+				}
+			}
+			int term_count = 0;
+			bool fits = true;
+			for (int t_idx = 0; t_idx < DEQUAN_Array_Size(new_vars); t_idx++)
+			{
+				term_idxs[new_vars[t_idx]] = -1;
+				if (new_coefs[t_idx] != 0)
+				{
+					fits = fits && new_coefs[t_idx] >= -INT_MAX && new_coefs[t_idx] <= INT_MAX;
+					new_vars[term_count] = new_vars[t_idx];
+					new_coefs[term_count++] = new_coefs[t_idx];
+				}
+			}
+			if (term_count == (int)con.linear_vars.Size() || !fits)
+			{
+				continue;
+			}
+			if (term_count == 0)
+			{
+				// Only constants left, the root propagation already checked them
+				if (con.EvaluateSum(fixed_sum) == Constraint::Eval::Passed)
+				{
+					DisableLinks(con.con_id, presolve_stats.entailed_constraints);
+				}
+				continue;
+			}
+			presolve_stats.substituted_terms += (int)con.linear_vars.Size() - term_count;
+			con.linear_vars.Resize(term_count);
+			con.coefs.Resize(term_count);
+			for (int t_idx = 0; t_idx < term_count; t_idx++)
+			{
+				con.linear_vars.Set(t_idx, new_vars[t_idx]);
+				con.coefs.Set(t_idx, (int)new_coefs[t_idx]);
+			}
+			con.rhs -= fixed_sum;
+		}
+
+		// Fixed vars can leave an all different constraint once their values are distinct and removed from the other vars
+		for (AllDifferentConstraint& con : alldiff_constraints)
+		{
+			if (!constraint_enabled[con.con_id])
+			{
+				continue;
+			}
+			DEQUAN_Array_Clear(new_vars);
+			bool separated = true;
+			for (int v_idx = 0; v_idx < con.alldiff_vars.Size() && separated; v_idx++)
+			{
+				const Domain& fixed_dom = domains[con.alldiff_vars[v_idx]];
+				if (!fixed_dom.IsFixed())
+				{
+					DEQUAN_Array_PushBack(new_vars, con.alldiff_vars[v_idx]);
+					continue;
+				}
+				for (int oth_idx = 0; oth_idx < con.alldiff_vars.Size() && separated; oth_idx++)
+				{
+					separated = oth_idx == v_idx || !domains[con.alldiff_vars[oth_idx]].Contains(fixed_dom.Min());
+				}
+			}
+			if (!separated || DEQUAN_Array_Size(new_vars) == con.alldiff_vars.Size())
+			{
+				continue;
+			}
+			presolve_stats.substituted_terms += (int)(con.alldiff_vars.Size() - DEQUAN_Array_Size(new_vars));
+			con.alldiff_vars = new_vars;
+		}
+
+		// Duplicate op constraints, and for inequalities on the same two vars, the ones with a looser offset
+		Array<NormalizedOpConstraint> ops;
+		for (OpConstraint& con : op_constraints)
+		{
+			if (constraint_enabled[con.con_id])
+			{
+				DEQUAN_Array_PushBack(ops, NormalizeOpConstraint(con));
+			}
+		}
+		DEQUAN_Array_Sort(ops, [](const NormalizedOpConstraint& a, const NormalizedOpConstraint& b) -> bool
+		{
+			if (a.v0 != b.v0) return a.v0 < b.v0;
+			if (a.v1 != b.v1) return a.v1 < b.v1;
+			if (a.op != b.op) return a.op < b.op;
+			if (a.offset != b.offset) return a.offset < b.offset;
+			return a.con_id < b.con_id;
+		});
+		for (int o_idx = 0; o_idx < DEQUAN_Array_Size(ops); )
+		{
+			int end_idx = o_idx + 1;
+			while (end_idx < DEQUAN_Array_Size(ops) && ops[end_idx].v0 == ops[o_idx].v0 && ops[end_idx].v1 == ops[o_idx].v1 && ops[end_idx].op == ops[o_idx].op)
+			{
+				end_idx++;
+			}
+			// Smallest offset is the tightest upper bound, largest offset the tightest lower bound
+			int kept_idx = ops[o_idx].op == OpConstraint::Op::SupEqual ? end_idx - 1 : o_idx;
+			bool is_bound = ops[o_idx].op == OpConstraint::Op::SupEqual || ops[o_idx].op == OpConstraint::Op::InfEqual;
+			for (int d_idx = o_idx; d_idx < end_idx; d_idx++)
+			{
+				bool is_duplicate = d_idx > o_idx && ops[d_idx].offset == ops[d_idx - 1].offset;
+				if (d_idx != kept_idx && (is_bound || is_duplicate))
+				{
+					DisableLinks(ops[d_idx].con_id, presolve_stats.merged_constraints);
+				}
+			}
+			o_idx = end_idx;
+		}
+
+		// Constraints entailed by the domains, any built-in constraint whose vars are all fixed passed the root propagation
+		Array<InstVar> fixed_vars;
+		DEQUAN_Array_Resize(fixed_vars, var_count);
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			fixed_vars[v_idx].value = domains[v_idx].IsFixed() ? domains[v_idx].Min() : InstVar::UNASSIGNED;
+		}
+		BuildAdjacency();
+		for (int c_idx = 0; c_idx < con_count; c_idx++)
+		{
+			Constraint& con = *constraints[c_idx];
+			if (!constraint_enabled[c_idx] || con.kind == ConstraintKind::User)
+			{
+				continue;
+			}
+			bool entailed = false;
+			switch (con.kind)
+			{
+			case ConstraintKind::Op:
+				entailed = IsOpConstraintEntailed(static_cast<OpConstraint&>(con), domains);
+				break;
+			case ConstraintKind::Equality:
+			{
+				const EqualityConstraint& eq_con = static_cast<EqualityConstraint&>(con);
+				entailed = eq_con.v0 == eq_con.v1 || (domains[eq_con.v0].IsFixed() && domains[eq_con.v1].IsFixed() && domains[eq_con.v0].Min() == domains[eq_con.v1].Min());
+				break;
+			}
+			case ConstraintKind::AllDifferent:
+				entailed = static_cast<AllDifferentConstraint&>(con).alldiff_vars.Size() <= 1;
+				break;
+			case ConstraintKind::Linear:
+			{
+				const LinearConstraint& linear_con = static_cast<LinearConstraint&>(con);
+				long long sum_min = 0, sum_max = 0;
+				for (int t_idx = 0; t_idx < linear_con.linear_vars.Size(); t_idx++)
+				{
+					const Domain& dom = domains[linear_con.linear_vars[t_idx]];
+					long long coef = linear_con.coefs[t_idx];
+					sum_min += coef > 0 ? coef * dom.Min() : coef * dom.Max();
+					sum_max += coef > 0 ? coef * dom.Max() : coef * dom.Min();
+				}
+				entailed = (linear_con.op == OpConstraint::Op::InfEqual && sum_max <= linear_con.rhs) || (linear_con.op == OpConstraint::Op::SupEqual && sum_min >= linear_con.rhs)
+					|| (linear_con.op == OpConstraint::Op::NotEqual && (linear_con.rhs < sum_min || linear_con.rhs > sum_max));
+				break;
+			}
+			default:
+				break;
+			}
+			bool all_fixed = constraint_vars_offsets[c_idx] < constraint_vars_offsets[c_idx + 1];
+			for (int l_idx = constraint_vars_offsets[c_idx]; l_idx < constraint_vars_offsets[c_idx + 1] && all_fixed && !entailed; l_idx++)
+			{
+				all_fixed = fixed_vars[constraint_vars[l_idx]].value != InstVar::UNASSIGNED;
+			}
+			if (!entailed && all_fixed)
+			{
+				entailed = con.Evaluate(fixed_vars, constraint_vars[constraint_vars_offsets[c_idx]], 0) == Constraint::Eval::Passed;
+			}
+			if (entailed)
+			{
+				DisableLinks(c_idx, presolve_stats.entailed_constraints);
+			}
+		}
+		BuildAdjacency();
+		return true;
+	}
+
+	/** Append a link to the range of a var, the range is moved to the back of the links with twice its capacity when full */
+	static void AddVarLink(Array<ConstraintLink>& links, Array<int>& offsets, Array<int>& ends, Array<int>& capacities, VarId vid, const ConstraintLink& link)
+	{
+		if (ends[vid] - offsets[vid] == capacities[vid])
+		{
+			int count = ends[vid] - offsets[vid];
+			int new_offset = (int)DEQUAN_Array_Size(links);
+			int new_capacity = 2 * count > 4 ? 2 * count : 4;
+			if (ends[vid] == new_offset)
+			{
+				// Already the last range, grow it in place
+				new_offset = offsets[vid];
+				DEQUAN_Array_Resize(links, new_offset + new_capacity);
+			}
+			else
+			{
+				DEQUAN_Array_Resize(links, new_offset + new_capacity);
+				for (int l_idx = 0; l_idx < count; l_idx++)
+				{
+					links[new_offset + l_idx] = links[offsets[vid] + l_idx];
+				}
+			}
+			offsets[vid] = new_offset;
+			ends[vid] = new_offset + count;
+			capacities[vid] = new_capacity;
+		}
+		links[ends[vid]++] = link;
+	}
+	/** Remove the link of a constraint from the range of a var, keeping the order of the other links */
+	static void RemoveVarLink(Array<ConstraintLink>& links, const Array<int>& offsets, Array<int>& ends, VarId vid, const Constraint* con, int var_pos)
+	{
+		for (int l_idx = offsets[vid]; l_idx < ends[vid]; l_idx++)
+		{
+			if (links[l_idx].con == con && links[l_idx].var_pos == var_pos)
+			{
+				for (int m_idx = l_idx + 1; m_idx < ends[vid]; m_idx++)
+				{
+					links[m_idx - 1] = links[m_idx];
+				}
+				ends[vid]--;
+				return;
+			}
+		}
+	}
+	void CSP::LinkConstraint(int con_id)
+	{
+		if (constraint_enabled[con_id])
+		{
+			return;
+		}
+		constraint_enabled[con_id] = 1;
+		for (int l_idx = constraint_vars_offsets[con_id]; l_idx < constraint_vars_offsets[con_id + 1]; l_idx++)
+		{
+			VarId vid = constraint_vars[l_idx];
+			ConstraintLink link;
+			link.con = constraints[con_id];
+			link.var_pos = l_idx - constraint_vars_offsets[con_id];
+			link.wake_events = constraint_wake_events[con_id];
+			AddVarLink(var_links, var_links_offsets, var_links_ends, var_links_capacities, vid, link);
+			if (constraint_tracks_assignments[con_id])
+			{
+				AddVarLink(tracked_links, tracked_links_offsets, tracked_links_ends, tracked_links_capacities, vid, link);
+			}
+			var_wake_events[vid] |= link.wake_events;
+		}
+		model_revision++;
+	}
+	void CSP::DisableConstraint(int con_id)
+	{
+		if (!constraint_enabled[con_id])
+		{
+			return;
+		}
+		constraint_enabled[con_id] = 0;
+		if (!finalized)
+		{
+			// Links will be skipped by FinalizeModel()
+			return;
+		}
+		for (int l_idx = constraint_vars_offsets[con_id]; l_idx < constraint_vars_offsets[con_id + 1]; l_idx++)
+		{
+			VarId vid = constraint_vars[l_idx];
+			int var_pos = l_idx - constraint_vars_offsets[con_id];
+			RemoveVarLink(var_links, var_links_offsets, var_links_ends, vid, constraints[con_id], var_pos);
+			if (constraint_tracks_assignments[con_id])
+			{
+				RemoveVarLink(tracked_links, tracked_links_offsets, tracked_links_ends, vid, constraints[con_id], var_pos);
+			}
+			UpdateVarWakeEvents(vid);
+		}
+		model_revision++;
+	}
+	void CSP::EnableConstraint(int con_id)
+	{
+		if (!finalized)
+		{
+			constraint_enabled[con_id] = 1;
+			return;
+		}
+		LinkConstraint(con_id);
+	}
+	void CSP::SetVarDomain(VarId vid, const Domain& domain)
+	{
+		domains[vid] = domain;
+		if (domain.type == DomainType::Values)
+		{
+			domains[vid].values.Sort([](const int& a, const int& b) -> bool { return a < b; });
+		}
+		model_revision++;
+	}
+	void CSP::UpdateVarWakeEvents(VarId vid)
+	{
+		var_wake_events[vid] = 0;
+		for (int l_idx = var_links_offsets[vid]; l_idx < var_links_ends[vid]; l_idx++)
+		{
+			var_wake_events[vid] |= var_links[l_idx].wake_events;
+		}
+	}
+
+	/** Sections of a saved model, each one 8-byte aligned and located by ModelFileHeader::section_offsets */
+	enum ModelSection : int
+	{
+		MODEL_SECTION_DOMAINS = 0,			// ModelDomainRecord per var
+		MODEL_SECTION_CONSTRAINTS,			// ModelConstraintRecord per constraint
+		MODEL_SECTION_CONSTRAINT_VARS_OFFSETS,	// int per constraint, plus one
+		MODEL_SECTION_CONSTRAINT_VARS,		// VarId per constraint var
+		MODEL_SECTION_LINK_OFFSETS,			// int per var, plus one, the links of each var are packed
+		MODEL_SECTION_LINKS,				// ModelLinkRecord per link
+		MODEL_SECTION_TRACKED_LINK_OFFSETS,
+		MODEL_SECTION_TRACKED_LINKS,
+		MODEL_SECTION_CONSTRAINT_WAKE_EVENTS,	// int per constraint
+		MODEL_SECTION_CONSTRAINT_TRACKS,		// char per constraint
+		MODEL_SECTION_VAR_WAKE_EVENTS,		// int per var
+		MODEL_SECTION_INTS,					// domain values and constraint payloads
+		MODEL_SECTION_WORDS,				// table supports
+		MODEL_SECTION_COUNT
+	};
+	struct ModelFileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		/** Written as MODEL_BYTE_ORDER, images are not portable between endiannesses */
+		uint32_t byte_order;
+		uint32_t header_size;
+		uint32_t var_count;
+		uint32_t con_count;
+		uint32_t constraint_var_count;
+		uint32_t link_count;
+		uint32_t tracked_link_count;
+		uint32_t int_count;
+		uint32_t word_count;
+		uint32_t reserved;
+		uint64_t file_size;
+		uint64_t section_offsets[MODEL_SECTION_COUNT];
+	};
+	struct ModelDomainRecord
+	{
+		int32_t type;
+		int32_t bits_min;
+		int32_t bits_words;
+		int32_t values_count;
+		/** Position of the values in the ints section */
+		uint32_t values_offset;
+		uint32_t reserved;
+		uint64_t bits[Domain::BITSET_MAX_WORDS];
+	};
+	/** Payload of each kind in the ints section, see CSP::SaveModel() */
+	struct ModelConstraintRecord
+	{
+		int32_t kind;
+		int32_t enabled;
+		uint32_t ints_offset;
+		uint32_t ints_count;
+		uint32_t words_offset;
+		uint32_t words_count;
+	};
+	struct ModelLinkRecord
+	{
+		int32_t con_id;
+		int32_t var_pos;
+		int32_t wake_events;
+	};
+	static const char MODEL_MAGIC[4] = { 'D', 'Q', 'N', 'M' };
+	static const uint32_t MODEL_BYTE_ORDER = 0x01020304;
+
+	template <class T>
+	static void WriteModelSection(Array<unsigned char>& bytes, const ModelFileHeader& header, int section, const Array<T>& items)
+	{
+		if (DEQUAN_Array_Size(items) > 0)
+		{
+			memcpy(&bytes[(size_t)header.section_offsets[section]], &items[0], DEQUAN_Array_Size(items) * sizeof(T));
+		}
+	}
+	/** Typed view of a section of 'count' items, nullptr if it doesn't fit in the image */
+	template <class T>
+	static const T* GetModelSection(const unsigned char* base, const ModelFileHeader& header, int section, size_t count)
+	{
+		uint64_t offset = header.section_offsets[section];
+		if ((offset & 7) != 0 || offset > header.file_size || (header.file_size - offset) / sizeof(T) < count)
+		{
+			return nullptr;
+		}
+		return (const T*)(base + offset);
+	}
+	/** Append the links of each var packed in var order, with their offsets */
+	static void PackModelLinks(const Array<ConstraintLink>& links, const Array<int>& offsets, const Array<int>& ends, Array<int>& packed_offsets, Array<ModelLinkRecord>& packed_links)
+	{
+		const int var_count = (int)DEQUAN_Array_Size(offsets);
+		DEQUAN_Array_Resize(packed_offsets, var_count + 1);
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			packed_offsets[v_idx] = (int)DEQUAN_Array_Size(packed_links);
+			for (int l_idx = offsets[v_idx]; l_idx < ends[v_idx]; l_idx++)
+			{
+				ModelLinkRecord record;
+				record.con_id = links[l_idx].con->con_id;
+				record.var_pos = links[l_idx].var_pos;
+				record.wake_events = links[l_idx].wake_events;
+				DEQUAN_Array_PushBack(packed_links, record);
+			}
+		}
+		packed_offsets[var_count] = (int)DEQUAN_Array_Size(packed_links);
+	}
+	bool CSP::SaveModel(Array<unsigned char>& bytes) const
+	{
+		if (!finalized)
+		{
+			return false;
+		}
+		const int var_count = (int)DEQUAN_Array_Size(vars);
+		const int con_count = (int)DEQUAN_Array_Size(constraints);
+		Array<int> ints;
+		Array<unsigned long long> words;
+		auto PushInts = [&ints](const Array<int>& items)
+		{
+			for (int i_idx = 0; i_idx < DEQUAN_Array_Size(items); i_idx++)
+			{
+				DEQUAN_Array_PushBack(ints, items[i_idx]);
+			}
+		};
+		auto PushItems = [&ints](const MappedArray<int>& items)
+		{
+			for (int item : items)
+			{
+				DEQUAN_Array_PushBack(ints, item);
+			}
+		};
+
+		Array<ModelDomainRecord> domain_records;
+		DEQUAN_Array_Resize(domain_records, var_count);
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			const Domain& dom = domains[v_idx];
+			ModelDomainRecord& record = domain_records[v_idx];
+			memset(&record, 0, sizeof(record));
+			record.type = (int32_t)dom.type;
+			record.bits_min = dom.bits_min;
+			record.bits_words = dom.bits_words;
+			record.values_offset = (uint32_t)DEQUAN_Array_Size(ints);
+			record.values_count = (int32_t)dom.values.Size();
+			for (int w_idx = 0; w_idx < Domain::BITSET_MAX_WORDS; w_idx++)
+			{
+				record.bits[w_idx] = dom.bits[w_idx];
+			}
+			PushItems(dom.values);
+		}
+
+		// Payloads : Op v0 v1 op offset, Equality v0 v1, OrEquality v0 v1 v2, CombinedEquality v0 v1 v2 v3, OrRange v0 v1 min max,
+		// AllDifferent filtering vars..., Linear op rhs_low rhs_high count vars... coefs..., Table tuple_count word_count arity vars... value_offsets... values...,
+		// Lex strict coef offset count vars0... vars1...
+		Array<ModelConstraintRecord> con_records;
+		DEQUAN_Array_Resize(con_records, con_count);
+		for (int c_idx = 0; c_idx < con_count; c_idx++)
+		{
+			const Constraint* con = constraints[c_idx];
+			ModelConstraintRecord& record = con_records[c_idx];
+			record.kind = (int32_t)con->kind;
+			record.enabled = constraint_enabled[c_idx];
+			record.ints_offset = (uint32_t)DEQUAN_Array_Size(ints);
+			record.words_offset = (uint32_t)DEQUAN_Array_Size(words);
+			switch (con->kind)
+			{
+			case ConstraintKind::Op:
+			{
+				const OpConstraint& op_con = *static_cast<const OpConstraint*>(con);
+				PushInts({ op_con.v0, op_con.v1, (int)op_con.op, op_con.offset });
+				break;
+			}
+			case ConstraintKind::Equality:
+			{
+				const EqualityConstraint& eq_con = *static_cast<const EqualityConstraint*>(con);
+				PushInts({ eq_con.v0, eq_con.v1 });
+				break;
+			}
+			case ConstraintKind::OrEquality:
+			{
+				const OrEqualityConstraint& or_con = *static_cast<const OrEqualityConstraint*>(con);
+				PushInts({ or_con.v0, or_con.v1, or_con.v2 });
+				break;
+			}
+			case ConstraintKind::CombinedEquality:
+			{
+				const CombinedEqualityConstraint& comb_con = *static_cast<const CombinedEqualityConstraint*>(con);
+				PushInts({ comb_con.v0, comb_con.v1, comb_con.v2, comb_con.v3 });
+				break;
+			}
+			case ConstraintKind::OrRange:
+			{
+				const OrRangeConstraint& range_con = *static_cast<const OrRangeConstraint*>(con);
+				PushInts({ range_con.v0, range_con.v1, range_con.min, range_con.max });
+				break;
+			}
+			case ConstraintKind::AllDifferent:
+			{
+				const AllDifferentConstraint& alldiff_con = *static_cast<const AllDifferentConstraint*>(con);
+				DEQUAN_Array_PushBack(ints, (int)alldiff_con.filtering);
+				PushItems(alldiff_con.alldiff_vars);
+				break;
+			}
+			case ConstraintKind::Linear:
+			{
+				const LinearConstraint& linear_con = *static_cast<const LinearConstraint*>(con);
+				unsigned long long rhs_bits = (unsigned long long)linear_con.rhs;
+				PushInts({ (int)linear_con.op, (int)(uint32_t)rhs_bits, (int)(uint32_t)(rhs_bits >> 32), (int)linear_con.linear_vars.Size() });
+				PushItems(linear_con.linear_vars);
+				PushItems(linear_con.coefs);
+				break;
+			}
+			case ConstraintKind::Table:
+			{
+				const TableConstraint& table_con = *static_cast<const TableConstraint*>(con);
+				PushInts({ table_con.tuple_count, table_con.word_count, (int)table_con.table_vars.Size() });
+				PushItems(table_con.table_vars);
+				PushItems(table_con.value_offsets);
+				PushItems(table_con.values);
+				for (int w_idx = 0; w_idx < table_con.supports.Size(); w_idx++)
+				{
+					DEQUAN_Array_PushBack(words, table_con.supports[w_idx]);
+				}
+				break;
+			}
+			case ConstraintKind::Lex:
+			{
+				const LexConstraint& lex_con = *static_cast<const LexConstraint*>(con);
+				PushInts({ lex_con.strict ? 1 : 0, lex_con.coef, lex_con.offset, (int)lex_con.vars0.Size() });
+				PushItems(lex_con.vars0);
+				PushItems(lex_con.vars1);
+				break;
+			}
+			default:
+				// User constraints only exist as code
+				return false;
+			}
+			record.ints_count = (uint32_t)DEQUAN_Array_Size(ints) - record.ints_offset;
+			record.words_count = (uint32_t)DEQUAN_Array_Size(words) - record.words_offset;
+		}
+
+		Array<int> link_offsets, tracked_link_offsets;
+		Array<ModelLinkRecord> links, tracked;
+		PackModelLinks(var_links, var_links_offsets, var_links_ends, link_offsets, links);
+		PackModelLinks(tracked_links, tracked_links_offsets, tracked_links_ends, tracked_link_offsets, tracked);
+
+		ModelFileHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, MODEL_MAGIC, sizeof(header.magic));
+		header.version = MODEL_FORMAT_VERSION;
+		header.byte_order = MODEL_BYTE_ORDER;
+		header.header_size = sizeof(ModelFileHeader);
+		header.var_count = (uint32_t)var_count;
+		header.con_count = (uint32_t)con_count;
+		header.constraint_var_count = (uint32_t)DEQUAN_Array_Size(constraint_vars);
+		header.link_count = (uint32_t)DEQUAN_Array_Size(links);
+		header.tracked_link_count = (uint32_t)DEQUAN_Array_Size(tracked);
+		header.int_count = (uint32_t)DEQUAN_Array_Size(ints);
+		header.word_count = (uint32_t)DEQUAN_Array_Size(words);
+		const size_t section_sizes[MODEL_SECTION_COUNT] =
+		{
+			var_count * sizeof(ModelDomainRecord), con_count * sizeof(ModelConstraintRecord),
+			(con_count + 1) * sizeof(int), DEQUAN_Array_Size(constraint_vars) * sizeof(VarId),
+			(var_count + 1) * sizeof(int), DEQUAN_Array_Size(links) * sizeof(ModelLinkRecord),
+			(var_count + 1) * sizeof(int), DEQUAN_Array_Size(tracked) * sizeof(ModelLinkRecord),
+			con_count * sizeof(int), con_count * sizeof(char), var_count * sizeof(int),
+			DEQUAN_Array_Size(ints) * sizeof(int), DEQUAN_Array_Size(words) * sizeof(unsigned long long)
+		};
+		uint64_t offset = sizeof(ModelFileHeader);
+		for (int s_idx = 0; s_idx < MODEL_SECTION_COUNT; s_idx++)
+		{
+			offset = (offset + 7) & ~(uint64_t)7;
+			header.section_offsets[s_idx] = offset;
+			offset += section_sizes[s_idx];
+		}
+		header.file_size = offset;
+
+		DEQUAN_Array_Clear(bytes);
+		DEQUAN_Array_Resize(bytes, (size_t)header.file_size);
+		memset(&bytes[0], 0, (size_t)header.file_size);
+		memcpy(&bytes[0], &header, sizeof(header));
+		WriteModelSection(bytes, header, MODEL_SECTION_DOMAINS, domain_records);
+		WriteModelSection(bytes, header, MODEL_SECTION_CONSTRAINTS, con_records);
+		WriteModelSection(bytes, header, MODEL_SECTION_CONSTRAINT_VARS_OFFSETS, constraint_vars_offsets);
+		WriteModelSection(bytes, header, MODEL_SECTION_CONSTRAINT_VARS, constraint_vars);
+		WriteModelSection(bytes, header, MODEL_SECTION_LINK_OFFSETS, link_offsets);
+		WriteModelSection(bytes, header, MODEL_SECTION_LINKS, links);
+		WriteModelSection(bytes, header, MODEL_SECTION_TRACKED_LINK_OFFSETS, tracked_link_offsets);
+		WriteModelSection(bytes, header, MODEL_SECTION_TRACKED_LINKS, tracked);
+		WriteModelSection(bytes, header, MODEL_SECTION_CONSTRAINT_WAKE_EVENTS, constraint_wake_events);
+		WriteModelSection(bytes, header, MODEL_SECTION_CONSTRAINT_TRACKS, constraint_tracks_assignments);
+		WriteModelSection(bytes, header, MODEL_SECTION_VAR_WAKE_EVENTS, var_wake_events);
+		WriteModelSection(bytes, header, MODEL_SECTION_INTS, ints);
+		WriteModelSection(bytes, header, MODEL_SECTION_WORDS, words);
+		return true;
+	}
+	bool CSP::LoadModel(const void* data, size_t size)
+	{
+		*this = CSP();
+		const unsigned char* base = (const unsigned char*)data;
+		if (((uintptr_t)base & 7) != 0 || size < sizeof(ModelFileHeader))
+		{
+			return false;
+		}
+		const ModelFileHeader& header = *(const ModelFileHeader*)base;
+		if (memcmp(header.magic, MODEL_MAGIC, sizeof(header.magic)) != 0 || header.version != MODEL_FORMAT_VERSION || header.byte_order != MODEL_BYTE_ORDER
+			|| header.header_size != sizeof(ModelFileHeader) || header.file_size > size || header.var_count > INT_MAX / 2 || header.con_count > INT_MAX / 2)
+		{
+			return false;
+		}
+		const int var_count = (int)header.var_count;
+		const int con_count = (int)header.con_count;
+		const ModelDomainRecord* domain_records = GetModelSection<ModelDomainRecord>(base, header, MODEL_SECTION_DOMAINS, var_count);
+		const ModelConstraintRecord* con_records = GetModelSection<ModelConstraintRecord>(base, header, MODEL_SECTION_CONSTRAINTS, con_count);
+		const int* con_vars_offsets = GetModelSection<int>(base, header, MODEL_SECTION_CONSTRAINT_VARS_OFFSETS, con_count + 1);
+		const VarId* con_vars = GetModelSection<VarId>(base, header, MODEL_SECTION_CONSTRAINT_VARS, header.constraint_var_count);
+		const int* link_offsets = GetModelSection<int>(base, header, MODEL_SECTION_LINK_OFFSETS, var_count + 1);
+		const ModelLinkRecord* links = GetModelSection<ModelLinkRecord>(base, header, MODEL_SECTION_LINKS, header.link_count);
+		const int* tracked_link_offsets = GetModelSection<int>(base, header, MODEL_SECTION_TRACKED_LINK_OFFSETS, var_count + 1);
+		const ModelLinkRecord* tracked = GetModelSection<ModelLinkRecord>(base, header, MODEL_SECTION_TRACKED_LINKS, header.tracked_link_count);
+		const int* con_wake_events = GetModelSection<int>(base, header, MODEL_SECTION_CONSTRAINT_WAKE_EVENTS, con_count);
+		const char* con_tracks = GetModelSection<char>(base, header, MODEL_SECTION_CONSTRAINT_TRACKS, con_count);
+		const int* var_events = GetModelSection<int>(base, header, MODEL_SECTION_VAR_WAKE_EVENTS, var_count);
+		const int* ints = GetModelSection<int>(base, header, MODEL_SECTION_INTS, header.int_count);
+		const unsigned long long* words = GetModelSection<unsigned long long>(base, header, MODEL_SECTION_WORDS, header.word_count);
+		if (domain_records == nullptr || con_records == nullptr || con_vars_offsets == nullptr || con_vars == nullptr || link_offsets == nullptr || links == nullptr
+			|| tracked_link_offsets == nullptr || tracked == nullptr || con_wake_events == nullptr || con_tracks == nullptr || var_events == nullptr || ints == nullptr || words == nullptr)
+		{
+			return false;
+		}
+		auto IsValidVar = [var_count](int vid) { return vid >= 0 && vid < var_count; };
+		auto IsValidRange = [](const int* offsets, int count, uint32_t item_count)
+		{
+			if (offsets[0] != 0 || (uint32_t)offsets[count] != item_count)
+			{
+				return false;
+			}
+			for (int o_idx = 0; o_idx < count; o_idx++)
+			{
+				if (offsets[o_idx] > offsets[o_idx + 1])
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+		if (!IsValidRange(con_vars_offsets, con_count, header.constraint_var_count) || !IsValidRange(link_offsets, var_count, header.link_count)
+			|| !IsValidRange(tracked_link_offsets, var_count, header.tracked_link_count))
+		{
+			return false;
+		}
+		for (uint32_t l_idx = 0; l_idx < header.constraint_var_count; l_idx++)
+		{
+			if (!IsValidVar(con_vars[l_idx]))
+			{
+				return false;
+			}
+		}
+
+		// Values of the domains and payloads of the constraints reference the image, so that a load allocates per section and not per item
+		DEQUAN_Array_Reserve(vars, var_count);
+		DEQUAN_Array_Resize(domains, var_count);
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			const ModelDomainRecord& record = domain_records[v_idx];
+			if (record.type < (int)DomainType::Values || record.type > (int)DomainType::Bitset || record.bits_words < 0 || record.bits_words > Domain::BITSET_MAX_WORDS
+				|| record.values_count < 0 || record.values_offset > header.int_count || header.int_count - record.values_offset < (uint32_t)record.values_count
+				|| (record.type == (int)DomainType::Ranges && (record.values_count & 1) != 0)
+				|| (record.type == (int)DomainType::Bitset && (long long)record.bits_min + 64LL * record.bits_words > INT_MAX))
+			{
+				*this = CSP();
+				return false;
+			}
+			// Values are strictly increasing, and so are the bounds of the ranges, as they are not empty and do not touch
+			const int* record_values = ints + record.values_offset;
+			if (record.type != (int)DomainType::Bitset)
+			{
+				for (int i_idx = 1; i_idx < record.values_count; i_idx++)
+				{
+					if (record_values[i_idx - 1] >= record_values[i_idx])
+					{
+						*this = CSP();
+						return false;
+					}
+				}
+			}
+			Domain& dom = domains[v_idx];
+			dom.type = (DomainType)record.type;
+			dom.bits_min = record.bits_min;
+			dom.bits_words = record.bits_words;
+			for (int w_idx = 0; w_idx < Domain::BITSET_MAX_WORDS; w_idx++)
+			{
+				dom.bits[w_idx] = record.bits[w_idx];
+			}
+			dom.values.Reference(ints + record.values_offset, record.values_count);
+			DEQUAN_Array_PushBack(vars, Var(v_idx));
+		}
+
+		// Built-in arrays are sized once, so that the constraint addresses are stable while they are filled
+		int kind_counts[CONSTRAINT_KIND_COUNT] = {};
+		for (int c_idx = 0; c_idx < con_count; c_idx++)
+		{
+			const ModelConstraintRecord& record = con_records[c_idx];
+			if (record.kind <= (int)ConstraintKind::User || record.kind >= CONSTRAINT_KIND_COUNT || record.ints_offset > header.int_count
+				|| header.int_count - record.ints_offset < record.ints_count || record.words_offset > header.word_count || header.word_count - record.words_offset < record.words_count)
+			{
+				*this = CSP();
+				return false;
+			}
+			kind_counts[record.kind]++;
+		}
+		DEQUAN_Array_Reserve(op_constraints, kind_counts[(int)ConstraintKind::Op]);
+		DEQUAN_Array_Reserve(equality_constraints, kind_counts[(int)ConstraintKind::Equality]);
+		DEQUAN_Array_Reserve(or_equality_constraints, kind_counts[(int)ConstraintKind::OrEquality]);
+		DEQUAN_Array_Reserve(combined_equality_constraints, kind_counts[(int)ConstraintKind::CombinedEquality]);
+		DEQUAN_Array_Reserve(or_range_constraints, kind_counts[(int)ConstraintKind::OrRange]);
+		DEQUAN_Array_Reserve(alldiff_constraints, kind_counts[(int)ConstraintKind::AllDifferent]);
+		DEQUAN_Array_Reserve(linear_constraints, kind_counts[(int)ConstraintKind::Linear]);
+		DEQUAN_Array_Reserve(table_constraints, kind_counts[(int)ConstraintKind::Table]);
+		DEQUAN_Array_Reserve(lex_constraints, kind_counts[(int)ConstraintKind::Lex]);
+		DEQUAN_Array_Resize(constraints, con_count);
+		DEQUAN_Array_Resize(constraint_enabled, con_count);
+		for (int c_idx = 0; c_idx < con_count; c_idx++)
+		{
+			const ModelConstraintRecord& record = con_records[c_idx];
+			const int* payload = ints + record.ints_offset;
+			const int payload_count = (int)record.ints_count;
+			const int arity = con_vars_offsets[c_idx + 1] - con_vars_offsets[c_idx];
+			// Vars of the payload, checked against the adjacency below
+			const VarId* payload_vars = nullptr;
+			int payload_var_count = 0;
+			auto ReadPayloadVars = [&](int first, int count)
+			{
+				if (count < 0 || first + count > payload_count)
+				{
+					return false;
+				}
+				for (int v_idx = 0; v_idx < count; v_idx++)
+				{
+					if (!IsValidVar(payload[first + v_idx]))
+					{
+						return false;
+					}
+				}
+				payload_vars = payload + first;
+				payload_var_count = count;
+				return true;
+			};
+			Constraint* con = nullptr;
+			switch ((ConstraintKind)record.kind)
+			{
+			case ConstraintKind::Op:
+				if (payload_count == 4 && ReadPayloadVars(0, 2) && payload[2] >= (int)OpConstraint::Op::Equal && payload[2] <= (int)OpConstraint::Op::Inf)
+				{
+					con = &StoreConstraint(OpConstraint(payload[0], payload[1], (OpConstraint::Op)payload[2], payload[3]));
+				}
+				break;
+			case ConstraintKind::Equality:
+				if (payload_count == 2 && ReadPayloadVars(0, 2))
+				{
+					con = &StoreConstraint(EqualityConstraint(payload[0], payload[1]));
+				}
+				break;
+			case ConstraintKind::OrEquality:
+				if (payload_count == 3 && ReadPayloadVars(0, 3))
+				{
+					con = &StoreConstraint(OrEqualityConstraint(payload[0], payload[1], payload[2]));
+				}
+				break;
+			case ConstraintKind::CombinedEquality:
+				if (payload_count == 4 && ReadPayloadVars(0, 4))
+				{
+					con = &StoreConstraint(CombinedEqualityConstraint(payload[0], payload[1], payload[2], payload[3]));
+				}
+				break;
+			case ConstraintKind::OrRange:
+				if (payload_count == 4 && ReadPayloadVars(0, 2))
+				{
+					con = &StoreConstraint(OrRangeConstraint(payload[0], payload[1], payload[2], payload[3]));
+				}
+				break;
+			case ConstraintKind::AllDifferent:
+				if (payload_count >= 1 && ReadPayloadVars(1, payload_count - 1) && payload[0] >= (int)AllDifferentConstraint::Filtering::Value && payload[0] <= (int)AllDifferentConstraint::Filtering::Domain)
+				{
+					AllDifferentConstraint& alldiff_con = StoreConstraint(AllDifferentConstraint(Array<VarId>(), (AllDifferentConstraint::Filtering)payload[0]));
+					alldiff_con.alldiff_vars.Reference(payload_vars, payload_var_count);
+					con = &alldiff_con;
+				}
+				break;
+			case ConstraintKind::Linear:
+				if (payload_count >= 4 && payload[3] >= 0 && payload[3] <= payload_count && payload_count == 4 + 2 * payload[3] && ReadPayloadVars(4, payload[3]))
+				{
+					// Saved op and rhs are already normalized by the constructor
+					LinearConstraint& linear_con = StoreConstraint(LinearConstraint(Array<VarId>(), Array<int>(), (OpConstraint::Op)payload[0], 0));
+					linear_con.linear_vars.Reference(payload_vars, payload_var_count);
+					linear_con.coefs.Reference(payload + 4 + payload[3], payload[3]);
+					linear_con.op = (OpConstraint::Op)payload[0];
+					linear_con.rhs = (long long)((unsigned long long)(uint32_t)payload[1] | ((unsigned long long)(uint32_t)payload[2] << 32));
+					con = &linear_con;
+				}
+				break;
+			case ConstraintKind::Table:
+				if (payload_count >= 3 && payload[2] >= 0 && payload[2] < payload_count && payload[0] >= 0 && payload[1] == (payload[0] + 63) / 64 && ReadPayloadVars(3, payload[2])
+					&& payload_count - 3 - payload[2] >= payload[2] + 1)
+				{
+					const int table_arity = payload[2];
+					const int* offsets = payload + 3 + table_arity;
+					const int value_count = payload_count - 3 - 2 * table_arity - 1;
+					if (!IsValidRange(offsets, table_arity, value_count) || (unsigned long long)value_count * payload[1] != record.words_count)
+					{
+						break;
+					}
+					// Bitsets are copied as saved instead of being recomputed from the tuples
+					TableConstraint& table_con = StoreConstraint(TableConstraint(Array<VarId>(), Array<int>()));
+					table_con.table_vars.Reference(payload_vars, payload_var_count);
+					table_con.tuple_count = payload[0];
+					table_con.word_count = payload[1];
+					table_con.value_offsets.Reference(offsets, table_arity + 1);
+					table_con.values.Reference(offsets + table_arity + 1, value_count);
+					table_con.supports.Reference(words + record.words_offset, (int)record.words_count);
+					con = &table_con;
+				}
+				break;
+			case ConstraintKind::Lex:
+				if (payload_count >= 4 && (payload[0] == 0 || payload[0] == 1) && (payload[1] == 1 || payload[1] == -1) && payload[3] >= 0 && payload[3] <= payload_count
+					&& payload_count == 4 + 2 * payload[3] && ReadPayloadVars(4, 2 * payload[3]))
+				{
+					const int lex_size = payload[3];
+					LexConstraint& lex_con = StoreConstraint(LexConstraint(Array<VarId>(), Array<VarId>(), payload[0] == 1, payload[1], payload[2]));
+					lex_con.vars0.Reference(payload_vars, lex_size);
+					lex_con.vars1.Reference(payload_vars + lex_size, lex_size);
+					con = &lex_con;
+				}
+				break;
+			default:
+				break;
+			}
+			// Vars of the payload must be the ones of the adjacency
+			bool valid_con = con != nullptr && arity == payload_var_count;
+			for (int p_idx = 0; valid_con && p_idx < arity; p_idx++)
+			{
+				valid_con = con_vars[con_vars_offsets[c_idx] + p_idx] == payload_vars[p_idx];
+			}
+			if (!valid_con)
+			{
+				*this = CSP();
+				return false;
+			}
+			con->con_id = c_idx;
+			constraints[c_idx] = con;
+			constraint_enabled[c_idx] = record.enabled != 0 ? 1 : 0;
+		}
+
+		// Adjacency and caches, as computed by FinalizeModel()
+		DEQUAN_Array_Resize(constraint_vars_offsets, con_count + 1);
+		for (int c_idx = 0; c_idx <= con_count; c_idx++)
+		{
+			constraint_vars_offsets[c_idx] = con_vars_offsets[c_idx];
+		}
+		DEQUAN_Array_Resize(constraint_vars, header.constraint_var_count);
+		for (uint32_t l_idx = 0; l_idx < header.constraint_var_count; l_idx++)
+		{
+			constraint_vars[l_idx] = con_vars[l_idx];
+		}
+		DEQUAN_Array_Resize(constraint_wake_events, con_count);
+		DEQUAN_Array_Resize(constraint_tracks_assignments, con_count);
+		for (int c_idx = 0; c_idx < con_count; c_idx++)
+		{
+			constraint_wake_events[c_idx] = con_wake_events[c_idx];
+			constraint_tracks_assignments[c_idx] = con_tracks[c_idx] != 0 ? 1 : 0;
+		}
+		auto LoadLinks = [&](const int* offsets, const ModelLinkRecord* records, uint32_t link_count, Array<ConstraintLink>& links_out,
+			Array<int>& offsets_out, Array<int>& ends_out, Array<int>& capacities_out)
+		{
+			DEQUAN_Array_Resize(links_out, link_count);
+			for (uint32_t l_idx = 0; l_idx < link_count; l_idx++)
+			{
+				const ModelLinkRecord& record = records[l_idx];
+				if (record.con_id < 0 || record.con_id >= con_count || record.var_pos < 0
+					|| record.var_pos >= constraint_vars_offsets[record.con_id + 1] - constraint_vars_offsets[record.con_id])
+				{
+					return false;
+				}
+				links_out[l_idx].con = constraints[record.con_id];
+				links_out[l_idx].var_pos = record.var_pos;
+				links_out[l_idx].wake_events = record.wake_events;
+			}
+			DEQUAN_Array_Resize(offsets_out, var_count);
+			DEQUAN_Array_Resize(ends_out, var_count);
+			DEQUAN_Array_Resize(capacities_out, var_count);
+			for (int v_idx = 0; v_idx < var_count; v_idx++)
+			{
+				offsets_out[v_idx] = offsets[v_idx];
+				ends_out[v_idx] = offsets[v_idx + 1];
+				capacities_out[v_idx] = offsets[v_idx + 1] - offsets[v_idx];
+			}
+			return true;
+		};
+		if (!LoadLinks(link_offsets, links, header.link_count, var_links, var_links_offsets, var_links_ends, var_links_capacities)
+			|| !LoadLinks(tracked_link_offsets, tracked, header.tracked_link_count, tracked_links, tracked_links_offsets, tracked_links_ends, tracked_links_capacities))
+		{
+			*this = CSP();
+			return false;
+		}
+		DEQUAN_Array_Resize(var_wake_events, var_count);
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			var_wake_events[v_idx] = var_events[v_idx];
+		}
+		finalized = true;
+		model_revision++;
+		return true;
+	}
+
+#ifdef DEQUAN_WITH_MMAP
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+	bool MappedFile::Open(const char* path)
+	{
+		Close();
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		LARGE_INTEGER file_size;
+		HANDLE mapping = GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+		const void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (view == nullptr)
+		{
+			if (mapping != nullptr)
+			{
+				CloseHandle(mapping);
+			}
+			CloseHandle(file);
+			return false;
+		}
+		file_handle = file;
+		mapping_handle = mapping;
+		data = view;
+		size = (size_t)file_size.QuadPart;
+#else
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+		{
+			return false;
+		}
+		struct stat file_stat;
+		void* view = fstat(fd, &file_stat) == 0 && file_stat.st_size > 0 ? mmap(nullptr, (size_t)file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+		// The mapping keeps the file alive
+		close(fd);
+		if (view == MAP_FAILED)
+		{
+			return false;
+		}
+		data = view;
+		size = (size_t)file_stat.st_size;
+#endif
+		return true;
+	}
+	void MappedFile::Close()
+	{
+		if (data == nullptr)
+		{
+			return;
+		}
+#if defined(_WIN32)
+		UnmapViewOfFile(data);
+		CloseHandle((HANDLE)mapping_handle);
+		CloseHandle((HANDLE)file_handle);
+		file_handle = nullptr;
+		mapping_handle = nullptr;
+#else
+		munmap(const_cast<void*>(data), size);
+#endif
+		data = nullptr;
+		size = 0;
+	}
+#endif
+
+	bool CSP::ForwardCheckingStep(Assignment& a) const
+	{
+		if (a.IsComplete())
+		{
+			return true;
+		}
+
+		// Add a new saved domain step
+		a.PushSavedDomainStep();
+
+		SearchFrame frame = a.MakeSearchFrame(a.NextUnassignedVar());
+		bool found_result = false;
+		int val = 0;
+		bool has_value = a.SelectFirstValue(frame, val);
+		while (has_value && !found_result)
+		{
+			frame.value = val;
+			if (frame.split ? a.TrySplitVar(frame.var_id, frame.pivot, val == 1) : a.TryAssignVar(frame.var_id, val))
+			{
+				// This decision did not violate any constraints, recurse and continue with next variable
+				found_result = ForwardCheckingStep(a);
+			}
+			if (!found_result)
+			{
+				if (!frame.split)
+				{
+					a.UnAssignVar(frame.var_id);
+				}
+				// Restore saved domains since they may have been modified by applied arc consistencies or sub-steps,
+				// the next value is then selected in the domain as it was before this step
+				a.RestoreSavedDomainStep();
+				has_value = a.SelectNextValue(frame, val);
+			}
+		}
+		if (found_result)
+		{
+			return true;
+		}
+
+		a.PopSavedDomainStep();
+		return false;
+	}
+
+	/** Earliest of the budget deadline and of 'start_time' + max_seconds, time_point::max() if the budget has no time limit */
+	std::chrono::steady_clock::time_point SearchBudget::GetDeadline(std::chrono::steady_clock::time_point start_time) const
+	{
+		std::chrono::steady_clock::time_point result = deadline;
+		// Compare in seconds first, so that huge timeouts cannot overflow the time point
+		if (max_seconds > 0.0 && max_seconds < std::chrono::duration<double>(result - start_time).count())
+		{
+			result = start_time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(max_seconds));
+		}
+		return result;
+	}
+
+	SearchStatus CSP::Solve(Assignment& a, const SearchBudget& budget) const
+	{
+		return Search(a, budget, nullptr, 0);
+	}
+
+	SearchStatus CSP::Optimize(Assignment& a, VarId objective_var, ObjectiveSense sense, const SearchBudget& budget) const
+	{
+		return Optimize(a, objective_var, sense, [](const Array<InstVar>&) -> bool { return true; }, budget);
+	}
+
+	unsigned long long CSP::CountSolutions(Assignment& a, unsigned long long max_solutions, const SearchBudget& budget, SearchStatus* status) const
+	{
+		unsigned long long solution_count = 0;
+		SearchStatus search_status = SearchStatus::Infeasible;
+		while (max_solutions == 0 || solution_count < max_solutions)
+		{
+			search_status = Search(a, budget, &solution_count, max_solutions);
+			if (search_status != SearchStatus::Solved)
+			{
+				// Either the search space is exhausted, or the solution or search budget ran out
+				break;
+			}
+			// Only happens if a complete assignment is reached before the last var, i.e. for models without any var
+			solution_count++;
+		}
+		if (status != nullptr)
+		{
+			*status = search_status;
+		}
+		return max_solutions > 0 && solution_count > max_solutions ? max_solutions : solution_count;
+	}
+
+	SearchStatus CSP::Search(Assignment& a, const SearchBudget& budget, unsigned long long* leaf_count, unsigned long long max_count) const
+	{
+		const unsigned long long node_limit = budget.max_nodes > 0 ? a.search_nodes + budget.max_nodes : 0;
+		const unsigned long long backtrack_limit = budget.max_backtracks > 0 ? a.search_backtracks + budget.max_backtracks : 0;
+		const std::chrono::steady_clock::time_point deadline = budget.GetDeadline(std::chrono::steady_clock::now());
+		const bool has_deadline = deadline != std::chrono::steady_clock::time_point::max();
+		// Restarting while counting would count again the solutions of the abandoned subtrees, and nogoods are only recorded from assignments
+		const bool restart_enabled = a.params.restart_policy != RestartPolicy::None && a.params.value_order != ValueOrder::Split &&
+			leaf_count == nullptr && a.search_root_depth == 0;
+
+		for (unsigned int loop_idx = 0; ; loop_idx++)
+		{
+			if (a.search_point == SearchPoint::Finished)
+			{
+				return SearchStatus::Infeasible;
+			}
+			if ((node_limit > 0 && a.search_nodes >= node_limit) || (backtrack_limit > 0 && a.search_backtracks >= backtrack_limit))
+			{
+				return SearchStatus::Paused;
+			}
+			if (budget.stop_flag != nullptr && (loop_idx & 63) == 63 && budget.stop_flag->load(std::memory_order_relaxed))
+			{
+				return SearchStatus::Cancelled;
+			}
+			// Don't query the clock at every node
+			if (has_deadline && (loop_idx & 255) == 255 && std::chrono::steady_clock::now() >= deadline)
+			{
+				return SearchStatus::Timeout;
+			}
+
+			if (a.search_point == SearchPoint::Descend)
+			{
+				if (a.IsComplete())
+				{
+					// Next call will backtrack from this solution
+					a.search_point = SearchPoint::NextValue;
+#ifdef DEQUAN_WITH_TRACE
+					a.trace.Record(TraceEvent::Solution);
+#endif
+					return SearchStatus::Solved;
+				}
+
+				if (leaf_count != nullptr && a.assigned_var_count + 1 == DEQUAN_Array_Size(a.inst_vars))
+				{
+					// Counting: no need to assign and propagate the last var, validating its values is enough
+					VarId vid = a.NextUnassignedVar();
+					const Domain& dom = a.GetCurrentDomain(vid);
+					const Var& var = vars[vid];
+					if (!dom.IsEmpty())
+					{
+						int val = dom.Min();
+						do
+						{
+							a.inst_vars[vid].value = val;
+							a.NotifyVarAssigned(vid);
+							a.search_nodes++;
+#ifdef DEQUAN_WITH_STATS
+							a.stats.assigned_vars++;
+							a.stats.depth_histogram[a.assigned_var_count]++;
+#endif
+							if (a.ValidateVarConstraints(var))
+							{
+								(*leaf_count)++;
+							}
+							a.NotifyVarUnassigned(vid);
+						} while ((max_count == 0 || *leaf_count < max_count) && dom.NextValue(val, val));
+						a.inst_vars[vid].value = InstVar::UNASSIGNED;
+					}
+					a.search_point = SearchPoint::NextValue;
+					if (max_count > 0 && *leaf_count >= max_count)
+					{
+						return SearchStatus::Paused;
+					}
+					continue;
+				}
+
+				// Add a new saved domain step for the next var
+				a.PushSavedDomainStep();
+				SearchFrame new_frame = a.MakeSearchFrame(a.NextUnassignedVar());
+				new_frame.refuted_start = (int)DEQUAN_Array_Size(a.search_refuted);
+				DEQUAN_Array_PushBack(a.search_stack, new_frame);
+				a.search_point = SearchPoint::NextValue;
+				continue;
+			}
+
+			// SearchPoint::NextValue
+			if (DEQUAN_Array_Size(a.search_stack) == a.search_root_depth)
+			{
+				a.search_point = SearchPoint::Finished;
+				return SearchStatus::Infeasible;
+			}
+
+			SearchFrame& frame = DEQUAN_Array_Back(a.search_stack);
+			int val = 0;
+			bool has_value = false;
+			if (frame.value == InstVar::UNASSIGNED)
+			{
+				has_value = a.SelectFirstValue(frame, val);
+			}
+			else
+			{
+				// Previous value failed, or led to a solution already reported
+				if (restart_enabled)
+				{
+					DEQUAN_Array_PushBack(a.search_refuted, frame.value);
+					if (a.ShouldRestart())
+					{
+						a.Restart();
+						continue;
+					}
+				}
+				if (!frame.split)
+				{
+					a.UnAssignVar(frame.var_id);
+				}
+				a.RestoreSavedDomainStep();
+				has_value = a.SelectNextValue(frame, val);
+			}
+
+			if (has_value)
+			{
+				frame.value = val;
+				if (frame.split ? a.TrySplitVar(frame.var_id, frame.pivot, val == 1) : a.TryAssignVar(frame.var_id, val))
+				{
+					a.search_point = SearchPoint::Descend;
+				}
+			}
+			else
+			{
+				// All values failed, backtrack to the previous var
+				if (restart_enabled)
+				{
+					DEQUAN_Array_Resize(a.search_refuted, frame.refuted_start);
+				}
+				a.PopSavedDomainStep();
+				DEQUAN_Array_PopBack(a.search_stack);
+			}
+		}
+	}
+
+#ifdef DEQUAN_WITH_THREADS
+	SearchStatus CSP::SolvePortfolio(Array<Assignment>& assignments, int& winner_idx, const SearchBudget& budget) const
+	{
+		std::atomic<bool> stop_flag(false);
+		std::atomic<int> winner(-1);
+		// Workers still searching, guarded by done_mutex so that the last one can wake up the caller
+		int running_count = (int)DEQUAN_Array_Size(assignments);
+		std::mutex done_mutex;
+		std::condition_variable done_cond;
+		SearchStatus winner_status = SearchStatus::Paused;
+		std::atomic<int> interrupted_status((int)SearchStatus::Paused);
+
+		// Workers share the same deadline, and are cancelled through a private flag
+		SearchBudget worker_budget = budget;
+		worker_budget.deadline = budget.GetDeadline(std::chrono::steady_clock::now());
+		worker_budget.max_seconds = 0.0;
+		worker_budget.stop_flag = &stop_flag;
+
+		Array<std::thread> threads;
+		DEQUAN_Array_Reserve(threads, DEQUAN_Array_Size(assignments));
+		for (int a_idx = 0; a_idx < DEQUAN_Array_Size(assignments); a_idx++)
+		{
+			DEQUAN_Array_PushBack(threads, std::thread([this, &assignments, &worker_budget, &stop_flag, &winner, &running_count, &done_mutex, &done_cond, &winner_status, &interrupted_status, a_idx]()
+			{
+				Assignment& a = assignments[a_idx];
+				a.Reset(*this);
+				SearchStatus status = Solve(a, worker_budget);
+				int no_winner = -1;
+				if (!IsSearchInterrupted(status) && winner.compare_exchange_strong(no_winner, a_idx))
+				{
+					// Both a solution and a proof of infeasibility end the search for everyone
+					winner_status = status;
+					stop_flag.store(true);
+				}
+				else if (status == SearchStatus::Timeout)
+				{
+					interrupted_status.store((int)SearchStatus::Timeout);
+				}
+				std::lock_guard<std::mutex> lock(done_mutex);
+				if (--running_count == 0)
+				{
+					done_cond.notify_one();
+				}
+			}));
+		}
+
+		// Forward an external stop request to the workers. The flag can't notify, so it is polled until it is raised or the workers are done,
+		// without an external flag the workers are just joined.
+		if (budget.stop_flag != nullptr)
+		{
+			std::unique_lock<std::mutex> lock(done_mutex);
+			while (running_count > 0 && !stop_flag.load())
+			{
+				if (budget.stop_flag->load(std::memory_order_relaxed))
+				{
+					interrupted_status.store((int)SearchStatus::Cancelled);
+					stop_flag.store(true);
+					break;
+				}
+				done_cond.wait_for(lock, std::chrono::milliseconds(1));
+			}
+		}
+		for (int t_idx = 0; t_idx < DEQUAN_Array_Size(threads); t_idx++)
+		{
+			threads[t_idx].join();
+		}
+
+		winner_idx = winner.load();
+		return winner_idx >= 0 ? winner_status : (SearchStatus)interrupted_status.load();
+	}
+
+	SearchStatus CSP::SolveParallel(Array<Assignment>& assignments, int& winner_idx, const SearchBudget& budget) const
+	{
+		return ParallelSearch(assignments, winner_idx, nullptr, budget);
+	}
+
+	unsigned long long CSP::CountSolutionsParallel(Array<Assignment>& assignments, const SearchBudget& budget) const
+	{
+		int winner_idx = -1;
+		unsigned long long solution_count = 0;
+		ParallelSearch(assignments, winner_idx, &solution_count, budget);
+		return solution_count;
+	}
+
+	SearchStatus CSP::ParallelSearch(Array<Assignment>& assignments, int& winner_idx, unsigned long long* solution_count, const SearchBudget& budget) const
+	{
+		// Number of nodes searched between two checks for idle workers
+		static const unsigned long long SLICE_NODES = 256;
+
+		const int worker_count = (int)DEQUAN_Array_Size(assignments);
+		const std::chrono::steady_clock::time_point deadline = budget.GetDeadline(std::chrono::steady_clock::now());
+		SearchParams params = assignments[0].params;
+		params.value_order = ValueOrder::Min;
+		// Restarts and value hints would break the value windows of the split tasks
+		params.restart_policy = RestartPolicy::None;
+		DEQUAN_Array_Clear(params.value_hints);
+		params.value_hint_callback = nullptr;
+
+		std::mutex task_mutex;
+		std::condition_variable task_cond;
+		Array<SearchTask> tasks;
+		std::atomic<int> idle_count(0);
+		bool all_idle = false;
+		std::atomic<bool> stop_flag(false);
+		/** Status of the search if it is interrupted by the budget, Infeasible as long as it is not */
+		std::atomic<int> interrupted_status((int)SearchStatus::Infeasible);
+		std::atomic<int> winner(-1);
+		std::atomic<unsigned long long> total_nodes(0);
+		std::atomic<unsigned long long> total_backtracks(0);
+		std::atomic<unsigned long long> total_solutions(0);
+
+		// Start with the whole search tree
+		DEQUAN_Array_PushBack(tasks, SearchTask());
+
+		auto Worker = [&](int a_idx)
+		{
+			Assignment& a = assignments[a_idx];
+			a.params = params;
+			SearchBudget slice_budget;
+			slice_budget.max_nodes = SLICE_NODES;
+			slice_budget.stop_flag = &stop_flag;
+			SearchTask task, split_task;
+			unsigned long long leaf_count = 0;
+
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(task_mutex);
+					idle_count++;
+					while (DEQUAN_Array_Size(tasks) == 0 && !all_idle && !stop_flag.load())
+					{
+						if (idle_count.load() == worker_count)
+						{
+							// Nobody is left to split its search, the whole tree has been explored
+							all_idle = true;
+							task_cond.notify_all();
+							break;
+						}
+						task_cond.wait(lock);
+					}
+					if (all_idle || stop_flag.load())
+					{
+						break;
+					}
+					task = DEQUAN_Array_Back(tasks);
+					DEQUAN_Array_PopBack(tasks);
+					idle_count--;
+				}
+
+				a.Reset(*this);
+				if (!a.StartSearchTask(task))
+				{
+					continue;
+				}
+				while (true)
+				{
+					unsigned long long start_nodes = a.search_nodes;
+					unsigned long long start_backtracks = a.search_backtracks;
+					SearchStatus status = Search(a, slice_budget, solution_count != nullptr ? &leaf_count : nullptr, 0);
+					unsigned long long nodes = total_nodes += a.search_nodes - start_nodes;
+					unsigned long long backtracks = total_backtracks += a.search_backtracks - start_backtracks;
+
+					if (status == SearchStatus::Infeasible)
+					{
+						break;
+					}
+					if (status == SearchStatus::Solved)
+					{
+						if (solution_count != nullptr)
+						{
+							// Complete assignment reached outside of the counting fast path, count it and go on
+							leaf_count++;
+							continue;
+						}
+						int no_winner = -1;
+						if (winner.compare_exchange_strong(no_winner, a_idx))
+						{
+							stop_flag.store(true);
+						}
+						break;
+					}
+
+					// Paused, check the budget and whether some workers are waiting for work
+					SearchStatus budget_status = SearchStatus::Infeasible;
+					if (budget.stop_flag != nullptr && budget.stop_flag->load(std::memory_order_relaxed))
+					{
+						budget_status = SearchStatus::Cancelled;
+					}
+					else if ((budget.max_nodes > 0 && nodes >= budget.max_nodes) || (budget.max_backtracks > 0 && backtracks >= budget.max_backtracks))
+					{
+						budget_status = SearchStatus::Paused;
+					}
+					else if (deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= deadline)
+					{
+						budget_status = SearchStatus::Timeout;
+					}
+					if (stop_flag.load() || budget_status != SearchStatus::Infeasible)
+					{
+						int not_interrupted = (int)SearchStatus::Infeasible;
+						if (budget_status != SearchStatus::Infeasible && winner.load() < 0)
+						{
+							interrupted_status.compare_exchange_strong(not_interrupted, (int)budget_status);
+						}
+						stop_flag.store(true);
+						break;
+					}
+					if (idle_count.load() > 0 && a.SplitSearchTask(split_task))
+					{
+						std::lock_guard<std::mutex> lock(task_mutex);
+						DEQUAN_Array_PushBack(tasks, split_task);
+						task_cond.notify_one();
+					}
+				}
+			}
+
+			total_solutions += leaf_count;
+			task_cond.notify_all();
+		};
+
+		Array<std::thread> threads;
+		DEQUAN_Array_Reserve(threads, worker_count);
+		for (int a_idx = 0; a_idx < worker_count; a_idx++)
+		{
+			DEQUAN_Array_PushBack(threads, std::thread(Worker, a_idx));
+		}
+		for (int t_idx = 0; t_idx < DEQUAN_Array_Size(threads); t_idx++)
+		{
+			threads[t_idx].join();
+		}
+
+		winner_idx = winner.load();
+		if (solution_count != nullptr)
+		{
+			*solution_count = total_solutions.load();
+		}
+		if (winner_idx >= 0)
+		{
+			return SearchStatus::Solved;
+		}
+		return (SearchStatus)interrupted_status.load();
+	}
+#endif
+
+	/**
+	 * Hand out the instances of a batch in chunks to one thread per assignment, 'solve_instance(a, instance_idx)' solves an instance with the assignment of the thread.
+	 * Chunks of consecutive instances amortize the shared counter, and keep the threads from writing the results next to each other.
+	 */
+	template <class F>
+	static void RunBatch(Array<Assignment>& assignments, int instance_count, F solve_instance)
+	{
+		static const int CHUNK_SIZE = 16;
+		std::atomic<int> next_instance(0);
+		auto Worker = [&next_instance, instance_count, &solve_instance](Assignment& a)
+		{
+			for (int first = next_instance.fetch_add(CHUNK_SIZE); first < instance_count; first = next_instance.fetch_add(CHUNK_SIZE))
+			{
+				int last = first + CHUNK_SIZE < instance_count ? first + CHUNK_SIZE : instance_count;
+				for (int i_idx = first; i_idx < last; i_idx++)
+				{
+					solve_instance(a, i_idx);
+				}
+			}
+		};
+		if (DEQUAN_Array_Size(assignments) == 0)
+		{
+			return;
+		}
+#ifdef DEQUAN_WITH_THREADS
+		// No more threads than chunks, the calling thread works with the first assignment
+		int thread_count = (int)DEQUAN_Array_Size(assignments);
+		int chunk_count = (instance_count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		thread_count = thread_count < chunk_count ? thread_count : chunk_count;
+		Array<std::thread> threads;
+		DEQUAN_Array_Reserve(threads, thread_count);
+		for (int a_idx = 1; a_idx < thread_count; a_idx++)
+		{
+			DEQUAN_Array_PushBack(threads, std::thread([&Worker, &assignments, a_idx]() { Worker(assignments[a_idx]); }));
+		}
+		Worker(assignments[0]);
+		for (int t_idx = 0; t_idx < DEQUAN_Array_Size(threads); t_idx++)
+		{
+			threads[t_idx].join();
+		}
+#else
+		Worker(assignments[0]);
+#endif
+	}
+
+	/** Whether the deadline or the stop flag of a batch have been reached before starting an instance, with the corresponding status */
+	static bool IsBatchStopped(const SearchBudget& budget, SearchStatus& status)
+	{
+		if (budget.stop_flag != nullptr && budget.stop_flag->load(std::memory_order_relaxed))
+		{
+			status = SearchStatus::Cancelled;
+			return true;
+		}
+		if (budget.deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= budget.deadline)
+		{
+			status = SearchStatus::Timeout;
+			return true;
+		}
+		return false;
+	}
+
+	/** Copy the status and solution of an instance to the results */
+	static void StoreBatchResult(const Assignment& a, SearchStatus status, BatchResults& results, int instance_idx)
+	{
+		BatchResult& result = results.results[instance_idx];
+		result.status = status;
+		result.search_nodes = a.search_nodes;
+		if (status == SearchStatus::Solved)
+		{
+			for (int v_idx = 0; v_idx < DEQUAN_Array_Size(a.inst_vars); v_idx++)
+			{
+				results.values[result.values_offset + v_idx] = a.inst_vars[v_idx].value;
+			}
+		}
+	}
+
+	void CSP::SolveBatch(Array<Assignment>& assignments, const Array<int>& fixed_offsets, const Array<VarId>& fixed_vars, const Array<int>& fixed_values,
+		BatchResults& results, const SearchBudget& budget) const
+	{
+		const int instance_count = DEQUAN_Array_Size(fixed_offsets) > 0 ? (int)DEQUAN_Array_Size(fixed_offsets) - 1 : 0;
+		const int var_count = (int)DEQUAN_Array_Size(vars);
+		// The results are laid out before solving, so that each thread only writes the slots of its instances
+		DEQUAN_Array_Resize(results.results, instance_count);
+		DEQUAN_Array_Resize(results.values, (size_t)instance_count * var_count);
+		for (int i_idx = 0; i_idx < instance_count; i_idx++)
+		{
+			results.results[i_idx].values_offset = i_idx * var_count;
+		}
+
+		RunBatch(assignments, instance_count, [this, &fixed_offsets, &fixed_vars, &fixed_values, &results, &budget](Assignment& a, int instance_idx)
+		{
+			SearchStatus status = SearchStatus::Paused;
+			if (IsBatchStopped(budget, status))
+			{
+				results.results[instance_idx].status = status;
+				results.results[instance_idx].search_nodes = 0;
+				return;
+			}
+			if (a.csp != this)
+			{
+				a.Reset(*this);
+			}
+			else
+			{
+				// Only the domains modified by the previous instance are restored, the random generator restarts so that the instance is solved like by a fresh assignment
+				a.Rewind();
+				a.random = Random(a.params.random_seed);
+			}
+			// Once a fixing fails the next ones fail too, and Solve() reports the instance infeasible right away
+			for (int f_idx = fixed_offsets[instance_idx]; f_idx < fixed_offsets[instance_idx + 1]; f_idx++)
+			{
+				a.FixVar(fixed_vars[f_idx], fixed_values[f_idx]);
+			}
+			StoreBatchResult(a, Solve(a, budget), results, instance_idx);
+		});
+	}
+
+	void CSP::SolveBatch(Array<Assignment>& assignments, const Array<const CSP*>& models, BatchResults& results, const SearchBudget& budget)
+	{
+		const int instance_count = (int)DEQUAN_Array_Size(models);
+		DEQUAN_Array_Resize(results.results, instance_count);
+		int values_count = 0;
+		for (int i_idx = 0; i_idx < instance_count; i_idx++)
+		{
+			results.results[i_idx].values_offset = values_count;
+			values_count += (int)DEQUAN_Array_Size(models[i_idx]->vars);
+		}
+		DEQUAN_Array_Resize(results.values, values_count);
+
+		RunBatch(assignments, instance_count, [&models, &results, &budget](Assignment& a, int instance_idx)
+		{
+			SearchStatus status = SearchStatus::Paused;
+			if (IsBatchStopped(budget, status))
+			{
+				results.results[instance_idx].status = status;
+				results.results[instance_idx].search_nodes = 0;
+				return;
+			}
+			const CSP& model = *models[instance_idx];
+			a.Reset(model);
+			StoreBatchResult(a, model.Solve(a, budget), results, instance_idx);
+		});
+	}
+
+	bool Assignment::ValidateVarConstraints(const Var& var) /*const*/
+	{
+		for (int l_idx = csp->var_links_offsets[var.var_id]; l_idx < csp->var_links_ends[var.var_id]; l_idx++)
+		{
+			const ConstraintLink& link = csp->var_links[l_idx];
+			bool violated = EvaluateConstraint(*link.con, *this, var.var_id, link.var_pos) == Constraint::Eval::Failed;
+#ifdef DEQUAN_WITH_STATS
+			stats.validated_constraints++;
+			stats.RecordValidation(link.con->con_id, violated);
+#endif
+			if (violated)
+			{
+				OnConstraintFailure(*link.con);
+				return false;
+			}
+		}
+
+		return true;
+	}
+	bool Assignment::PropagateVarConstraints(const Var& var)
+	{
+		// Reduce the domain to the assigned value, the resulting events are not flushed since all the linked constraints are applied below anyway
+		bool success = IntersectVar(var.var_id, inst_vars[var.var_id].value);
+		ClearDomainEvents();
+
+		if (success && DEQUAN_Array_Size(nogood_offsets) > 1)
+		{
+			success = PropagateNogoods(var.var_id);
+			if (success && DEQUAN_Array_Size(touched_vars) > 0)
+			{
+				FlushDomainEvents();
+			}
+		}
+		if (success && has_incumbent)
+		{
+			success = ApplyObjectiveBound();
+		}
+
+		// An assignment wakes up all the linked constraints, even if the domain was already reduced to the assigned value:
+		// initial domains may be fixed without any event ever being raised for them
+		for (int l_idx = csp->var_links_offsets[var.var_id]; l_idx < csp->var_links_ends[var.var_id] && success; l_idx++)
+		{
+			const ConstraintLink& link = csp->var_links[l_idx];
+			if (link.wake_events == 0)
+			{
+				continue;
+			}
+#ifdef DEQUAN_WITH_STATS
+			stats.applied_arcs++;
+			unsigned long long start_cycles = stats.StartTiming();
+#endif
+			bool applied = ApplyConstraintArcConsistency(*link.con, *this, var.var_id, link.var_pos);
+#ifdef DEQUAN_WITH_STATS
+			stats.RecordPropagation(link.con->con_id, applied, (int)DEQUAN_Array_Size(touched_vars), start_cycles);
+#endif
+			if (!applied)
+			{
+				OnConstraintFailure(*link.con);
+				success = false;
+			}
+			else if (DEQUAN_Array_Size(touched_vars) > 0)
+			{
+				FlushDomainEvents();
+			}
+		}
+
+		if (!success)
+		{
+			// Forget pending changes, domains will be restored by the search
+			ClearPropagation();
+			return false;
+		}
+		return PropagateQueuedConstraints();
+	}
+	bool Assignment::PropagateQueuedConstraints()
+	{
+		// Apply the constraints woken up by the domain changes until fixpoint
+		bool success = true;
+		while (success && prop_queue_count > 0)
+		{
+			Constraint* con = PopQueuedConstraint();
+#ifdef DEQUAN_WITH_STATS
+			stats.applied_arcs++;
+			unsigned long long start_cycles = stats.StartTiming();
+#endif
+			bool applied = ApplyConstraintArcConsistency(*con, *this, prop_wake_vids[con->con_id], prop_wake_pos[con->con_id]);
+#ifdef DEQUAN_WITH_STATS
+			stats.RecordPropagation(con->con_id, applied, (int)DEQUAN_Array_Size(touched_vars), start_cycles);
+#endif
+			if (!applied)
+			{
+				OnConstraintFailure(*con);
+				success = false;
+			}
+			else if (DEQUAN_Array_Size(touched_vars) > 0)
+			{
+				FlushDomainEvents();
+			}
+		}
+
+		if (!success)
+		{
+			ClearPropagation();
+		}
+		return success;
+	}
+	void Assignment::ClearPropagation()
+	{
+		while (prop_queue_count > 0)
+		{
+			PopQueuedConstraint();
+		}
+		ClearDomainEvents();
+	}
+	void Assignment::ClearDomainEvents()
+	{
+		for (int t_idx = 0; t_idx < DEQUAN_Array_Size(touched_vars); t_idx++)
+		{
+			touched_var_pos[touched_vars[t_idx]] = -1;
+			RefreshVarBounds(touched_vars[t_idx]);
+		}
+		DEQUAN_Array_Clear(touched_vars);
+	}
+	void Assignment::RefreshVarBounds(VarId vid)
+	{
+		const Domain& dom = current_domains[vid];
+		var_sizes[vid] = dom.Size();
+		if (var_sizes[vid] > 0)
+		{
+			var_mins[vid] = dom.Min();
+			var_maxs[vid] = dom.Max();
+		}
+	}
+	void Assignment::FlushDomainEvents()
+	{
+		for (int t_idx = 0; t_idx < DEQUAN_Array_Size(touched_vars); t_idx++)
+		{
+			VarId vid = touched_vars[t_idx];
+			touched_var_pos[vid] = -1;
+
+			const Domain& dom = current_domains[vid];
+			int size = dom.Size();
+			if (size == var_sizes[vid] || size == 0)
+			{
+				var_sizes[vid] = size;
+				continue;
+			}
+			int min_val = dom.Min(), max_val = dom.Max();
+			int events = Constraint::EVENT_DOMAIN;
+			if (min_val != var_mins[vid] || max_val != var_maxs[vid])
+			{
+				events |= Constraint::EVENT_BOUNDS;
+			}
+			var_sizes[vid] = size;
+			var_mins[vid] = min_val;
+			var_maxs[vid] = max_val;
+			if (size == 1)
+			{
+				events |= Constraint::EVENT_FIXED;
+			}
+			if ((csp->var_wake_events[vid] & events) == 0)
+			{
+				continue;
+			}
+
+			for (int l_idx = csp->var_links_offsets[vid]; l_idx < csp->var_links_ends[vid]; l_idx++)
+			{
+				const ConstraintLink& link = csp->var_links[l_idx];
+				if ((link.wake_events & events) != 0)
+				{
+					QueueConstraint(link.con, vid, link.var_pos);
+				}
+			}
+		}
+		DEQUAN_Array_Clear(touched_vars);
+	}
+	void Assignment::QueueConstraint(Constraint* con, VarId wake_vid, int wake_pos)
+	{
+		if (prop_queued[con->con_id])
+		{
+			return;
+		}
+		prop_queued[con->con_id] = 1;
+		prop_wake_vids[con->con_id] = wake_vid;
+		prop_wake_pos[con->con_id] = wake_pos;
+		int queue_idx = prop_queue_head + prop_queue_count++;
+		if (queue_idx >= DEQUAN_Array_Size(prop_queue))
+		{
+			queue_idx -= (int)DEQUAN_Array_Size(prop_queue);
+		}
+		prop_queue[queue_idx] = con;
+	}
+	Constraint* Assignment::PopQueuedConstraint()
+	{
+		Constraint* con = prop_queue[prop_queue_head];
+		prop_queued[con->con_id] = 0;
+		prop_queue_count--;
+		if (++prop_queue_head == DEQUAN_Array_Size(prop_queue))
+		{
+			prop_queue_head = 0;
+		}
+		return con;
+	}
+	bool Assignment::ExcludeVarInf(VarId vid, long long rmin)
+	{
+		Domain& dom = current_domains[vid];
+		if (rmin <= dom.Min())
+		{
+			return true;
+		}
+		if (rmin > dom.Max())
+		{
+			return false;
+		}
+		if (dom.type == DomainType::Bitset)
+		{
+			EnsureSavedDomain(vid, dom);
+		}
+		else if (dom.type == DomainType::Values)
+		{
+			SaveDomainSplice(vid, dom, 0, FindFirstAtLeast(dom.values, 0, 1, rmin), 0);
+		}
+		else
+		{
+			// Ranges ending at rmin or before are dropped, and the first kept one is cut if it starts before rmin
+			int r_idx = 2 * FindFirstAtLeast(dom.values, 1, 2, rmin + 1);
+			bool cut = dom.values[r_idx] < rmin;
+			SaveDomainSplice(vid, dom, 0, cut ? r_idx + 1 : r_idx, cut ? 1 : 0);
+		}
+		dom.ExcludeInf((int)rmin);
+		return !dom.IsEmpty();
+	}
+	bool Assignment::ExcludeVarSup(VarId vid, long long rmax)
+	{
+		Domain& dom = current_domains[vid];
+		if (rmax > dom.Max())
+		{
+			return true;
+		}
+		if (rmax <= dom.Min())
+		{
+			return false;
+		}
+		if (dom.type == DomainType::Bitset)
+		{
+			EnsureSavedDomain(vid, dom);
+		}
+		else if (dom.type == DomainType::Values)
+		{
+			SaveDomainSplice(vid, dom, FindFirstAtLeast(dom.values, 0, 1, rmax), dom.values.Size(), 0);
+		}
+		else
+		{
+			// Ranges starting at rmax or later are dropped, and the last kept one is cut if it ends after rmax
+			int r_end = 2 * FindFirstAtLeast(dom.values, 0, 2, rmax);
+			bool cut = r_end > 0 && dom.values[r_end - 1] > rmax;
+			SaveDomainSplice(vid, dom, cut ? r_end - 1 : r_end, dom.values.Size(), cut ? 1 : 0);
+		}
+		dom.ExcludeSup((int)rmax);
+		return !dom.IsEmpty();
+	}
+	bool Assignment::IntersectVar(VarId vid, long long val)
+	{
+		Domain& dom = current_domains[vid];
+		if (val < INT_MIN || val > INT_MAX || !dom.Contains((int)val))
+		{
+			return false;
+		}
+		if (!dom.IsFixed())
+		{
+			if (dom.type == DomainType::Bitset)
+			{
+				EnsureSavedDomain(vid, dom);
+			}
+			else
+			{
+				// Every other value is removed, the domain becomes a single value
+				SaveDomainSplice(vid, dom, 0, dom.values.Size(), 1);
+			}
+			dom.Intersect((int)val);
+		}
+		return true;
+	}
+	bool Assignment::ExcludeVar(VarId vid, long long val)
+	{
+		Domain& dom = current_domains[vid];
+		if (val < INT_MIN || val > INT_MAX || !dom.Contains((int)val))
+		{
+			return true;
+		}
+		if (dom.type == DomainType::Bitset)
+		{
+			EnsureSavedDomain(vid, dom);
+		}
+		else if (dom.type == DomainType::Values)
+		{
+			int d_idx = FindFirstAtLeast(dom.values, 0, 1, val);
+			SaveDomainSplice(vid, dom, d_idx, d_idx + 1, 0);
+		}
+		else
+		{
+			// Same cases as Domain::Exclude(): the range is dropped, one of its bounds moves, or it is split in two
+			int r_idx = 2 * FindFirstAtLeast(dom.values, 1, 2, val + 1);
+			int min = dom.values[r_idx];
+			int max = dom.values[r_idx + 1];
+			if (max - min <= 1)
+			{
+				SaveDomainSplice(vid, dom, r_idx, r_idx + 2, 0);
+			}
+			else if (val == min)
+			{
+				SaveDomainSplice(vid, dom, r_idx, r_idx + 1, 1);
+			}
+			else
+			{
+				SaveDomainSplice(vid, dom, r_idx + 1, r_idx + 2, val + 1 == max ? 1 : 3);
+			}
+		}
+		dom.Exclude((int)val);
+		return !dom.IsEmpty();
+	}
+	bool Assignment::IntersectVarValues(VarId vid, const int* sorted_vals, int count)
+	{
+		Domain& dom = current_domains[vid];
+		if (dom.type != DomainType::Values)
+		{
+			EnsureSavedDomain(vid, dom);
+			dom.IntersectValues(sorted_vals, count);
+			return !dom.IsEmpty();
+		}
+		TouchVar(vid, dom);
+		if (trail_domain_stamps[vid] != trail_stamp)
+		{
+			// Only the removed values are backed up, in ascending order
+			TrailEntry entry{ vid, dom.type, TrailEntry::Kind::Removed, (int)DEQUAN_Array_Size(trail_values), 0 };
+			for (int d_idx = 0, v_idx = 0; d_idx < dom.values.Size(); d_idx++)
+			{
+				while (v_idx < count && sorted_vals[v_idx] < dom.values[d_idx])
+				{
+					v_idx++;
+				}
+				if (v_idx == count || sorted_vals[v_idx] != dom.values[d_idx])
+				{
+					DEQUAN_Array_PushBack(trail_values, dom.values[d_idx]);
+				}
+			}
+			entry.values_count = (int)DEQUAN_Array_Size(trail_values) - entry.values_offset;
+			if (entry.values_count == 0)
+			{
+				return true;
+			}
+			entry.first_of_var = trail_var_stamps[vid] != trail_stamp;
+			trail_var_stamps[vid] = trail_stamp;
+			DEQUAN_Array_PushBack(trail, entry);
+		}
+		dom.IntersectValues(sorted_vals, count);
+		return !dom.IsEmpty();
+	}
+	Constraint::Eval Constraint::EvaluateTracked(Assignment& a, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		return Evaluate(a.inst_vars, last_assigned_vid, last_assigned_pos);
+	}
+	void OpConstraint::LinkVars(Array<VarId>& linked_vars) const
+	{
+		DEQUAN_Array_PushBack(linked_vars, v0);
+		DEQUAN_Array_PushBack(linked_vars, v1);
+	}
+	Constraint::Eval OpConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		if (inst_vars[v0].value != InstVar::UNASSIGNED &&
+			inst_vars[v1].value != InstVar::UNASSIGNED)
+		{
+			switch (op)
+			{
+			case Op::Equal:
+				if (inst_vars[v0].value == inst_vars[v1].value + offset)
+					return Constraint::Eval::Passed;
+				break;
+			case Op::NotEqual:
+				if (inst_vars[v0].value != inst_vars[v1].value + offset)
+					return Constraint::Eval::Passed;
+				break;
+			case Op::SupEqual:
+				if (inst_vars[v0].value >= inst_vars[v1].value + offset)
+					return Constraint::Eval::Passed;
+				break;
+			case Op::Sup:
+				if (inst_vars[v0].value > inst_vars[v1].value + offset)
+					return Constraint::Eval::Passed;
+				break;
+			case Op::InfEqual:
+				if (inst_vars[v0].value <= inst_vars[v1].value + offset)
+					return Constraint::Eval::Passed;
+				break;
+			case Op::Inf:
+				if (inst_vars[v0].value < inst_vars[v1].value + offset)
+					return Constraint::Eval::Passed;
+				break;
+			};
+
+			return Constraint::Eval::Failed;
+		}
+
+		return Constraint::Eval::NA;
+	}
+	bool OpConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		const Domain& dom0 = a.current_domains[v0];
+		const Domain& dom1 = a.current_domains[v1];
+
+		switch (op)
+		{
+		case Op::Equal:
+			// Bounds of each var are shifted bounds of the other one, until one of them is fixed
+			if (dom1.IsFixed())
+			{
+				return a.IntersectVar(v0, (long long)dom1.Min() + offset);
+			}
+			if (dom0.IsFixed())
+			{
+				return a.IntersectVar(v1, (long long)dom0.Min() - offset);
+			}
+			return	a.ExcludeVarInf(v0, (long long)dom1.Min() + offset) &&
+					a.ExcludeVarSup(v0, (long long)dom1.Max() + offset + 1) &&
+					a.ExcludeVarInf(v1, (long long)dom0.Min() - offset) &&
+					a.ExcludeVarSup(v1, (long long)dom0.Max() - offset + 1);
+		case Op::NotEqual:
+			if (dom1.IsFixed())
+			{
+				return a.ExcludeVar(v0, (long long)dom1.Min() + offset);
+			}
+			if (dom0.IsFixed())
+			{
+				return a.ExcludeVar(v1, (long long)dom0.Min() - offset);
+			}
+			return true;
+		case Op::SupEqual:
+			return	a.ExcludeVarInf(v0, (long long)dom1.Min() + offset) &&
+					a.ExcludeVarSup(v1, (long long)dom0.Max() - offset + 1);
+		case Op::Sup:
+			return	a.ExcludeVarInf(v0, (long long)dom1.Min() + offset + 1) &&
+					a.ExcludeVarSup(v1, (long long)dom0.Max() - offset);
+		case Op::InfEqual:
+			return	a.ExcludeVarSup(v0, (long long)dom1.Max() + offset + 1) &&
+					a.ExcludeVarInf(v1, (long long)dom0.Min() - offset);
+		case Op::Inf:
+			return	a.ExcludeVarSup(v0, (long long)dom1.Max() + offset) &&
+					a.ExcludeVarInf(v1, (long long)dom0.Min() - offset + 1);
+		};
+
+		return true;
+	}
+	int OpConstraint::GetWakeEvents() const
+	{
+		switch (op)
+		{
+		case Op::NotEqual:
+			return EVENT_FIXED;
+		default:
+			// Inequalities only depend on the bounds of the other var
+			return EVENT_BOUNDS;
+		};
+	}
+	void EqualityConstraint::LinkVars(Array<VarId>& linked_vars) const
+	{
+		DEQUAN_Array_PushBack(linked_vars, v0);
+		DEQUAN_Array_PushBack(linked_vars, v1);
+	}
+	Constraint::Eval EqualityConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		if (inst_vars[v0].value != InstVar::UNASSIGNED &&
+			inst_vars[v1].value != InstVar::UNASSIGNED)
+		{
+			return inst_vars[v0].value == inst_vars[v1].value ? Constraint::Eval::Passed : Constraint::Eval::Failed;
+		}
+
+		return Constraint::Eval::NA;
+	}
+	bool EqualityConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		const Domain& dom0 = a.current_domains[v0];
+		const Domain& dom1 = a.current_domains[v1];
+
+		if (dom1.IsFixed())
+		{
+			return a.IntersectVar(v0, dom1.Min());
+		}
+		if (dom0.IsFixed())
+		{
+			return a.IntersectVar(v1, dom0.Min());
+		}
+		return	a.ExcludeVarInf(v0, dom1.Min()) && a.ExcludeVarSup(v0, (long long)dom1.Max() + 1) &&
+				a.ExcludeVarInf(v1, dom0.Min()) && a.ExcludeVarSup(v1, (long long)dom0.Max() + 1);
+	}
+	int EqualityConstraint::GetWakeEvents() const
+	{
+		return EVENT_BOUNDS;
+	}
+	void OrEqualityConstraint::LinkVars(Array<VarId>& linked_vars) const
+	{
+		DEQUAN_Array_PushBack(linked_vars, v0);
+		DEQUAN_Array_PushBack(linked_vars, v1);
+		DEQUAN_Array_PushBack(linked_vars, v2);
+	}
+	Constraint::Eval OrEqualityConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		if (inst_vars[v0].value != InstVar::UNASSIGNED &&
+			inst_vars[v1].value != InstVar::UNASSIGNED &&
+			inst_vars[v2].value != InstVar::UNASSIGNED)
+		{
+			return	(inst_vars[v0].value == inst_vars[v1].value ||
+					inst_vars[v0].value == inst_vars[v2].value) ? Constraint::Eval::Passed : Constraint::Eval::Failed;
+		}
+
+		return Constraint::Eval::NA;
+	}
+	bool OrEqualityConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		const Domain& dom0 = a.current_domains[v0];
+		const Domain& dom1 = a.current_domains[v1];
+		const Domain& dom2 = a.current_domains[v2];
+
+		// v0 can only take one of the values of v1 and v2 once they are fixed
+		if (dom1.IsFixed() && dom2.IsFixed() && !dom0.IsFixed())
+		{
+			Domain& dom = a.current_domains[v0];
+			a.EnsureSavedDomain(v0, dom);
+			dom.Intersect(dom1.Min(), dom2.Min());
+			if (dom.IsEmpty())
+			{
+				// Domain wipe out
+				return false;
+			}
+		}
+		// Once v0 is fixed, if one of v1 or v2 can't take its value, the other one must take it
+		if (dom0.IsFixed())
+		{
+			int val = dom0.Min();
+			if (!dom1.Contains(val))
+			{
+				return a.IntersectVar(v2, val);
+			}
+			if (!dom2.Contains(val))
+			{
+				return a.IntersectVar(v1, val);
+			}
+		}
+
+		return true;
+	}
+	int OrEqualityConstraint::GetWakeEvents() const
+	{
+		return EVENT_DOMAIN;
+	}
+	void CombinedEqualityConstraint::LinkVars(Array<VarId>& linked_vars) const
+	{
+		DEQUAN_Array_PushBack(linked_vars, v0);
+		DEQUAN_Array_PushBack(linked_vars, v1);
+		DEQUAN_Array_PushBack(linked_vars, v2);
+		DEQUAN_Array_PushBack(linked_vars, v3);
+	}
+	Constraint::Eval CombinedEqualityConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		if (inst_vars[v0].value != InstVar::UNASSIGNED &&
+			inst_vars[v1].value != InstVar::UNASSIGNED &&
+			inst_vars[v2].value != InstVar::UNASSIGNED &&
+			inst_vars[v3].value != InstVar::UNASSIGNED)
+		{
+			return	(inst_vars[v0].value == inst_vars[v1].value + inst_vars[v2].value - inst_vars[v3].value) ?
+				Constraint::Eval::Passed : Constraint::Eval::Failed;
+		}
+
+		return Constraint::Eval::NA;
+	}
+	bool CombinedEqualityConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		const Domain& dom0 = a.current_domains[v0];
+		const Domain& dom1 = a.current_domains[v1];
+		const Domain& dom2 = a.current_domains[v2];
+		const Domain& dom3 = a.current_domains[v3];
+
+		// Bounds propagation of v0 == v1 + v2 - v3, each var is bounded by the bounds of the 3 others
+		long long min0 = dom0.Min(), max0 = dom0.Max(), min1 = dom1.Min(), max1 = dom1.Max();
+		long long min2 = dom2.Min(), max2 = dom2.Max(), min3 = dom3.Min(), max3 = dom3.Max();
+		return	a.ExcludeVarInf(v0, min1 + min2 - max3) && a.ExcludeVarSup(v0, max1 + max2 - min3 + 1) &&
+				a.ExcludeVarInf(v1, min0 - max2 + min3) && a.ExcludeVarSup(v1, max0 - min2 + max3 + 1) &&
+				a.ExcludeVarInf(v2, min0 - max1 + min3) && a.ExcludeVarSup(v2, max0 - min1 + max3 + 1) &&
+				a.ExcludeVarInf(v3, min1 + min2 - max0) && a.ExcludeVarSup(v3, max1 + max2 - min0 + 1);
+	}
+	int CombinedEqualityConstraint::GetWakeEvents() const
+	{
+		return EVENT_BOUNDS;
+	}
+	void OrRangeConstraint::LinkVars(Array<VarId>& linked_vars) const
+	{
+		DEQUAN_Array_PushBack(linked_vars, v0);
+		DEQUAN_Array_PushBack(linked_vars, v1);
+	}
+	Constraint::Eval OrRangeConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		if (inst_vars[v0].value != InstVar::UNASSIGNED &&
+			inst_vars[v1].value != InstVar::UNASSIGNED)
+		{
+			return	(inst_vars[v0].value >= min && inst_vars[v0].value < max) ||
+					(inst_vars[v1].value >= min && inst_vars[v1].value < max) ? Constraint::Eval::Passed : Constraint::Eval::Failed;
+		}
+
+		return Constraint::Eval::NA;
+	}
+	bool OrRangeConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		auto HasValueInRange = [this](const Domain& dom) -> bool
+		{
+			int val = 0;
+			return dom.NextValue(min - 1, val) && val < max;
+		};
+
+		// Only restrict v0 domain if v1 can't take any value in the range, and conversely
+		const Domain& dom0 = a.current_domains[v0];
+		const Domain& dom1 = a.current_domains[v1];
+		if (!HasValueInRange(dom1))
+		{
+			return a.ExcludeVarInf(v0, min) && a.ExcludeVarSup(v0, max);
+		}
+		if (!HasValueInRange(dom0))
+		{
+			return a.ExcludeVarInf(v1, min) && a.ExcludeVarSup(v1, max);
+		}
+
+		return true;
+	}
+	int OrRangeConstraint::GetWakeEvents() const
+	{
+		return EVENT_DOMAIN;
+	}
+	void AllDifferentConstraint::LinkVars(Array<VarId>& linked_vars) const
+	{
+		for (int v_idx = 0; v_idx < alldiff_vars.Size(); v_idx++)
+		{
+			DEQUAN_Array_PushBack(linked_vars, alldiff_vars[v_idx]);
+		}
+	}
+	Constraint::Eval AllDifferentConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		int var_val = inst_vars[last_assigned_vid].value;
+		for (int v_idx = 0; v_idx < alldiff_vars.Size(); v_idx++)
+		{
+			if (inst_vars[alldiff_vars[v_idx]].value == var_val && v_idx != last_assigned_pos)
+			{
+				return Constraint::Eval::Failed;
+			}
+		}
+
+		return Constraint::Eval::Passed;
+	}
+	void AllDifferentConstraint::OnVarAssigned(Assignment& a, VarId vid, int var_pos)
+	{
+		// Counters layout: value min and span of the initial domains, then the number of vars assigned to each value.
+		// Span is 0 if the values are too spread out, Evaluate() is used in that case.
+		Array<int>& counters = a.GetConstraintCounters(con_id);
+		if (DEQUAN_Array_Size(counters) == 0)
+		{
+			long long val_min = LLONG_MAX, val_max = LLONG_MIN;
+			for (int v_idx = 0; v_idx < alldiff_vars.Size(); v_idx++)
+			{
+				const Domain& dom = a.csp->domains[alldiff_vars[v_idx]];
+				if (!dom.IsEmpty())
+				{
+					val_min = dom.Min() < val_min ? dom.Min() : val_min;
+					val_max = dom.Max() > val_max ? dom.Max() : val_max;
+				}
+			}
+			long long span = val_max >= val_min ? val_max - val_min + 1 : 0;
+			span = span > DOMAIN_FILTERING_MAX_SPAN ? 0 : span;
+			DEQUAN_Array_Resize(counters, 2 + (int)span);
+			counters[0] = span > 0 ? (int)val_min : 0;
+			counters[1] = (int)span;
+		}
+		long long val_idx = (long long)a.inst_vars[vid].value - counters[0];
+		if (val_idx >= 0 && val_idx < counters[1])
+		{
+			counters[2 + val_idx]++;
+		}
+	}
+	void AllDifferentConstraint::OnVarUnassigned(Assignment& a, VarId vid, int var_pos)
+	{
+		Array<int>& counters = a.GetConstraintCounters(con_id);
+		long long val_idx = (long long)a.inst_vars[vid].value - counters[0];
+		if (val_idx >= 0 && val_idx < counters[1])
+		{
+			counters[2 + val_idx]--;
+		}
+	}
+	Constraint::Eval AllDifferentConstraint::EvaluateTracked(Assignment& a, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		const Array<int>& counters = a.GetConstraintCounters(con_id);
+		long long val_idx = (long long)a.inst_vars[last_assigned_vid].value - counters[0];
+		if (val_idx < 0 || val_idx >= counters[1])
+		{
+			return Evaluate(a.inst_vars, last_assigned_vid, last_assigned_pos);
+		}
+		return counters[2 + val_idx] > 1 ? Constraint::Eval::Failed : Constraint::Eval::Passed;
+	}
+	bool AllDifferentConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		switch (filtering)
+		{
+		case Filtering::Bounds:
+			return ApplyBoundsFiltering(a);
+		case Filtering::Domain:
+			return ApplyDomainFiltering(a);
+		default:
+			return ApplyValueFiltering(a);
+		};
+	}
+	int AllDifferentConstraint::GetWakeEvents() const
+	{
+		switch (filtering)
+		{
+		case Filtering::Bounds:
+			return EVENT_BOUNDS;
+		case Filtering::Domain:
+			return EVENT_DOMAIN;
+		default:
+			return EVENT_FIXED;
+		};
+	}
+	bool AllDifferentConstraint::ApplyValueFiltering(Assignment& a)
+	{
+		// Remove the value of each fixed var from the domains of the other vars, until no more var gets fixed
+		bool new_fixed_var = true;
+		while (new_fixed_var)
+		{
+			new_fixed_var = false;
+			for (int v_idx = 0; v_idx < alldiff_vars.Size(); v_idx++)
+			{
+				const Domain& fixed_dom = a.current_domains[alldiff_vars[v_idx]];
+				if (!fixed_dom.IsFixed())
+				{
+					continue;
+				}
+				int val = fixed_dom.Min();
+				for (int oth_idx = 0; oth_idx < alldiff_vars.Size(); oth_idx++)
+				{
+					int vid = alldiff_vars[oth_idx];
+					Domain& dom = a.current_domains[vid];
+					if (oth_idx == v_idx || !dom.Contains(val))
+					{
+						continue;
+					}
+					if (!a.ExcludeVar(vid, val))
+					{
+						// Domain wipe out
+						return false;
+					}
+					new_fixed_var |= dom.IsFixed();
+				}
+			}
+		}
+
+		return true;
+	}
+	bool AllDifferentConstraint::ApplyBoundsFiltering(Assignment& a, int state_offset)
+	{
+		const int var_count = (int)alldiff_vars.Size();
+		// Var indices sorted by max, kept between calls since the order changes little from one node to the other
+		Array<int>& state = a.GetConstraintState(con_id);
+		if (DEQUAN_Array_Size(state) != state_offset + var_count)
+		{
+			DEQUAN_Array_Resize(state, state_offset + var_count);
+			for (int v_idx = 0; v_idx < var_count; v_idx++)
+			{
+				state[state_offset + v_idx] = v_idx;
+			}
+		}
+		int* order = &state[state_offset];
+		auto DomMin = [this, &a](int v_idx) -> long long { return a.current_domains[alldiff_vars[v_idx]].Min(); };
+		auto DomMax = [this, &a](int v_idx) -> long long { return a.current_domains[alldiff_vars[v_idx]].Max(); };
+
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			for (int o_idx = 1; o_idx < var_count; o_idx++)
+			{
+				int v_idx = order[o_idx];
+				long long max = DomMax(v_idx);
+				int ins_idx = o_idx;
+				for (; ins_idx > 0 && DomMax(order[ins_idx - 1]) > max; ins_idx--)
+				{
+					order[ins_idx] = order[ins_idx - 1];
+				}
+				order[ins_idx] = v_idx;
+			}
+
+			// For each lower bound lo, count the vars whose domain is in [lo, hi] for increasing hi:
+			// more vars than values is a failure, as many vars as values is a Hall interval that other vars can't use.
+			// Bounds read from the order are only valid until a domain changes, the pass is restarted after each change.
+			for (int lo_idx = 0; lo_idx < var_count && !changed; lo_idx++)
+			{
+				long long lo = DomMin(lo_idx);
+				long long count = 0;
+				for (int o_idx = 0; o_idx < var_count && !changed; o_idx++)
+				{
+					int v_idx = order[o_idx];
+					if (DomMin(v_idx) < lo)
+					{
+						continue;
+					}
+					long long hi = DomMax(v_idx);
+					count++;
+					if (count > hi - lo + 1)
+					{
+						return false;
+					}
+					if (count < hi - lo + 1)
+					{
+						continue;
+					}
+					for (int oth_idx = 0; oth_idx < var_count; oth_idx++)
+					{
+						long long oth_min = DomMin(oth_idx);
+						long long oth_max = DomMax(oth_idx);
+						// Vars inside the interval, outside of it or spanning over it keep their bounds
+						if ((oth_min >= lo) == (oth_max <= hi) || oth_max < lo || oth_min > hi)
+						{
+							continue;
+						}
+						VarId vid = alldiff_vars[oth_idx];
+						if ((oth_min >= lo && !a.ExcludeVarInf(vid, hi + 1)) || (oth_max <= hi && !a.ExcludeVarSup(vid, lo)))
+						{
+							// Domain wipe out
+							return false;
+						}
+						changed = true;
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+	bool AllDifferentConstraint::ApplyDomainFiltering(Assignment& a)
+	{
+		const int var_count = (int)alldiff_vars.Size();
+
+		// State layout: value min and span of the initial domains, matching of vars and values, then working memory
+		Array<int>& state = a.GetConstraintState(con_id);
+		if (DEQUAN_Array_Size(state) == 0)
+		{
+			long long val_min = LLONG_MAX, val_max = LLONG_MIN;
+			for (int v_idx = 0; v_idx < var_count; v_idx++)
+			{
+				const Domain& dom = a.csp->domains[alldiff_vars[v_idx]];
+				if (!dom.IsEmpty())
+				{
+					val_min = dom.Min() < val_min ? dom.Min() : val_min;
+					val_max = dom.Max() > val_max ? dom.Max() : val_max;
+				}
+			}
+			long long span = val_max >= val_min ? val_max - val_min + 1 : 0;
+			if (span == 0 || span > DOMAIN_FILTERING_MAX_SPAN)
+			{
+				DEQUAN_Array_PushBack(state, 0);
+				DEQUAN_Array_PushBack(state, 0);
+			}
+			else
+			{
+				int node_count = var_count + (int)span + 1;
+				DEQUAN_Array_Resize(state, 2 + 2 * var_count + 4 * (int)span + 7 * node_count);
+				state[0] = (int)val_min;
+				state[1] = (int)span;
+				for (int s_idx = 2; s_idx < 2 + var_count + (int)span; s_idx++)
+				{
+					state[s_idx] = -1;
+				}
+			}
+		}
+		const int val_min = state[0];
+		const int span = state[1];
+		if (span == 0)
+		{
+			// Bounds filtering state comes after the header
+			return ApplyBoundsFiltering(a, 2);
+		}
+		const int node_count = var_count + span + 1;
+		int* var_match = &state[2];						// matched value index of each var, or -1
+		int* val_match = var_match + var_count;			// matched var of each value index, or -1
+		int* bfs_vars = val_match + span;				// augmenting path search
+		int* val_parents = bfs_vars + var_count;
+		int* seen_vals = val_parents + span;
+		int* val_seen = seen_vals + span;
+		int* node_index = val_seen + span;				// Tarjan SCC
+		int* node_low = node_index + node_count;
+		int* node_comp = node_low + node_count;
+		int* scc_stack = node_comp + node_count;
+		int* call_nodes = scc_stack + node_count;
+		int* call_iters = call_nodes + node_count;
+		int* node_on_stack = call_iters + node_count;
+
+		// Repair the matching of the previous call: drop pairs whose value has been removed
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			int val_idx = var_match[v_idx];
+			if (val_idx >= 0 && !a.current_domains[alldiff_vars[v_idx]].Contains(val_min + val_idx))
+			{
+				val_match[val_idx] = -1;
+				var_match[v_idx] = -1;
+			}
+		}
+		for (int val_idx = 0; val_idx < span; val_idx++)
+		{
+			val_seen[val_idx] = 0;
+		}
+		// Match the remaining vars with augmenting paths, found with a breadth first search from the free var
+		for (int free_idx = 0; free_idx < var_count; free_idx++)
+		{
+			if (var_match[free_idx] >= 0)
+			{
+				continue;
+			}
+			int bfs_head = 0, bfs_count = 0, seen_count = 0;
+			int found_val_idx = -1;
+			bfs_vars[bfs_count++] = free_idx;
+			while (bfs_head < bfs_count && found_val_idx < 0)
+			{
+				int v_idx = bfs_vars[bfs_head++];
+				const Domain& dom = a.current_domains[alldiff_vars[v_idx]];
+				int val = dom.Min();
+				for (bool has_val = true; has_val; has_val = dom.NextValue(val, val))
+				{
+					int val_idx = val - val_min;
+					if (val_seen[val_idx])
+					{
+						continue;
+					}
+					val_seen[val_idx] = 1;
+					seen_vals[seen_count++] = val_idx;
+					val_parents[val_idx] = v_idx;
+					if (val_match[val_idx] < 0)
+					{
+						found_val_idx = val_idx;
+						break;
+					}
+					bfs_vars[bfs_count++] = val_match[val_idx];
+				}
+			}
+			for (int s_idx = 0; s_idx < seen_count; s_idx++)
+			{
+				val_seen[seen_vals[s_idx]] = 0;
+			}
+			if (found_val_idx < 0)
+			{
+				// Fewer values than vars
+				return false;
+			}
+			// Flip the matched and unmatched edges along the path
+			for (int val_idx = found_val_idx; val_idx >= 0;)
+			{
+				int v_idx = val_parents[val_idx];
+				int prev_val_idx = var_match[v_idx];
+				var_match[v_idx] = val_idx;
+				val_match[val_idx] = v_idx;
+				val_idx = prev_val_idx;
+			}
+		}
+
+		// Strongly connected components of the graph where matched edges go from value to var and other edges from var to value.
+		// Free values are linked to a sink node which links to every value, so that even alternating paths from free values are cycles.
+		// An edge not matched and not in a SCC can't be part of any maximum matching, its value is removed from the var domain.
+		const int sink_node = var_count + span;
+		for (int n_idx = 0; n_idx < node_count; n_idx++)
+		{
+			node_index[n_idx] = -1;
+			node_on_stack[n_idx] = 0;
+		}
+		int next_index = 0, scc_count = 0, comp_count = 0;
+		for (int root_node = 0; root_node < node_count; root_node++)
+		{
+			if (node_index[root_node] >= 0)
+			{
+				continue;
+			}
+			int call_count = 0;
+			call_nodes[call_count] = root_node;
+			call_iters[call_count++] = -1;
+			node_index[root_node] = node_low[root_node] = next_index++;
+			scc_stack[scc_count++] = root_node;
+			node_on_stack[root_node] = 1;
+			while (call_count > 0)
+			{
+				int node = call_nodes[call_count - 1];
+				int& iter = call_iters[call_count - 1];
+				// Next successor of the node, -1 if none
+				int succ = -1;
+				if (node < var_count)
+				{
+					const Domain& dom = a.current_domains[alldiff_vars[node]];
+					int val = dom.Min();
+					bool has_val = iter < 0 || dom.NextValue(val_min + iter, val);
+					if (has_val && val - val_min == var_match[node])
+					{
+						has_val = dom.NextValue(val, val);
+					}
+					if (has_val)
+					{
+						iter = val - val_min;
+						succ = var_count + iter;
+					}
+				}
+				else if (node < sink_node)
+				{
+					if (iter < 0)
+					{
+						iter = 0;
+						int val_idx = node - var_count;
+						succ = val_match[val_idx] >= 0 ? val_match[val_idx] : sink_node;
+					}
+				}
+				else if (iter + 1 < span)
+				{
+					iter++;
+					succ = var_count + iter;
+				}
+
+				if (succ >= 0)
+				{
+					if (node_index[succ] < 0)
+					{
+						call_nodes[call_count] = succ;
+						call_iters[call_count++] = -1;
+						node_index[succ] = node_low[succ] = next_index++;
+						scc_stack[scc_count++] = succ;
+						node_on_stack[succ] = 1;
+					}
+					else if (node_on_stack[succ] && node_index[succ] < node_low[node])
+					{
+						node_low[node] = node_index[succ];
+					}
+					continue;
+				}
+
+				// All successors visited, pop the node and its component if it is a root
+				call_count--;
+				if (call_count > 0 && node_low[node] < node_low[call_nodes[call_count - 1]])
+				{
+					node_low[call_nodes[call_count - 1]] = node_low[node];
+				}
+				if (node_low[node] == node_index[node])
+				{
+					int comp_node = -1;
+					do
+					{
+						comp_node = scc_stack[--scc_count];
+						node_on_stack[comp_node] = 0;
+						node_comp[comp_node] = comp_count;
+					} while (comp_node != node);
+					comp_count++;
+				}
+			}
+		}
+
+		for (int v_idx = 0; v_idx < var_count; v_idx++)
+		{
+			VarId vid = alldiff_vars[v_idx];
+			const Domain& dom = a.current_domains[vid];
+			int val = dom.Min();
+			for (bool has_val = true; has_val; has_val = dom.NextValue(val, val))
+			{
+				int val_idx = val - val_min;
+				if (val_idx != var_match[v_idx] && node_comp[v_idx] != node_comp[var_count + val_idx])
+				{
+					// The matched value stays in the domain, this can't wipe it out
+					a.ExcludeVar(vid, val);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	LinearConstraint::LinearConstraint(const Array<VarId>& vars, const Array<int>& _coefs, OpConstraint::Op _op, int _rhs)
+		: Constraint(ConstraintKind::Linear), linear_vars(vars), coefs(_coefs), op(_op), rhs(_rhs)
+	{
+		if (op == OpConstraint::Op::Sup)
+		{
+			op = OpConstraint::Op::SupEqual;
+			rhs++;
+		}
+		else if (op == OpConstraint::Op::Inf)
+		{
+			op = OpConstraint::Op::InfEqual;
+			rhs--;
+		}
+	}
+	void LinearConstraint::LinkVars(Array<VarId>& linked_vars) const
+	{
+		for (int v_idx = 0; v_idx < linear_vars.Size(); v_idx++)
+		{
+			DEQUAN_Array_PushBack(linked_vars, linear_vars[v_idx]);
+		}
+	}
+	Constraint::Eval LinearConstraint::EvaluateSum(long long sum) const
+	{
+		switch (op)
+		{
+		case OpConstraint::Op::Equal:
+			return sum == rhs ? Constraint::Eval::Passed : Constraint::Eval::Failed;
+		case OpConstraint::Op::NotEqual:
+			return sum != rhs ? Constraint::Eval::Passed : Constraint::Eval::Failed;
+		case OpConstraint::Op::SupEqual:
+			return sum >= rhs ? Constraint::Eval::Passed : Constraint::Eval::Failed;
+		default:
+			return sum <= rhs ? Constraint::Eval::Passed : Constraint::Eval::Failed;
+		};
+	}
+	Constraint::Eval LinearConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		long long sum = 0;
+		for (int v_idx = 0; v_idx < linear_vars.Size(); v_idx++)
+		{
+			int val = inst_vars[linear_vars[v_idx]].value;
+			if (val == InstVar::UNASSIGNED)
+			{
+				return Constraint::Eval::NA;
+			}
+			sum += (long long)coefs[v_idx] * val;
+		}
+		return EvaluateSum(sum);
+	}
+	/** Linear counters layout: number of assigned terms, then the sum of the assigned terms as low and high 32 bits */
+	static long long GetCountersSum(const Array<int>& counters)
+	{
+		return (long long)(((unsigned long long)(unsigned int)counters[2] << 32) | (unsigned int)counters[1]);
+	}
+	static void SetCountersSum(Array<int>& counters, long long sum)
 	{
-		GenericConstraint gen_con;
-		new(gen_con.get()) T(con);
-		DEQUAN_Array_PushBack(constraints, std::move(gen_con));
+		counters[1] = (int)(unsigned int)((unsigned long long)sum & 0xffffffffull);
+		counters[2] = (int)(unsigned int)((unsigned long long)sum >> 32);
 	}
-	void CSP::FinalizeModel()
+	void LinearConstraint::OnVarAssigned(Assignment& a, VarId vid, int var_pos)
 	{
-		// Once we know that the constraints array won't change (and won't be reallocated),
-		// we can link the constraint adresses with the variables.
-		for (int c_idx = 0; c_idx < DEQUAN_Array_Size(constraints); c_idx++)
+		Array<int>& counters = a.GetConstraintCounters(con_id);
+		if (DEQUAN_Array_Size(counters) == 0)
 		{
-			constraints[c_idx]->LinkVars(vars);
+			DEQUAN_Array_Resize(counters, 3);
 		}
+		counters[0]++;
+		SetCountersSum(counters, GetCountersSum(counters) + (long long)coefs[var_pos] * a.inst_vars[vid].value);
 	}
-
-	bool CSP::ForwardCheckingStep(Assignment& a) const
+	void LinearConstraint::OnVarUnassigned(Assignment& a, VarId vid, int var_pos)
 	{
-		if (a.IsComplete())
+		Array<int>& counters = a.GetConstraintCounters(con_id);
+		counters[0]--;
+		SetCountersSum(counters, GetCountersSum(counters) - (long long)coefs[var_pos] * a.inst_vars[vid].value);
+	}
+	Constraint::Eval LinearConstraint::EvaluateTracked(Assignment& a, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		const Array<int>& counters = a.GetConstraintCounters(con_id);
+		if (counters[0] < linear_vars.Size())
 		{
-			return true;
+			return Constraint::Eval::NA;
 		}
+		return EvaluateSum(GetCountersSum(counters));
+	}
+	/** Integer divisions rounded towards -infinity and +infinity */
+	static long long FloorDiv(long long num, long long den)
+	{
+		long long quot = num / den;
+		return (quot * den != num && ((num < 0) != (den < 0))) ? quot - 1 : quot;
+	}
+	static long long CeilDiv(long long num, long long den)
+	{
+		long long quot = num / den;
+		return (quot * den != num && ((num < 0) == (den < 0))) ? quot + 1 : quot;
+	}
+	bool LinearConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		const int term_count = (int)linear_vars.Size();
+		auto TermMin = [this, &a](int t_idx) -> long long
+		{
+			const Domain& dom = a.current_domains[linear_vars[t_idx]];
+			return coefs[t_idx] >= 0 ? (long long)coefs[t_idx] * dom.Min() : (long long)coefs[t_idx] * dom.Max();
+		};
+		auto TermMax = [this, &a](int t_idx) -> long long
+		{
+			const Domain& dom = a.current_domains[linear_vars[t_idx]];
+			return coefs[t_idx] >= 0 ? (long long)coefs[t_idx] * dom.Max() : (long long)coefs[t_idx] * dom.Min();
+		};
 
-		// Add a new saved domain step
-		DEQUAN_Array_PushBack(a.saved_domains, std::move(SavedDomains()));
-
-		VarId vid = a.NextUnassignedVar();
-		const Domain& dom = a.GetCurrentDomain(vid);
-		const Var& var = vars[vid];
-
-		auto LambdaStep = [this, &a, &var](int val)->bool
+		if (op == OpConstraint::Op::NotEqual)
 		{
-			a.AssignVar(var.var_id, val);
-			if (a.ValidateVarConstraints(var))
+			// Only a single unfixed term can be filtered, by removing the value that makes the sum equal to rhs
+			long long fixed_sum = 0;
+			int unfixed_idx = -1;
+			for (int t_idx = 0; t_idx < term_count; t_idx++)
 			{
-				bool success = true;
-				for (int c_idx = 0; success && c_idx < DEQUAN_Array_Size(var.linked_constraints); c_idx++)
-				{
-					// Restrict domain of other variables, by removing values that would violate linked constraints
-					success &= var.linked_constraints[c_idx]->AplyArcConsistency(a, var.var_id);
-				}
-				if (success)
-				{
-					// This instanced variable did not violate any constraints, recurse and continue with next variable
-					success = ForwardCheckingStep(a);
-				}
-				if (success)
+				if (coefs[t_idx] != 0 && !a.current_domains[linear_vars[t_idx]].IsFixed())
 				{
-					return true;
-				}
-				else
-				{
-					a.UnAssignVar(var.var_id);
-					// Restore saved domains since they may have been modified by applied arc consistencies or sub-steps
-					a.RestoreSavedDomainStep();
+					if (unfixed_idx >= 0)
+					{
+						return true;
+					}
+					unfixed_idx = t_idx;
+					continue;
 				}
+				fixed_sum += coefs[t_idx] != 0 ? TermMin(t_idx) : 0;
 			}
-			else
+			if (unfixed_idx < 0)
+			{
+				return fixed_sum != rhs;
+			}
+			long long rest = rhs - fixed_sum;
+			if (rest % coefs[unfixed_idx] != 0)
 			{
-				a.UnAssignVar(var.var_id);
+				return true;
 			}
+			return a.ExcludeVar(linear_vars[unfixed_idx], rest / coefs[unfixed_idx]);
+		}
 
+		long long sum_min = 0, sum_max = 0;
+		for (int t_idx = 0; t_idx < term_count; t_idx++)
+		{
+			sum_min += TermMin(t_idx);
+			sum_max += TermMax(t_idx);
+		}
+		const bool check_sup = op == OpConstraint::Op::Equal || op == OpConstraint::Op::InfEqual;
+		const bool check_inf = op == OpConstraint::Op::Equal || op == OpConstraint::Op::SupEqual;
+		if ((check_sup && sum_min > rhs) || (check_inf && sum_max < rhs))
+		{
 			return false;
-		};
+		}
 
-		bool found_result = false;
-		if (dom.type == DomainType::Values)
+		// Each term is bounded by rhs minus the extreme sums of the other terms.
+		// Sums are not updated while filtering: the bounds are looser but still valid, and the constraint is woken up again by its own changes.
+		for (int t_idx = 0; t_idx < term_count; t_idx++)
 		{
-			for (int d_idx = 0; d_idx < DEQUAN_Array_Size(dom.values) && !found_result; d_idx++)
+			long long coef = coefs[t_idx];
+			if (coef == 0)
 			{
-				int val = dom.values[d_idx];
-				found_result = LambdaStep(val);
+				continue;
 			}
-		}
-		else
-		{
-			for (int r_idx = 0; r_idx < DEQUAN_Array_Size(dom.values); r_idx += 2)
+			VarId vid = linear_vars[t_idx];
+			if (check_sup)
 			{
-				int min = dom.values[r_idx];
-				int max = dom.values[r_idx + 1];
-				for (int val = min; val < max && !found_result; val++)
+				// coef * x <= rhs - (sum_min - term_min)
+				long long term_sup = rhs - (sum_min - TermMin(t_idx));
+				if (coef > 0 ? !a.ExcludeVarSup(vid, FloorDiv(term_sup, coef) + 1) : !a.ExcludeVarInf(vid, CeilDiv(term_sup, coef)))
 				{
-					found_result = LambdaStep(val);
+					return false;
+				}
+			}
+			if (check_inf)
+			{
+				// coef * x >= rhs - (sum_max - term_max)
+				long long term_inf = rhs - (sum_max - TermMax(t_idx));
+				if (coef > 0 ? !a.ExcludeVarInf(vid, CeilDiv(term_inf, coef)) : !a.ExcludeVarSup(vid, FloorDiv(term_inf, coef) + 1))
+				{
+					return false;
 				}
 			}
-		}
-		if (found_result)
-		{
-			return true;
 		}
 
-		DEQUAN_Array_PopBack(a.saved_domains);
-		return false;
+		return true;
+	}
+	int LinearConstraint::GetWakeEvents() const
+	{
+		return op == OpConstraint::Op::NotEqual ? EVENT_FIXED : EVENT_BOUNDS;
 	}
 
-	bool Assignment::ValidateVarConstraints(const Var& var) /*const*/
+	TableConstraint::TableConstraint(const Array<VarId>& vars, const Array<int>& tuples) : Constraint(ConstraintKind::Table), table_vars(vars)
 	{
-		for (int c_idx = 0; c_idx < DEQUAN_Array_Size(var.linked_constraints); c_idx++)
+		const int arity = (int)table_vars.Size();
+		tuple_count = arity > 0 ? (int)DEQUAN_Array_Size(tuples) / arity : 0;
+		word_count = (tuple_count + 63) / 64;
+
+		// Sorted distinct values of each position
+		Array<int> pos_values;
+		value_offsets.Resize(arity + 1);
+		for (int p_idx = 0; p_idx < arity; p_idx++)
 		{
-#ifdef DEQUAN_WITH_STATS
-			stats.validated_constraints++;
-#endif
-			if (var.linked_constraints[c_idx]->Evaluate(inst_vars, var.var_id) == Constraint::Eval::Failed)
+			value_offsets.Set(p_idx, values.Size());
+			DEQUAN_Array_Clear(pos_values);
+			for (int t_idx = 0; t_idx < tuple_count; t_idx++)
 			{
-				return false;
+				DEQUAN_Array_PushBack(pos_values, tuples[t_idx * arity + p_idx]);
+			}
+			DEQUAN_Array_Sort(pos_values, [](const int& a, const int& b) -> bool { return a < b; });
+			for (int v_idx = 0; v_idx < DEQUAN_Array_Size(pos_values); v_idx++)
+			{
+				if (v_idx == 0 || pos_values[v_idx] != pos_values[v_idx - 1])
+				{
+					values.PushBack(pos_values[v_idx]);
+				}
 			}
 		}
+		value_offsets.Set(arity, values.Size());
 
-		return true;
+		supports.Resize(values.Size() * word_count);
+		unsigned long long* support_words = supports.Edit();
+		for (int w_idx = 0; w_idx < supports.Size(); w_idx++)
+		{
+			support_words[w_idx] = 0;
+		}
+		for (int t_idx = 0; t_idx < tuple_count; t_idx++)
+		{
+			for (int p_idx = 0; p_idx < arity; p_idx++)
+			{
+				int val_idx = FindValueIdx(p_idx, tuples[t_idx * arity + p_idx]);
+				support_words[val_idx * word_count + (t_idx >> 6)] |= 1ull << (t_idx & 63);
+			}
+		}
 	}
-	void OpConstraint::LinkVars(Array<Var>& vars)
+	void TableConstraint::LinkVars(Array<VarId>& linked_vars) const
 	{
-		DEQUAN_Array_PushBack(vars[v0].linked_constraints, this);
-		DEQUAN_Array_PushBack(vars[v1].linked_constraints, this);
+		for (int v_idx = 0; v_idx < table_vars.Size(); v_idx++)
+		{
+			DEQUAN_Array_PushBack(linked_vars, table_vars[v_idx]);
+		}
 	}
-	Constraint::Eval OpConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid)
+	int TableConstraint::FindValueIdx(int var_pos, int val) const
 	{
-		if (inst_vars[v0].value != InstVar::UNASSIGNED &&
-			inst_vars[v1].value != InstVar::UNASSIGNED)
+		int lo = value_offsets[var_pos], hi = value_offsets[var_pos + 1];
+		while (lo < hi)
 		{
-			switch (op)
+			int mid = (lo + hi) >> 1;
+			if (values[mid] < val)
 			{
-			case Op::Equal:
-				if (inst_vars[v0].value == inst_vars[v1].value + offset)
-					return Constraint::Eval::Passed;
-				break;
-			case Op::NotEqual:
-				if (inst_vars[v0].value != inst_vars[v1].value + offset)
-					return Constraint::Eval::Passed;
-				break;
-			case Op::SupEqual:
-				if (inst_vars[v0].value >= inst_vars[v1].value + offset)
-					return Constraint::Eval::Passed;
-				break;
-			case Op::Sup:
-				if (inst_vars[v0].value > inst_vars[v1].value + offset)
-					return Constraint::Eval::Passed;
-				break;
-			case Op::InfEqual:
-				if (inst_vars[v0].value <= inst_vars[v1].value + offset)
-					return Constraint::Eval::Passed;
-				break;
-			case Op::Inf:
-				if (inst_vars[v0].value < inst_vars[v1].value + offset)
-					return Constraint::Eval::Passed;
-				break;
-			};
-
-			return Constraint::Eval::Failed;
+				lo = mid + 1;
+			}
+			else
+			{
+				hi = mid;
+			}
 		}
-
-		return Constraint::Eval::NA;
+		return lo < value_offsets[var_pos + 1] && values[lo] == val ? lo : -1;
 	}
-	bool OpConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid)
+	Constraint::Eval TableConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos)
 	{
-#ifdef DEQUAN_WITH_STATS
-		a.stats.applied_arcs++;
-#endif
-		auto DoCheck = [&a](VarId v0, int v0_val, int oth_val, Op op)->bool
+		const int arity = (int)table_vars.Size();
+		for (int p_idx = 0; p_idx < arity; p_idx++)
 		{
-			Domain& dom = a.current_domains[v0];
-			a.EnsureSavedDomain(v0, dom);
-
-			switch (op)
+			int val = inst_vars[table_vars[p_idx]].value;
+			if (val == InstVar::UNASSIGNED)
 			{
-			case Op::Equal:
-				dom.Intersect(oth_val);
-				break;
-			case Op::NotEqual:
-				dom.Exclude(oth_val);
-				break;
-			case Op::SupEqual:
-				dom.ExcludeInf(oth_val);
-				break;
-			case Op::Sup:
-				dom.ExcludeInf(oth_val + 1);
-				break;
-			case Op::InfEqual:
-				dom.ExcludeSup(oth_val + 1);
-				break;
-			case Op::Inf:
-				dom.ExcludeSup(oth_val);
-				break;
-			};
-
-			if (DEQUAN_Array_Size(dom.values) == 0)
+				return Constraint::Eval::NA;
+			}
+			if (FindValueIdx(p_idx, val) < 0)
 			{
-				// Domain wipe out
-				return false;
+				return Constraint::Eval::Failed;
 			}
-			return true;
-		};
-
-		// there are only two vars, and one has just been assigned
-		int v0_val = a.inst_vars[v0].value;
-		int v1_val = a.inst_vars[v1].value;
-
-		if (v0_val == InstVar::UNASSIGNED)
-		{
-			return DoCheck(v0, v0_val, v1_val + offset, op);
 		}
-		if (v1_val == InstVar::UNASSIGNED)
+		// Look for a tuple shared by the supports of all the values
+		for (int w_idx = 0; w_idx < word_count; w_idx++)
 		{
-			Op op_rev = op;
-			switch (op)
+			unsigned long long word = ~0ull;
+			for (int p_idx = 0; p_idx < arity && word != 0; p_idx++)
 			{
-			case Op::SupEqual:	op_rev = Op::InfEqual; break;
-			case Op::Sup:		op_rev = Op::Inf; break;
-			case Op::InfEqual:	op_rev = Op::SupEqual; break;
-			case Op::Inf:		op_rev = Op::Sup; break;
-			default: break;
-			};
-			return DoCheck(v1, v1_val, v0_val - offset, op_rev);
+				word &= supports[FindValueIdx(p_idx, inst_vars[table_vars[p_idx]].value) * word_count + w_idx];
+			}
+			if (word != 0)
+			{
+				return Constraint::Eval::Passed;
+			}
 		}
-
-		return true;
+		return Constraint::Eval::Failed;
 	}
-	void EqualityConstraint::LinkVars(Array<Var>& vars)
+	/** 64-bit word stored as two ints at 'idx' in a constraint state */
+	static unsigned long long GetStateWord(const Array<int>& state, int idx)
 	{
-		DEQUAN_Array_PushBack(vars[v0].linked_constraints, this);
-		DEQUAN_Array_PushBack(vars[v1].linked_constraints, this);
+		return (unsigned long long)(unsigned int)state[idx] | ((unsigned long long)(unsigned int)state[idx + 1] << 32);
 	}
-	Constraint::Eval EqualityConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid)
+	bool TableConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos)
 	{
-		if (inst_vars[v0].value != InstVar::UNASSIGNED &&
-			inst_vars[v1].value != InstVar::UNASSIGNED)
+		if (tuple_count == 0)
 		{
-			return inst_vars[v0].value == inst_vars[v1].value ? Constraint::Eval::Passed : Constraint::Eval::Failed;
+			return false;
 		}
 
-		return Constraint::Eval::NA;
-	}
-	bool EqualityConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid)
-	{
-#ifdef DEQUAN_WITH_STATS
-		a.stats.applied_arcs++;
-#endif
-		auto DoCheck = [&a](VarId v0, int v0_val, int oth_val)->bool
+		// Trailed state: number of non-zero words of the valid tuples, domain size of each var when it was last accounted for, then the valid tuples.
+		// Untrailed state: the first 'limit' entries of the word permutation are the non-zero words, then the residue of each value, a word where it last had a valid tuple.
+		const int arity = (int)table_vars.Size();
+		const int words_offset = 1 + arity;
+		const int residues_offset = word_count;
+		Array<int>& trailed = a.GetConstraintTrailedState(con_id);
+		Array<int>& state = a.GetConstraintState(con_id);
+		if (DEQUAN_Array_Size(trailed) == 0)
 		{
-			Domain& dom = a.current_domains[v0];
-			a.EnsureSavedDomain(v0, dom);
+			DEQUAN_Array_Resize(trailed, words_offset + 2 * word_count);
+			trailed[0] = word_count;
+			for (int p_idx = 0; p_idx < arity; p_idx++)
+			{
+				trailed[1 + p_idx] = -1;
+			}
+			for (int w_idx = 0; w_idx < word_count; w_idx++)
+			{
+				unsigned long long word = (w_idx == word_count - 1 && (tuple_count & 63) != 0) ? (1ull << (tuple_count & 63)) - 1 : ~0ull;
+				trailed[words_offset + 2 * w_idx] = (int)(unsigned int)(word & 0xffffffffull);
+				trailed[words_offset + 2 * w_idx + 1] = (int)(unsigned int)(word >> 32);
+			}
+			DEQUAN_Array_Clear(state);
+			DEQUAN_Array_Resize(state, residues_offset + values.Size());
+			for (int w_idx = 0; w_idx < word_count; w_idx++)
+			{
+				state[w_idx] = w_idx;
+			}
+		}
+
+		// Remove the tuples that are no longer valid, for each var whose domain has changed since it was last accounted for
+		Array<unsigned long long>& mask = a.prop_scratch_words;
+		if (DEQUAN_Array_Size(mask) < word_count)
+		{
+			DEQUAN_Array_Resize(mask, word_count);
+		}
+		int limit = trailed[0];
+		int changed_count = 0, changed_pos = -1;
+		for (int p_idx = 0; p_idx < arity; p_idx++)
+		{
+			const Domain& dom = a.current_domains[table_vars[p_idx]];
+			int dom_size = dom.Size();
+			if (dom_size == trailed[1 + p_idx])
+			{
+				continue;
+			}
+			// Values of a var accounted for the first time may have no tuple at all, it must be filtered
+			changed_pos = trailed[1 + p_idx] >= 0 ? p_idx : -1;
+			changed_count++;
+			a.SetConstraintTrailedState(con_id, 1 + p_idx, dom_size);
 
-			dom.Intersect(oth_val);
-			if (DEQUAN_Array_Size(dom.values) == 0)
+			for (int i_idx = 0; i_idx < limit; i_idx++)
+			{
+				mask[state[i_idx]] = 0;
+			}
+			for (int val_idx = value_offsets[p_idx]; val_idx < value_offsets[p_idx + 1]; val_idx++)
+			{
+				if (!dom.Contains(values[val_idx]))
+				{
+					continue;
+				}
+				const unsigned long long* val_supports = &supports[val_idx * word_count];
+				for (int i_idx = 0; i_idx < limit; i_idx++)
+				{
+					int w_idx = state[i_idx];
+					mask[w_idx] |= val_supports[w_idx];
+				}
+			}
+			for (int i_idx = limit - 1; i_idx >= 0; i_idx--)
+			{
+				int w_idx = state[i_idx];
+				unsigned long long word = GetStateWord(trailed, words_offset + 2 * w_idx);
+				unsigned long long new_word = word & mask[w_idx];
+				if (new_word == word)
+				{
+					continue;
+				}
+				a.SetConstraintTrailedState(con_id, words_offset + 2 * w_idx, (int)(unsigned int)(new_word & 0xffffffffull));
+				a.SetConstraintTrailedState(con_id, words_offset + 2 * w_idx + 1, (int)(unsigned int)(new_word >> 32));
+				if (new_word == 0)
+				{
+					// Swap the word out of the non-zero words, restoring the limit on backtrack brings it back
+					limit--;
+					state[i_idx] = state[limit];
+					state[limit] = w_idx;
+				}
+			}
+			if (limit == 0)
 			{
-				// Domain wipe out
 				return false;
 			}
+		}
+		if (limit != trailed[0])
+		{
+			a.SetConstraintTrailedState(con_id, 0, limit);
+		}
+		if (changed_count == 0)
+		{
 			return true;
-		};
+		}
+
+		// Remove the values without any valid tuple left.
+		// A fixed var is always supported, and so are the values of a var if it was the only one to change.
+		Array<int>& supported_vals = a.prop_scratch_values;
+		for (int p_idx = 0; p_idx < arity; p_idx++)
+		{
+			VarId vid = table_vars[p_idx];
+			Domain& dom = a.current_domains[vid];
+			if ((changed_count == 1 && p_idx == changed_pos) || dom.IsFixed())
+			{
+				continue;
+			}
+
+			DEQUAN_Array_Clear(supported_vals);
+			for (int val_idx = value_offsets[p_idx]; val_idx < value_offsets[p_idx + 1]; val_idx++)
+			{
+				if (!dom.Contains(values[val_idx]))
+				{
+					continue;
+				}
+				const unsigned long long* val_supports = &supports[val_idx * word_count];
+				int& residue = state[residues_offset + val_idx];
+				bool is_supported = (GetStateWord(trailed, words_offset + 2 * residue) & val_supports[residue]) != 0;
+				for (int i_idx = 0; i_idx < limit && !is_supported; i_idx++)
+				{
+					int w_idx = state[i_idx];
+					if ((GetStateWord(trailed, words_offset + 2 * w_idx) & val_supports[w_idx]) != 0)
+					{
+						residue = w_idx;
+						is_supported = true;
+					}
+				}
+				if (is_supported)
+				{
+					DEQUAN_Array_PushBack(supported_vals, values[val_idx]);
+				}
+			}
 
-		// there are only two vars, and one has just been assigned
-		int v0_val = a.inst_vars[v0].value;
-		int v1_val = a.inst_vars[v1].value;
+			int supported_count = (int)DEQUAN_Array_Size(supported_vals);
+			if (supported_count < trailed[1 + p_idx])
+			{
+				if (supported_count == 0)
+				{
+					return false;
+				}
+				a.IntersectVarValues(vid, &supported_vals[0], supported_count);
+				// Removed values had no valid tuple, so the valid tuples are already up to date with the new domain
+				a.SetConstraintTrailedState(con_id, 1 + p_idx, supported_count);
+			}
+		}
+
+		return true;
+	}
 
-		if (v0_val == InstVar::UNASSIGNED)
+	void LexConstraint::LinkVars(Array<VarId>& linked_vars) const
+	{
+		for (int p_idx = 0; p_idx < vars0.Size(); p_idx++)
 		{
-			return DoCheck(v0, v0_val, v1_val);
+			DEQUAN_Array_PushBack(linked_vars, vars0[p_idx]);
 		}
-		if (v1_val == InstVar::UNASSIGNED)
+		for (int p_idx = 0; p_idx < vars1.Size(); p_idx++)
 		{
-			return DoCheck(v1, v1_val, v0_val);
+			DEQUAN_Array_PushBack(linked_vars, vars1[p_idx]);
 		}
-
-		return true;
 	}
-	void OrEqualityConstraint::LinkVars(Array<Var>& vars)
+	Constraint::Eval LexConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		for (int p_idx = 0; p_idx < vars0.Size(); p_idx++)
+		{
+			int val0 = inst_vars[vars0[p_idx]].value;
+			int val1 = inst_vars[vars1[p_idx]].value;
+			if (val0 == InstVar::UNASSIGNED || val1 == InstVar::UNASSIGNED)
+			{
+				return Constraint::Eval::NA;
+			}
+			long long image = (long long)coef * val1 + offset;
+			if (val0 != image)
+			{
+				return val0 < image ? Constraint::Eval::Passed : Constraint::Eval::Failed;
+			}
+		}
+		return strict ? Constraint::Eval::Failed : Constraint::Eval::Passed;
+	}
+	void LexConstraint::GetImageBounds(const Assignment& a, int pos, long long& image_min, long long& image_max) const
 	{
-		DEQUAN_Array_PushBack(vars[v0].linked_constraints, this);
-		DEQUAN_Array_PushBack(vars[v1].linked_constraints, this);
-		DEQUAN_Array_PushBack(vars[v2].linked_constraints, this);
+		const Domain& dom1 = a.current_domains[vars1[pos]];
+		image_min = coef > 0 ? (long long)dom1.Min() + offset : (long long)offset - dom1.Max();
+		image_max = coef > 0 ? (long long)dom1.Max() + offset : (long long)offset - dom1.Min();
 	}
-	Constraint::Eval OrEqualityConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid)
+	bool LexConstraint::CanSuffixHold(const Assignment& a, int pos) const
 	{
-		if (inst_vars[v0].value != InstVar::UNASSIGNED &&
-			inst_vars[v1].value != InstVar::UNASSIGNED &&
-			inst_vars[v2].value != InstVar::UNASSIGNED)
+		for (int p_idx = pos; p_idx < vars0.Size(); p_idx++)
 		{
-			return	(inst_vars[v0].value == inst_vars[v1].value ||
-					inst_vars[v0].value == inst_vars[v2].value) ? Constraint::Eval::Passed : Constraint::Eval::Failed;
+			long long image_min, image_max;
+			GetImageBounds(a, p_idx, image_min, image_max);
+			long long min0 = a.current_domains[vars0[p_idx]].Min();
+			if (min0 != image_max)
+			{
+				return min0 < image_max;
+			}
 		}
-
-		return Constraint::Eval::NA;
+		return !strict;
 	}
-	bool OrEqualityConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid)
+	bool LexConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid, int last_assigned_pos)
 	{
-#ifdef DEQUAN_WITH_STATS
-		a.stats.applied_arcs++;
-#endif
-		// there are three vars, we need two var assignments to apply arc consistency
-		int v0_val = a.inst_vars[v0].value;
-		int v1_val = a.inst_vars[v1].value;
-		int v2_val = a.inst_vars[v2].value;
-
-		if (v0_val == InstVar::UNASSIGNED && v1_val != InstVar::UNASSIGNED && v2_val != InstVar::UNASSIGNED)
+		// Positions before p_idx are equal in every solution, so vars0[p_idx] <= image of vars1[p_idx], strictly if the suffix cannot hold otherwise
+		const int size = (int)vars0.Size();
+		for (int p_idx = 0; p_idx < size; p_idx++)
 		{
-			Domain& dom = a.current_domains[v0];
-			a.EnsureSavedDomain(v0, dom);
+			VarId v0 = vars0[p_idx];
+			VarId v1 = vars1[p_idx];
+			if (v0 == v1 && coef == 1 && offset == 0)
+			{
+				continue;
+			}
+			long long gap = CanSuffixHold(a, p_idx + 1) ? 0 : 1;
+			long long image_min, image_max;
+			GetImageBounds(a, p_idx, image_min, image_max);
+			if (!a.ExcludeVarSup(v0, image_max - gap + 1))
+			{
+				return false;
+			}
+			long long min0 = (long long)a.current_domains[v0].Min() + gap;
+			if (!(coef > 0 ? a.ExcludeVarInf(v1, min0 - offset) : a.ExcludeVarSup(v1, offset - min0 + 1)))
+			{
+				return false;
+			}
 
-			dom.Intersect(v1_val, v2_val);
+			// Later positions only matter while this one can still be equal
+			const Domain& dom0 = a.current_domains[v0];
+			GetImageBounds(a, p_idx, image_min, image_max);
+			if (dom0.Max() < image_min || !dom0.IsFixed() || image_min != image_max || dom0.Min() != image_min)
+			{
+				return true;
+			}
+		}
+		return !strict;
+	}
 
-			if (DEQUAN_Array_Size(dom.values) == 0)
+	Constraint::Eval EvaluateConstraint(Constraint& con, Assignment& a, VarId last_assigned_vid, int last_assigned_pos)
+	{
+		const Array<InstVar>& inst_vars = a.inst_vars;
+		switch (con.kind)
+		{
+		case ConstraintKind::Op:				return static_cast<OpConstraint&>(con).OpConstraint::Evaluate(inst_vars, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::Equality:			return static_cast<EqualityConstraint&>(con).EqualityConstraint::Evaluate(inst_vars, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::OrEquality:		return static_cast<OrEqualityConstraint&>(con).OrEqualityConstraint::Evaluate(inst_vars, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::CombinedEquality:	return static_cast<CombinedEqualityConstraint&>(con).CombinedEqualityConstraint::Evaluate(inst_vars, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::OrRange:			return static_cast<OrRangeConstraint&>(con).OrRangeConstraint::Evaluate(inst_vars, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::AllDifferent:		return static_cast<AllDifferentConstraint&>(con).AllDifferentConstraint::EvaluateTracked(a, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::Linear:			return static_cast<LinearConstraint&>(con).LinearConstraint::EvaluateTracked(a, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::Table:				return static_cast<TableConstraint&>(con).TableConstraint::Evaluate(inst_vars, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::Lex:				return static_cast<LexConstraint&>(con).LexConstraint::Evaluate(inst_vars, last_assigned_vid, last_assigned_pos);
+		default:
+			if (a.csp->constraint_tracks_assignments[con.con_id])
 			{
-				// Domain wipe out
-				return false;
+				return con.EvaluateTracked(a, last_assigned_vid, last_assigned_pos);
 			}
+			return con.Evaluate(inst_vars, last_assigned_vid, last_assigned_pos);
 		}
-
-		return true;
 	}
-	void CombinedEqualityConstraint::LinkVars(Array<Var>& vars)
+	bool ApplyConstraintArcConsistency(Constraint& con, Assignment& a, VarId last_assigned_vid, int last_assigned_pos)
 	{
-		DEQUAN_Array_PushBack(vars[v0].linked_constraints, this);
-		DEQUAN_Array_PushBack(vars[v1].linked_constraints, this);
-		DEQUAN_Array_PushBack(vars[v2].linked_constraints, this);
-		DEQUAN_Array_PushBack(vars[v3].linked_constraints, this);
+		switch (con.kind)
+		{
+		case ConstraintKind::Op:				return static_cast<OpConstraint&>(con).OpConstraint::AplyArcConsistency(a, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::Equality:			return static_cast<EqualityConstraint&>(con).EqualityConstraint::AplyArcConsistency(a, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::OrEquality:		return static_cast<OrEqualityConstraint&>(con).OrEqualityConstraint::AplyArcConsistency(a, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::CombinedEquality:	return static_cast<CombinedEqualityConstraint&>(con).CombinedEqualityConstraint::AplyArcConsistency(a, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::OrRange:			return static_cast<OrRangeConstraint&>(con).OrRangeConstraint::AplyArcConsistency(a, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::AllDifferent:		return static_cast<AllDifferentConstraint&>(con).AllDifferentConstraint::AplyArcConsistency(a, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::Linear:			return static_cast<LinearConstraint&>(con).LinearConstraint::AplyArcConsistency(a, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::Table:				return static_cast<TableConstraint&>(con).TableConstraint::AplyArcConsistency(a, last_assigned_vid, last_assigned_pos);
+		case ConstraintKind::Lex:				return static_cast<LexConstraint&>(con).LexConstraint::AplyArcConsistency(a, last_assigned_vid, last_assigned_pos);
+		default:								return con.AplyArcConsistency(a, last_assigned_vid, last_assigned_pos);
+		}
 	}
-	Constraint::Eval CombinedEqualityConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid)
+
+	/** Mask of the bits of word 'w_idx' that are in bit range [bit_lo, bit_hi) */
+	static unsigned long long BitRangeMask(int w_idx, long long bit_lo, long long bit_hi)
 	{
-		if (inst_vars[v0].value != InstVar::UNASSIGNED &&
-			inst_vars[v1].value != InstVar::UNASSIGNED &&
-			inst_vars[v2].value != InstVar::UNASSIGNED &&
-			inst_vars[v3].value != InstVar::UNASSIGNED)
+		long long lo = bit_lo - w_idx * 64;
+		long long hi = bit_hi - w_idx * 64;
+		lo = lo > 0 ? lo : 0;
+		hi = hi < 64 ? hi : 64;
+		if (hi <= lo)
 		{
-			return	(inst_vars[v0].value == inst_vars[v1].value + inst_vars[v2].value - inst_vars[v3].value) ?
-				Constraint::Eval::Passed : Constraint::Eval::Failed;
+			return 0;
 		}
-
-		return Constraint::Eval::NA;
+		unsigned long long hi_mask = hi == 64 ? ~0ull : ((1ull << hi) - 1);
+		unsigned long long lo_mask = (1ull << lo) - 1;
+		return hi_mask & ~lo_mask;
 	}
-	bool CombinedEqualityConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid)
+	Domain Domain::MakeBitset(int min_val, int max_val)
 	{
-#ifdef DEQUAN_WITH_STATS
-		a.stats.applied_arcs++;
-#endif
-		// there are four vars, we need two var assignments to apply arc consistency
-		int v0_val = a.inst_vars[v0].value;
-		int v1_val = a.inst_vars[v1].value;
-		int v2_val = a.inst_vars[v2].value;
-		int v3_val = a.inst_vars[v2].value;
-
-		if (v0_val == InstVar::UNASSIGNED &&
-			v1_val != InstVar::UNASSIGNED &&
-			v2_val != InstVar::UNASSIGNED &&
-			v3_val != InstVar::UNASSIGNED)
+		Domain dom;
+		dom.type = DomainType::Bitset;
+		dom.bits_min = min_val;
+		dom.bits_words = (max_val - min_val + 63) / 64;
+		for (int w_idx = 0; w_idx < dom.bits_words; w_idx++)
 		{
-			Domain& dom = a.current_domains[v0];
-			a.EnsureSavedDomain(v0, dom);
-
-			int comb_val = v1_val + v2_val - v3_val;
-			dom.Intersect(comb_val);
-
-			if (DEQUAN_Array_Size(dom.values) == 0)
-			{
-				// Domain wipe out
-				return false;
-			}
+			dom.bits[w_idx] = BitRangeMask(w_idx, 0, (long long)max_val - min_val);
 		}
-
-		return true;
+		return dom;
 	}
-	void OrRangeConstraint::LinkVars(Array<Var>& vars)
+	int Domain::Size() const
 	{
-		DEQUAN_Array_PushBack(vars[v0].linked_constraints, this);
-		DEQUAN_Array_PushBack(vars[v1].linked_constraints, this);
+		if (type == DomainType::Values)
+		{
+			return (int)values.Size();
+		}
+		else if (type == DomainType::Bitset)
+		{
+			int size = 0;
+			for (int w_idx = 0; w_idx < bits_words; w_idx++)
+			{
+				size += BitCount(bits[w_idx]);
+			}
+			return size;
+		}
+		else
+		{
+			int size = 0;
+			for (int r_idx = 0; r_idx < values.Size(); r_idx += 2)
+			{
+				size += values[r_idx + 1] - values[r_idx];
+			}
+			return size;
+		}
 	}
-	Constraint::Eval OrRangeConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vid)
+	bool Domain::IsEmpty() const
 	{
-		if (inst_vars[v0].value != InstVar::UNASSIGNED &&
-			inst_vars[v1].value != InstVar::UNASSIGNED)
+		if (type == DomainType::Bitset)
 		{
-			return	(inst_vars[v0].value >= min && inst_vars[v0].value < max) ||
-					(inst_vars[v1].value >= min && inst_vars[v1].value < max) ? Constraint::Eval::Passed : Constraint::Eval::Failed;
+			unsigned long long any_bits = 0;
+			for (int w_idx = 0; w_idx < bits_words; w_idx++)
+			{
+				any_bits |= bits[w_idx];
+			}
+			return any_bits == 0;
 		}
-
-		return Constraint::Eval::NA;
+		return values.Size() == 0;
 	}
-	bool OrRangeConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid)
+	bool Domain::IsFixed() const
 	{
-#ifdef DEQUAN_WITH_STATS
-		a.stats.applied_arcs++;
-#endif
-#if 0
-		auto DoCheck = [&a](VarId v0, int min, int max)->bool
+		if (type == DomainType::Bitset)
 		{
-			Domain& dom = a.current_domains[v0];
-			const SavedDomain& sav_dom = a.EnsureSavedDomain(v0, dom);
-
-			dom.IntersectRange(min, max);
-
-			if (DEQUAN_Array_Size(dom.values) == 0)
+			int set_words = 0;
+			for (int w_idx = 0; w_idx < bits_words; w_idx++)
 			{
-				// Domain wipe out
-				return false;
+				unsigned long long word = bits[w_idx];
+				if (word != 0)
+				{
+					if ((word & (word - 1)) != 0 || ++set_words > 1)
+					{
+						return false;
+					}
+				}
 			}
-			return true;
-		};
-
-		// there are only two vars, and one has just been assigned
-		int v0_val = a.inst_vars[v0].value;
-		int v1_val = a.inst_vars[v1].value;
-
-		// Only restrict v0 domain if v1 range eq is not respected
-		if (v0_val == InstVar::UNASSIGNED && (v1_val < min || v1_val >= max) )
-		{
-			return DoCheck(v0, min, max);
+			return set_words == 1;
 		}
-		if (v1_val == InstVar::UNASSIGNED && (v0_val < min || v0_val >= max))
+		else if (type == DomainType::Values)
 		{
-			return DoCheck(v1, min, max);
+			return values.Size() == 1;
 		}
-
-		return true;
-#else
-		return true;
-#endif
+		return values.Size() == 2 && values[1] - values[0] == 1;
 	}
-	void AllDifferentConstraint::LinkVars(Array<Var>& vars)
+	int Domain::Min() const
 	{
-		for (int v_idx = 0; v_idx < DEQUAN_Array_Size(alldiff_vars); v_idx++)
+		if (type == DomainType::Bitset)
 		{
-			DEQUAN_Array_PushBack(vars[alldiff_vars[v_idx]].linked_constraints, this);
+			for (int w_idx = 0; w_idx < bits_words; w_idx++)
+			{
+				if (bits[w_idx] != 0)
+				{
+					return bits_min + w_idx * 64 + BitScanForward(bits[w_idx]);
+				}
+			}
 		}
+		return values[0];
 	}
-	Constraint::Eval AllDifferentConstraint::Evaluate(const Array<InstVar>& inst_vars, VarId last_assigned_vids)
+	int Domain::Max() const
 	{
-		int var_val = inst_vars[last_assigned_vids].value;
-		for (int v_idx = 0; v_idx < DEQUAN_Array_Size(alldiff_vars); v_idx++)
+		if (type == DomainType::Bitset)
 		{
-			if (inst_vars[alldiff_vars[v_idx]].value == var_val && alldiff_vars[v_idx] != last_assigned_vids)
+			for (int w_idx = bits_words - 1; w_idx >= 0; w_idx--)
 			{
-				return Constraint::Eval::Failed;
+				if (bits[w_idx] != 0)
+				{
+					return bits_min + w_idx * 64 + BitScanReverse(bits[w_idx]);
+				}
 			}
 		}
-
-		return Constraint::Eval::Passed;
+		else if (type == DomainType::Ranges)
+		{
+			return values.Back() - 1;
+		}
+		return values.Back();
 	}
-	bool AllDifferentConstraint::AplyArcConsistency(Assignment& a, VarId last_assigned_vid)
+	bool Domain::Contains(int val) const
 	{
-#ifdef DEQUAN_WITH_STATS
-		a.stats.applied_arcs++;
-#endif
-		int val = a.inst_vars[last_assigned_vid].value;
-		for (int v_idx = 0; v_idx < DEQUAN_Array_Size(alldiff_vars); v_idx++)
+		if (type == DomainType::Bitset)
+		{
+			long long bit = (long long)val - bits_min;
+			return bit >= 0 && bit < bits_words * 64 && (bits[bit >> 6] & (1ull << (bit & 63))) != 0;
+		}
+		else if (type == DomainType::Values)
+		{
+			int d_idx = FindFirstAtLeast(values, 0, 1, val);
+			return d_idx < values.Size() && values[d_idx] == val;
+		}
+		// First range ending after val
+		int r_idx = 2 * FindFirstAtLeast(values, 1, 2, (long long)val + 1);
+		return r_idx < values.Size() && values[r_idx] <= val;
+	}
+	bool Domain::NextValue(int prev, int& next) const
+	{
+		if (prev == INT_MAX)
+		{
+			return false;
+		}
+		if (type == DomainType::Bitset)
 		{
-			int vid = alldiff_vars[v_idx];
-			if (a.inst_vars[vid].value == InstVar::UNASSIGNED)
+			long long bit = (long long)prev + 1 - bits_min;
+			bit = bit > 0 ? bit : 0;
+			for (int w_idx = (int)(bit >> 6); w_idx < bits_words; w_idx++)
 			{
-				Domain& dom = a.current_domains[vid];
-				a.EnsureSavedDomain(vid, dom);
-				dom.Exclude(val);
-
-				if (DEQUAN_Array_Size(dom.values) == 0)
+				unsigned long long word = bits[w_idx] & BitRangeMask(w_idx, bit, bits_words * 64);
+				if (word != 0)
 				{
-					// Domain wipe out
-					return false;
+					next = bits_min + w_idx * 64 + BitScanForward(word);
+					return true;
 				}
 			}
 		}
-
-		return true;
-	}
-
-	int Domain::Size() const
-	{
-		if (type == DomainType::Values)
+		else if (type == DomainType::Values)
 		{
-			return (int)DEQUAN_Array_Size(values);
+			// Binary search of the first value > prev
+			int lo = 0, hi = (int)values.Size();
+			while (lo < hi)
+			{
+				int mid = (lo + hi) / 2;
+				if (values[mid] <= prev)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			if (lo < values.Size())
+			{
+				next = values[lo];
+				return true;
+			}
 		}
 		else
 		{
-			int size = 0;
-			for (int r_idx = 0; r_idx < DEQUAN_Array_Size(values); r_idx += 2)
+			for (int r_idx = 0; r_idx < values.Size(); r_idx += 2)
 			{
-				size += values[r_idx + 1] - values[r_idx];
+				if (prev + 1 < values[r_idx + 1])
+				{
+					next = prev + 1 > values[r_idx] ? prev + 1 : values[r_idx];
+					return true;
+				}
 			}
-			return size;
 		}
+		return false;
 	}
-	void Domain::Intersect(int val)
+	bool Domain::PrevValue(int next, int& prev) const
 	{
-		if (type == DomainType::Values)
+		if (next == INT_MIN)
+		{
+			return false;
+		}
+		if (type == DomainType::Bitset)
 		{
-			for (int d_idx = 0; d_idx < DEQUAN_Array_Size(values); d_idx++)
+			long long bit_end = (long long)next - bits_min;
+			bit_end = bit_end < bits_words * 64 ? bit_end : bits_words * 64;
+			for (int w_idx = (int)((bit_end - 1) >> 6); w_idx >= 0 && bit_end > 0; w_idx--)
 			{
-				if (val == values[d_idx])
+				unsigned long long word = bits[w_idx] & BitRangeMask(w_idx, 0, bit_end);
+				if (word != 0)
 				{
-					DEQUAN_Array_Clear(values);
-					DEQUAN_Array_PushBack(values, val);
-					break;
+					prev = bits_min + w_idx * 64 + BitScanReverse(word);
+					return true;
 				}
 			}
 		}
+		else if (type == DomainType::Values)
+		{
+			// Binary search of the first value >= next
+			int lo = 0, hi = (int)values.Size();
+			while (lo < hi)
+			{
+				int mid = (lo + hi) / 2;
+				if (values[mid] < next)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			if (lo > 0)
+			{
+				prev = values[lo - 1];
+				return true;
+			}
+		}
 		else
 		{
-			for (int r_idx = 0; r_idx < DEQUAN_Array_Size(values); r_idx += 2)
+			for (int r_idx = (int)values.Size() - 2; r_idx >= 0; r_idx -= 2)
 			{
-				if (values[r_idx] <= val && val < values[r_idx + 1])
+				if (values[r_idx] < next)
 				{
-					type = DomainType::Values;
-					DEQUAN_Array_Clear(values);
-					DEQUAN_Array_PushBack(values, val);
-					break;
+					prev = next - 1 < values[r_idx + 1] - 1 ? next - 1 : values[r_idx + 1] - 1;
+					return true;
 				}
 			}
 		}
+		return false;
 	}
-	void Domain::Exclude(int val)
+	int Domain::GetValue(int rank) const
 	{
 		if (type == DomainType::Values)
 		{
-			for (int d_idx = 0; d_idx < DEQUAN_Array_Size(values); d_idx++)
+			return values[rank];
+		}
+		else if (type == DomainType::Bitset)
+		{
+			for (int w_idx = 0; w_idx < bits_words; w_idx++)
 			{
-				if (val == values[d_idx])
+				unsigned long long word = bits[w_idx];
+				int word_count = BitCount(word);
+				if (rank < word_count)
 				{
-					DEQUAN_Array_Erase(values, d_idx, d_idx + 1);
-					break;
+					// Drop the lowest set bits of the word up to the one of the rank
+					for (; rank > 0; rank--)
+					{
+						word &= word - 1;
+					}
+					return bits_min + w_idx * 64 + BitScanForward(word);
 				}
+				rank -= word_count;
 			}
 		}
 		else
 		{
-			for (int r_idx = 0; r_idx < DEQUAN_Array_Size(values); r_idx += 2)
+			for (int r_idx = 0; r_idx < values.Size(); r_idx += 2)
 			{
-				int min = values[r_idx];
-				int max = values[r_idx + 1];
-				if (min <= val && val < max)
+				if (rank < values[r_idx + 1] - values[r_idx])
 				{
-					if (max - min <= 1)
-					{
-						DEQUAN_Array_Erase(values, r_idx, r_idx + 2);
-					}
-					else
-					{
-						if (val == min)
-						{
-							values[r_idx] = val + 1;
-						}
-						else if (val + 1 == max)
-						{
-							values[r_idx + 1] = val;
-						}
-						else
-						{
-							values[r_idx + 1] = val;
-							DEQUAN_Array_Insert(values, (r_idx + 2), max);
-							DEQUAN_Array_Insert(values, (r_idx + 2), val + 1);
-						}
-					}
-					break;
+					return values[r_idx] + rank;
 				}
+				rank -= values[r_idx + 1] - values[r_idx];
 			}
 		}
+		return INT_MAX;
 	}
-	void Domain::Intersect(int val0, int val1)
+	void Domain::Intersect(int val)
 	{
-		int write_idx = 0;
+		bool found = false;
 		if (type == DomainType::Values)
 		{
-			for (int d_idx = 0; d_idx < DEQUAN_Array_Size(values); d_idx++)
+			found = Contains(val);
+		}
+		else if (type == DomainType::Bitset)
+		{
+			long long bit = (long long)val - bits_min;
+			for (int w_idx = 0; w_idx < bits_words; w_idx++)
 			{
-				int val = values[d_idx];
-				if (val0 == val)
-				{
-					values[write_idx++] = val0;
-				}
-				else if (val1 == val)
-				{
-					values[write_idx++] = val1;
-				}
+				bits[w_idx] &= BitRangeMask(w_idx, bit, bit + 1);
 			}
+			return;
 		}
 		else
 		{
+			found = Contains(val);
 			type = DomainType::Values;
-			for (int r_idx = 0; r_idx < DEQUAN_Array_Size(values); r_idx += 2)
+		}
+		// If 'val' is not part of the domain, the domain is wiped out
+		values.Clear();
+		if (found)
+		{
+			values.PushBack(val);
+		}
+	}
+	void Domain::Exclude(int val)
+	{
+		if (type == DomainType::Bitset)
+		{
+			long long bit = (long long)val - bits_min;
+			if (bit >= 0 && bit < bits_words * 64)
 			{
-				int min = values[r_idx];
-				int max = values[r_idx + 1];
-				if (min <= val0 && val0 < max)
-				{
-					values[write_idx++] = val0;
-				}
-				if (min <= val1 && val1 < max)
-				{
-					values[write_idx++] = val1;
-				}
+				bits[bit >> 6] &= ~(1ull << (bit & 63));
+			}
+		}
+		else if (type == DomainType::Values)
+		{
+			int d_idx = FindFirstAtLeast(values, 0, 1, val);
+			if (d_idx < values.Size() && values[d_idx] == val)
+			{
+				values.Erase(d_idx, d_idx + 1);
+			}
+		}
+		else
+		{
+			// First range ending after val, which contains it if it starts before
+			int r_idx = 2 * FindFirstAtLeast(values, 1, 2, (long long)val + 1);
+			if (r_idx >= values.Size() || values[r_idx] > val)
+			{
+				return;
+			}
+			int min = values[r_idx];
+			int max = values[r_idx + 1];
+			if (max - min <= 1)
+			{
+				values.Erase(r_idx, r_idx + 2);
+			}
+			else if (val == min)
+			{
+				values.Set(r_idx, val + 1);
+			}
+			else if (val + 1 == max)
+			{
+				values.Set(r_idx + 1, val);
+			}
+			else
+			{
+				values.Set(r_idx + 1, val);
+				values.Insert(r_idx + 2, max);
+				values.Insert(r_idx + 2, val + 1);
 			}
 		}
-		DEQUAN_Array_Erase(values, write_idx, DEQUAN_Array_Size(values));
+	}
+	void Domain::Intersect(int val0, int val1)
+	{
+		int write_idx = 0;
+		if (type == DomainType::Bitset)
+		{
+			long long bit0 = (long long)val0 - bits_min;
+			long long bit1 = (long long)val1 - bits_min;
+			for (int w_idx = 0; w_idx < bits_words; w_idx++)
+			{
+				bits[w_idx] &= BitRangeMask(w_idx, bit0, bit0 + 1) | BitRangeMask(w_idx, bit1, bit1 + 1);
+			}
+			return;
+		}
+		// Values must stay sorted and unique
+		if (val1 < val0)
+		{
+			int val = val0;
+			val0 = val1;
+			val1 = val;
+		}
+		bool keep0 = Contains(val0);
+		bool keep1 = val1 != val0 && Contains(val1);
+		if (type == DomainType::Ranges)
+		{
+			type = DomainType::Values;
+			values.Resize(2);
+		}
+		if (keep0)
+		{
+			values.Set(write_idx++, val0);
+		}
+		if (keep1)
+		{
+			values.Set(write_idx++, val1);
+		}
+		values.Erase(write_idx, values.Size());
 	}
 	void Domain::IntersectRange(int rmin, int rmax)
 	{
-		if (type == DomainType::Values)
+		if (type == DomainType::Bitset)
 		{
-			int write_idx = 0;
-			for (int d_idx = 0; d_idx < DEQUAN_Array_Size(values); d_idx++)
+			for (int w_idx = 0; w_idx < bits_words; w_idx++)
+			{
+				bits[w_idx] &= BitRangeMask(w_idx, (long long)rmin - bits_min, (long long)rmax - bits_min);
+			}
+		}
+		else
+		{
+			ExcludeSup(rmax);
+			ExcludeInf(rmin);
+		}
+	}
+	void Domain::IntersectValues(const int* sorted_vals, int count)
+	{
+		if (type == DomainType::Bitset)
+		{
+			unsigned long long kept_bits[BITSET_MAX_WORDS] = {};
+			for (int v_idx = 0; v_idx < count; v_idx++)
 			{
-				int val = values[d_idx];
-				if (rmin <= val && val < rmax)
+				long long bit = (long long)sorted_vals[v_idx] - bits_min;
+				if (bit >= 0 && bit < bits_words * 64)
 				{
-					values[write_idx++] = val;
+					kept_bits[bit >> 6] |= 1ull << (bit & 63);
 				}
 			}
-			DEQUAN_Array_Erase(values, write_idx, DEQUAN_Array_Size(values));
+			for (int w_idx = 0; w_idx < bits_words; w_idx++)
+			{
+				bits[w_idx] &= kept_bits[w_idx];
+			}
 		}
-		else
+		else if (type == DomainType::Values)
 		{
-			for (int r_idx = 0; r_idx < DEQUAN_Array_Size(values); )
+			// Both lists are sorted, keep the common values in place
+			int write_idx = 0;
+			for (int d_idx = 0, v_idx = 0; d_idx < values.Size() && v_idx < count; )
 			{
-				int min = values[r_idx];
-				int max = values[r_idx + 1];
-				int new_min = min > rmin ? min : rmin;
-				int new_max = max < rmax ? max : rmax;
-				if (new_max > new_min)
+				if (values[d_idx] < sorted_vals[v_idx])
 				{
-					values[r_idx] = new_min;
-					values[r_idx + 1] = new_max;
-					r_idx += 2;
+					d_idx++;
+				}
+				else if (sorted_vals[v_idx] < values[d_idx])
+				{
+					v_idx++;
 				}
 				else
 				{
-					DEQUAN_Array_Erase(values, r_idx, r_idx + 2);
+					values.Set(write_idx++, values[d_idx++]);
+					v_idx++;
+				}
+			}
+			values.Erase(write_idx, values.Size());
+		}
+		else
+		{
+			Array<int> kept_values;
+			for (int v_idx = 0; v_idx < count; v_idx++)
+			{
+				if (Contains(sorted_vals[v_idx]))
+				{
+					DEQUAN_Array_PushBack(kept_values, sorted_vals[v_idx]);
 				}
 			}
+			values = kept_values;
+			type = DomainType::Values;
 		}
 	}
 	void Domain::ExcludeSup(int rmax)
 	{
-		if (type == DomainType::Values)
+		if (type == DomainType::Bitset)
 		{
-			int write_idx = 0;
-			for (int d_idx = 0; d_idx < DEQUAN_Array_Size(values); d_idx++)
+			for (int w_idx = 0; w_idx < bits_words; w_idx++)
 			{
-				int val = values[d_idx];
-				if (val < rmax)
-				{
-					values[write_idx++] = val;
-				}
+				bits[w_idx] &= BitRangeMask(w_idx, 0, (long long)rmax - bits_min);
 			}
-			DEQUAN_Array_Erase(values, write_idx, DEQUAN_Array_Size(values));
+		}
+		else if (type == DomainType::Values)
+		{
+			// Values are sorted, the kept ones are a prefix
+			values.Erase(FindFirstAtLeast(values, 0, 1, rmax), values.Size());
 		}
 		else
 		{
-			for (int r_idx = 0; r_idx < DEQUAN_Array_Size(values); )
+			// Drop the ranges starting at rmax or later, and cut the last kept one
+			int r_end = 2 * FindFirstAtLeast(values, 0, 2, rmax);
+			values.Erase(r_end, values.Size());
+			if (r_end > 0 && values[r_end - 1] > rmax)
 			{
-				int min = values[r_idx];
-				int max = values[r_idx + 1];
-				int new_max = max < rmax ? max : rmax;
-				if (new_max > min)
-				{
-					values[r_idx + 1] = new_max;
-					r_idx += 2;
-				}
-				else
-				{
-					DEQUAN_Array_Erase(values, r_idx, r_idx + 2);
-				}
+				values.Set(r_end - 1, rmax);
 			}
 		}
 	}
 	void Domain::ExcludeInf(int rmin)
 	{
-		if (type == DomainType::Values)
+		if (type == DomainType::Bitset)
 		{
-			int write_idx = 0;
-			for (int d_idx = 0; d_idx < DEQUAN_Array_Size(values); d_idx++)
+			for (int w_idx = 0; w_idx < bits_words; w_idx++)
 			{
-				int val = values[d_idx];
-				if (val >= rmin)
-				{
-					values[write_idx++] = val;
-				}
+				bits[w_idx] &= BitRangeMask(w_idx, (long long)rmin - bits_min, bits_words * 64);
 			}
-			DEQUAN_Array_Erase(values, write_idx, DEQUAN_Array_Size(values));
+		}
+		else if (type == DomainType::Values)
+		{
+			// Values are sorted, the kept ones are a suffix
+			values.Erase(0, FindFirstAtLeast(values, 0, 1, rmin));
 		}
 		else
 		{
-			for (int r_idx = 0; r_idx < DEQUAN_Array_Size(values); )
+			// Drop the ranges ending at rmin or before, and cut the first kept one
+			values.Erase(0, 2 * FindFirstAtLeast(values, 1, 2, (long long)rmin + 1));
+			if (values.Size() > 0 && values[0] < rmin)
 			{
-				int min = values[r_idx];
-				int max = values[r_idx + 1];
-				int new_min = min > rmin ? min : rmin;
-				if (max > new_min)
-				{
-					values[r_idx] = new_min;
-					r_idx += 2;
-				}
-				else
-				{
-					DEQUAN_Array_Erase(values, r_idx, r_idx + 2);
-				}
+				values.Set(0, rmin);
 			}
 		}
 	}
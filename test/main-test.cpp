@@ -2,42 +2,84 @@
 #include <iostream>
 #include <chrono>
 #include <ratio>
+#include <set>
+#include <cstdio>
 
 #define DEQUAN_USE_STDVECTOR
+#define DEQUAN_WITH_POOL_ALLOCATOR
 #define DEQUAN_WITH_STATS
+#define DEQUAN_WITH_TRACE
+#define DEQUAN_WITH_THREADS
+#define DEQUAN_WITH_MMAP
 #define DEQUAN_IMPLEMENTATION
-//#define DEQUAN_SET_CONSTRAINT_SIZE 64
 #include "../dequan.h"
 
 //struct MyNewConstraint : public dequan::Constraint
 //{
-//    MyNewConstraint()
-//    {
-//        static_assert(sizeof(MyNewConstraint) <= DEQUAN_SET_CONSTRAINT_SIZE, "");
-//    }
-//    virtual void LinkVars(dequan::Array<dequan::Var>& vars) {}
-//    virtual Eval Evaluate(const dequan::Array<dequan::InstVar>& inst_vars, dequan::VarId last_assigned_vid) { return dequan::Constraint::Eval::Passed;  }
-//    virtual bool AplyArcConsistency(dequan::Assignment& a, dequan::VarId last_assigned_vid) { return true;  }
+//    MyNewConstraint() = default;
+//    virtual void LinkVars(dequan::Array<dequan::VarId>& linked_vars) const {}
+//    virtual Eval Evaluate(const dequan::Array<dequan::InstVar>& inst_vars, dequan::VarId last_assigned_vid, int last_assigned_pos) { return dequan::Constraint::Eval::Passed;  }
+//    virtual bool AplyArcConsistency(dequan::Assignment& a, dequan::VarId last_assigned_vid, int last_assigned_pos) { return true;  }
 //
 //    dequan::Array<int> a0, a1;
 //};
 
 
-// https://en.wikipedia.org/wiki/Eight_queens_puzzle
-bool NQueensTest(const int num_queen)
+// User constraint v0 != v1, padded and over-aligned to check how the constraint arena stores it
+struct alignas(64) PaddedNotEqualConstraint : public dequan::Constraint
 {
-    std::cout << "\n\n----------------------------\n";
-    std::cout << num_queen << "-queens test : ";
+    PaddedNotEqualConstraint(dequan::VarId _v0, dequan::VarId _v1) : v0(_v0), v1(_v1) {}
+    virtual void LinkVars(dequan::Array<dequan::VarId>& linked_vars) const
+    {
+        linked_vars.push_back(v0);
+        linked_vars.push_back(v1);
+    }
+    virtual Eval Evaluate(const dequan::Array<dequan::InstVar>& inst_vars, dequan::VarId last_assigned_vid, int last_assigned_pos)
+    {
+        if (inst_vars[v0].value == dequan::InstVar::UNASSIGNED || inst_vars[v1].value == dequan::InstVar::UNASSIGNED)
+        {
+            return Eval::NA;
+        }
+        return inst_vars[v0].value != inst_vars[v1].value ? Eval::Passed : Eval::Failed;
+    }
 
-    dequan::CSP csp;
-    dequan::Array<dequan::VarId> qvars;
-    qvars.resize(num_queen);
+    dequan::VarId v0, v1;
+    char padding[4096] = {};
+};
+
+// User constraint v0 == v1 propagated from the assigned var only, as user constraints wake up on assignments by default
+struct AssignedCopyConstraint : public dequan::Constraint
+{
+    AssignedCopyConstraint(dequan::VarId _v0, dequan::VarId _v1) : v0(_v0), v1(_v1) {}
+    virtual void LinkVars(dequan::Array<dequan::VarId>& linked_vars) const
+    {
+        linked_vars.push_back(v0);
+        linked_vars.push_back(v1);
+    }
+    virtual Eval Evaluate(const dequan::Array<dequan::InstVar>& inst_vars, dequan::VarId last_assigned_vid, int last_assigned_pos)
+    {
+        if (inst_vars[v0].value == dequan::InstVar::UNASSIGNED || inst_vars[v1].value == dequan::InstVar::UNASSIGNED)
+        {
+            return Eval::NA;
+        }
+        return inst_vars[v0].value == inst_vars[v1].value ? Eval::Passed : Eval::Failed;
+    }
+    virtual bool AplyArcConsistency(dequan::Assignment& a, dequan::VarId last_assigned_vid, int last_assigned_pos)
+    {
+        return a.IntersectVar(last_assigned_pos == 0 ? v1 : v0, a.inst_vars[last_assigned_vid].value);
+    }
 
+    dequan::VarId v0, v1;
+};
+
+// Queens on a num_queen x num_queen board, one var per column giving the row of its queen
+static void BuildNQueens(dequan::CSP& csp, int num_queen, dequan::Array<dequan::VarId>& qvars)
+{
+    qvars.resize(num_queen);
     for (int i = 0; i < num_queen; i++)
     {
         qvars[i] = csp.AddIntVar(0, num_queen);
     }
-
     for (int i = 0; i < num_queen; i++)
     {
         for (int j = i + 1; j < num_queen; j++)
@@ -47,9 +89,21 @@ bool NQueensTest(const int num_queen)
             csp.AddConstraint(dequan::OpConstraint(qvars[i], qvars[j], dequan::OpConstraint::Op::NotEqual, i - j));
         }
     }
+}
+
+// https://en.wikipedia.org/wiki/Eight_queens_puzzle
+bool NQueensTest(const int num_queen, dequan::VarHeuristic var_heuristic = dequan::VarHeuristic::Static)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens test : ";
+
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> qvars;
+    BuildNQueens(csp, num_queen, qvars);
     csp.FinalizeModel();
 
     dequan::Assignment a;
+    a.params.var_heuristic = var_heuristic;
     a.Reset(csp);
 
     auto t1 = std::chrono::high_resolution_clock::now();
@@ -232,10 +286,1815 @@ bool OpInequalityTest()
     return success;
 }
 
+bool ResumableSolveTest(const int num_queen)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens resumable solve test : ";
+
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> qvars;
+    BuildNQueens(csp, num_queen, qvars);
+    csp.FinalizeModel();
+
+    dequan::Assignment ref_a;
+    ref_a.Reset(csp);
+    bool ref_success = csp.ForwardCheckingStep(ref_a);
+
+    // Solve again by slices of a few nodes, and make sure we get the same solution as the recursive search
+    dequan::Assignment a;
+    a.Reset(csp);
+
+    dequan::SearchBudget budget;
+    budget.max_nodes = 10;
+    int slice_count = 1;
+    dequan::SearchStatus status = csp.Solve(a, budget);
+    while (status == dequan::SearchStatus::Paused)
+    {
+        status = csp.Solve(a, budget);
+        slice_count++;
+    }
+
+    bool success = ref_success && status == dequan::SearchStatus::Solved && a.search_nodes == ref_a.search_nodes;
+    for (int col_idx = 0; success && col_idx < num_queen; col_idx++)
+    {
+        success = a.GetInstVarValue(qvars[col_idx]) == ref_a.GetInstVarValue(qvars[col_idx]);
+    }
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\nsolved in " << slice_count << " slices, " << a.search_nodes << " nodes.\n";
+
+    return success;
+}
+bool SearchLimitsTest(const int num_holes)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_holes << "-holes pigeonhole search limits test : ";
+
+    // num_holes + 1 pigeons in num_holes holes, with pairwise differences only: infeasible, and far too long to prove
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> vars;
+    vars.resize(num_holes + 1);
+    for (int i = 0; i <= num_holes; i++)
+    {
+        vars[i] = csp.AddIntVar(0, num_holes);
+    }
+    for (int i = 0; i <= num_holes; i++)
+    {
+        for (int j = i + 1; j <= num_holes; j++)
+        {
+            csp.AddConstraint(dequan::OpConstraint(vars[i], vars[j], dequan::OpConstraint::Op::NotEqual, 0));
+        }
+    }
+    csp.FinalizeModel();
+
+    dequan::Assignment a;
+    a.Reset(csp);
+
+    // Backtrack limit, the search can be resumed for the same number of backtracks
+    dequan::SearchBudget backtrack_budget;
+    backtrack_budget.max_backtracks = 100;
+    bool success = csp.Solve(a, backtrack_budget) == dequan::SearchStatus::Paused && a.search_backtracks == 100;
+    success = success && csp.Solve(a, backtrack_budget) == dequan::SearchStatus::Paused && a.search_backtracks == 200;
+
+    // Relative and absolute time limits
+    auto t1 = std::chrono::steady_clock::now();
+    dequan::SearchBudget time_budget;
+    time_budget.max_seconds = 0.02;
+    success = success && csp.Solve(a, time_budget) == dequan::SearchStatus::Timeout;
+    dequan::SearchBudget deadline_budget;
+    deadline_budget.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+    success = success && csp.Solve(a, deadline_budget) == dequan::SearchStatus::Timeout;
+    dequan::SearchStatus count_status = dequan::SearchStatus::Infeasible;
+    csp.CountSolutions(a, 0, time_budget, &count_status);
+    success = success && count_status == dequan::SearchStatus::Timeout;
+    auto t2 = std::chrono::steady_clock::now();
+    std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
+    success = success && time_span.count() < 1.0;
+
+    // Cancellation from another thread
+    std::atomic<bool> stop_flag(false);
+    dequan::SearchBudget cancel_budget;
+    cancel_budget.stop_flag = &stop_flag;
+    std::thread canceller([&stop_flag]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        stop_flag.store(true);
+    });
+    success = success && csp.Solve(a, cancel_budget) == dequan::SearchStatus::Cancelled;
+    canceller.join();
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\ninterrupted after " << a.search_nodes << " nodes, " << a.search_backtracks << " backtracks.\n";
+
+    return success;
+}
+bool RestartTest(const int num_queen, const unsigned long long expected_count)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens restarts test : ";
+
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> qvars;
+    BuildNQueens(csp, num_queen, qvars);
+    csp.FinalizeModel();
+
+    // Enumerate all the solutions with frequent restarts, the nogoods must prevent any solution from being reported twice
+    dequan::Assignment a;
+    a.params.var_heuristic = dequan::VarHeuristic::DomWDeg;
+    a.params.restart_policy = dequan::RestartPolicy::Luby;
+    a.params.restart_base = 10;
+    a.params.random_seed = 42;
+    a.params.last_conflict = true;
+    a.Reset(csp);
+
+    std::set<std::vector<int>> solutions;
+    unsigned long long solution_count = 0;
+    bool success = true;
+    while (csp.Solve(a) == dequan::SearchStatus::Solved)
+    {
+        std::vector<int> solution(num_queen);
+        for (int col_idx = 0; col_idx < num_queen; col_idx++)
+        {
+            solution[col_idx] = a.GetInstVarValue(qvars[col_idx]);
+        }
+        for (int i = 0; success && i < num_queen; i++)
+        {
+            for (int j = i + 1; success && j < num_queen; j++)
+            {
+                success = solution[i] != solution[j] && solution[i] - solution[j] != j - i && solution[j] - solution[i] != j - i;
+            }
+        }
+        solutions.insert(solution);
+        solution_count++;
+    }
+    success = success && solution_count == expected_count && solutions.size() == expected_count && a.search_restarts > 0;
+
+    // Infeasibility is still proven with geometric restarts
+    dequan::CSP pigeon_csp;
+    for (int i = 0; i <= 5; i++)
+    {
+        pigeon_csp.AddIntVar(0, 5);
+    }
+    for (int i = 0; i <= 5; i++)
+    {
+        for (int j = i + 1; j <= 5; j++)
+        {
+            pigeon_csp.AddConstraint(dequan::OpConstraint(i, j, dequan::OpConstraint::Op::NotEqual, 0));
+        }
+    }
+    pigeon_csp.FinalizeModel();
+    dequan::Assignment pigeon_a;
+    pigeon_a.params.restart_policy = dequan::RestartPolicy::Geometric;
+    pigeon_a.params.restart_base = 5;
+    pigeon_a.Reset(pigeon_csp);
+    success = success && pigeon_csp.Solve(pigeon_a) == dequan::SearchStatus::Infeasible && pigeon_a.search_restarts > 0;
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\n" << solution_count << " solutions with " << a.search_restarts << " restarts, " << a.search_nodes << " nodes.\n";
+
+    return success;
+}
+bool ProfileTest(const int num_queen, const unsigned long long expected_count)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens profile test : ";
+
+    // The rows are also all different as a whole
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> qvars;
+    BuildNQueens(csp, num_queen, qvars);
+    csp.AddConstraint(dequan::AllDifferentConstraint(qvars));
+    csp.FinalizeModel();
+
+    dequan::Assignment a;
+    a.Reset(csp);
+    unsigned long long solution_count = 0;
+    while (csp.Solve(a) == dequan::SearchStatus::Solved)
+    {
+        solution_count++;
+    }
+
+    // Per constraint counters add up to the global ones, and every failed assignment is a wipe-out or a violation
+    dequan::ConstraintStats total_stats;
+    for (const dequan::ConstraintStats& con_stats : a.stats.constraint_stats)
+    {
+        total_stats.Add(con_stats);
+    }
+    dequan::ConstraintStats op_stats = a.stats.GetKindStats(csp, dequan::ConstraintKind::Op);
+    dequan::ConstraintStats alldiff_stats = a.stats.GetKindStats(csp, dequan::ConstraintKind::AllDifferent);
+    bool success = solution_count == expected_count && total_stats.propagations == a.stats.applied_arcs && total_stats.validations == a.stats.validated_constraints
+        && op_stats.propagations + alldiff_stats.propagations == total_stats.propagations && total_stats.wipeouts + total_stats.violations == a.search_backtracks
+        && total_stats.prunings > 0;
+
+    unsigned long long depth_count = 0, backtrack_count = 0;
+    for (int d_idx = 0; d_idx < num_queen; d_idx++)
+    {
+        depth_count += a.stats.depth_histogram[d_idx];
+        backtrack_count += a.stats.backtrack_histogram[d_idx];
+    }
+    success = success && depth_count == a.stats.assigned_vars && backtrack_count == a.search_backtracks;
+
+    // Replay the trace, it decodes to the same tree
+    dequan::TraceReader reader(a.trace.bytes.data(), a.trace.bytes.size());
+    dequan::TraceRecord record;
+    unsigned long long assign_count = 0, fail_count = 0, trace_solution_count = 0;
+    int open_depth = 0;
+    while (reader.Next(record))
+    {
+        if (record.event == dequan::TraceEvent::Assign)
+        {
+            // Each assignment is made below the last one that succeeded
+            success = success && record.depth <= open_depth && record.var_id >= 0 && record.var_id < num_queen && record.value >= 0 && record.value < num_queen;
+            open_depth = record.depth + 1;
+            assign_count++;
+        }
+        else if (record.event == dequan::TraceEvent::Fail)
+        {
+            fail_count++;
+        }
+        else if (record.event == dequan::TraceEvent::Solution)
+        {
+            success = success && open_depth == num_queen;
+            trace_solution_count++;
+        }
+    }
+    success = success && assign_count == a.stats.assigned_vars && fail_count == a.search_backtracks && trace_solution_count == expected_count;
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\nOp propagations : " << op_stats.propagations << ", prunings : " << op_stats.prunings << ", wipeouts : " << op_stats.wipeouts
+        << "\nAllDifferent propagations : " << alldiff_stats.propagations << ", prunings : " << alldiff_stats.prunings << ", wipeouts : " << alldiff_stats.wipeouts
+        << "\ntrace : " << a.trace.bytes.size() << " bytes for " << assign_count << " assignments.\n";
+
+    return success;
+}
+
+bool WarmStartTest(const int num_queen)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens warm start test : ";
+
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> qvars;
+    BuildNQueens(csp, num_queen, qvars);
+    csp.FinalizeModel();
+
+    // Re-solve with the first queen fixed on each row, a rewound assignment must search exactly like a fresh one
+    dequan::Assignment a;
+    a.params.var_heuristic = dequan::VarHeuristic::DomWDeg;
+    a.Reset(csp);
+    bool success = true;
+    unsigned long long total_nodes = 0;
+    for (int row = 0; success && row < num_queen; row++)
+    {
+        dequan::Assignment ref_a;
+        ref_a.params.var_heuristic = dequan::VarHeuristic::DomWDeg;
+        ref_a.Reset(csp);
+        bool ref_fixed = ref_a.FixVar(qvars[0], row);
+        dequan::SearchStatus ref_status = ref_fixed ? csp.Solve(ref_a) : dequan::SearchStatus::Infeasible;
+
+        a.Rewind();
+        bool fixed = a.FixVar(qvars[0], row);
+        dequan::SearchStatus status = fixed ? csp.Solve(a) : dequan::SearchStatus::Infeasible;
+        success = fixed == ref_fixed && status == ref_status && a.search_nodes == ref_a.search_nodes;
+        for (int col_idx = 0; success && status == dequan::SearchStatus::Solved && col_idx < num_queen; col_idx++)
+        {
+            success = a.GetInstVarValue(qvars[col_idx]) == ref_a.GetInstVarValue(qvars[col_idx]);
+        }
+        success = success && (status != dequan::SearchStatus::Solved || a.GetInstVarValue(qvars[0]) == row);
+        total_nodes += a.search_nodes;
+    }
+
+    // A previous solution as hint is found again without any backtrack, even when the heuristic starts elsewhere
+    dequan::Assignment hint_a;
+    hint_a.params.var_heuristic = dequan::VarHeuristic::DomWDeg;
+    hint_a.params.value_order = dequan::ValueOrder::Max;
+    hint_a.Reset(csp);
+    success = success && csp.Solve(hint_a) == dequan::SearchStatus::Solved;
+    dequan::Array<dequan::InstVar> solution = hint_a.inst_vars;
+    hint_a.params.value_order = dequan::ValueOrder::Min;
+    hint_a.params.SetSolutionHint(solution);
+    hint_a.Rewind();
+    success = success && csp.Solve(hint_a) == dequan::SearchStatus::Solved && hint_a.search_backtracks == 0;
+    for (int col_idx = 0; success && col_idx < num_queen; col_idx++)
+    {
+        success = hint_a.GetInstVarValue(qvars[col_idx]) == solution[qvars[col_idx]].value;
+    }
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\n" << num_queen << " re-solves in " << total_nodes << " nodes, hinted solve in " << hint_a.search_nodes << " nodes.\n";
+
+    return success;
+}
+bool VarBoundsTest(const int num_queen)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens var bounds test : ";
+
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> qvars;
+    BuildNQueens(csp, num_queen, qvars);
+    dequan::Array<int> coefs(num_queen, 1);
+    csp.AddConstraint(dequan::LinearConstraint(qvars, coefs, dequan::OpConstraint::Op::Equal, num_queen * (num_queen - 1) / 2));
+    csp.FinalizeModel();
+
+    // Cached bounds must match the current domains whenever the search is paused, in the middle of backtracks
+    auto IsCacheExact = [&csp](const dequan::Assignment& a) -> bool
+    {
+        for (int v_idx = 0; v_idx < (int)csp.vars.size(); v_idx++)
+        {
+            const dequan::Domain& dom = a.GetCurrentDomain(v_idx);
+            if (a.var_sizes[v_idx] != dom.Size() || (!dom.IsEmpty() && (a.var_mins[v_idx] != dom.Min() || a.var_maxs[v_idx] != dom.Max())))
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    dequan::Assignment a;
+    a.params.var_heuristic = dequan::VarHeuristic::DomWDeg;
+    a.Reset(csp);
+    bool success = IsCacheExact(a);
+    dequan::SearchBudget budget;
+    budget.max_nodes = 1;
+    int pause_count = 0, solution_count = 0;
+    dequan::SearchStatus status = dequan::SearchStatus::Paused;
+    while (success && solution_count < 3 && (status == dequan::SearchStatus::Paused || status == dequan::SearchStatus::Solved))
+    {
+        status = csp.Solve(a, budget);
+        pause_count++;
+        solution_count += status == dequan::SearchStatus::Solved ? 1 : 0;
+        success = IsCacheExact(a);
+    }
+    success = success && solution_count == 3;
+
+    // Root changes are undone by Rewind(), failed ones are flushed as well
+    a.Rewind();
+    success = success && IsCacheExact(a) && a.FixVar(qvars[0], 0) && IsCacheExact(a);
+    a.FixVar(qvars[1], 1);
+    success = success && IsCacheExact(a);
+    a.Rewind();
+    success = success && IsCacheExact(a) && a.var_sizes[qvars[0]] == num_queen;
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\nchecked " << pause_count << " pauses.\n";
+
+    return success;
+}
+
+static int FixedValueHint(const dequan::Assignment& a, dequan::VarId vid, void* user_data)
+{
+    return *(const int*)user_data;
+}
+bool ValueOrderTest(const int horizon)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << horizon << "-horizon value order test : ";
+
+    // Order of the values of a single unconstrained var, enumerated solution by solution
+    dequan::CSP order_csp;
+    dequan::VarId x = order_csp.AddIntVar(dequan::Domain(dequan::DomainType::Values, { 1, 3, 4, 8, 9 }));
+    order_csp.FinalizeModel();
+    int hint_value = 8;
+    auto EnumerateValues = [&order_csp, x, &hint_value](dequan::ValueOrder value_order, bool with_hint, unsigned int random_seed)->dequan::Array<int>
+    {
+        dequan::Assignment a;
+        a.params.value_order = value_order;
+        a.params.split_min_size = 2;
+        a.params.random_seed = random_seed;
+        if (with_hint)
+        {
+            a.params.value_hint_callback = FixedValueHint;
+            a.params.value_hint_user_data = &hint_value;
+        }
+        a.Reset(order_csp);
+        dequan::Array<int> values;
+        while (order_csp.Solve(a) == dequan::SearchStatus::Solved)
+        {
+            values.push_back(a.GetInstVarValue(x));
+        }
+        return values;
+    };
+    bool success = EnumerateValues(dequan::ValueOrder::Min, false, 0) == dequan::Array<int>({ 1, 3, 4, 8, 9 }) &&
+        EnumerateValues(dequan::ValueOrder::Max, false, 0) == dequan::Array<int>({ 9, 8, 4, 3, 1 }) &&
+        EnumerateValues(dequan::ValueOrder::Median, false, 0) == dequan::Array<int>({ 4, 3, 1, 8, 9 }) &&
+        EnumerateValues(dequan::ValueOrder::Split, false, 0) == dequan::Array<int>({ 1, 3, 4, 8, 9 }) &&
+        EnumerateValues(dequan::ValueOrder::Min, true, 0) == dequan::Array<int>({ 8, 1, 3, 4, 9 }) &&
+        EnumerateValues(dequan::ValueOrder::Split, true, 0) == dequan::Array<int>({ 8, 9, 1, 3, 4 });
+    // A random order is a rotation of the ascending values, the same for the same seed
+    for (unsigned int seed = 1; success && seed <= 8; seed++)
+    {
+        dequan::Array<int> values = EnumerateValues(dequan::ValueOrder::Random, false, seed);
+        success = values.size() == 5 && values == EnumerateValues(dequan::ValueOrder::Random, false, seed);
+        for (int v_idx = 1; success && v_idx < 5; v_idx++)
+        {
+            success = values[v_idx] > values[v_idx - 1] || (values[v_idx] == 1 && values[v_idx - 1] == 9);
+        }
+    }
+
+    // Timestamps: 'end' must be more than 'gap' after 'start', where 'end' is branched on first.
+    // Enumerating the values of 'end' fails on each of them up to the gap, bisection discards half of them at each split.
+    const int gap = horizon - horizon / 10;
+    dequan::CSP csp;
+    dequan::VarId start = csp.AddIntVar(0, horizon);
+    dequan::VarId end = csp.AddIntVar(horizon / 100, horizon);
+    csp.AddConstraint(dequan::OpConstraint(end, start, dequan::OpConstraint::Op::Sup, gap));
+    csp.FinalizeModel();
+
+    dequan::Assignment min_a;
+    min_a.Reset(csp);
+    dequan::SearchBudget budget;
+    budget.max_nodes = 1000;
+    success = success && csp.Solve(min_a, budget) == dequan::SearchStatus::Paused;
+
+    dequan::Assignment split_a;
+    split_a.params.value_order = dequan::ValueOrder::Split;
+    split_a.Reset(csp);
+    success = success && csp.Solve(split_a, budget) == dequan::SearchStatus::Solved &&
+        split_a.GetInstVarValue(end) > split_a.GetInstVarValue(start) + gap;
+    int split_count = 0;
+    dequan::TraceReader reader(split_a.trace.bytes.data(), split_a.trace.bytes.size());
+    dequan::TraceRecord record;
+    while (reader.Next(record))
+    {
+        split_count += record.event == dequan::TraceEvent::SplitLow || record.event == dequan::TraceEvent::SplitHigh;
+    }
+    success = success && split_count > 0 && split_a.search_nodes < 100;
+
+    // The recursive search follows the same order
+    dequan::Assignment fc_a;
+    fc_a.params.value_order = dequan::ValueOrder::Split;
+    fc_a.Reset(csp);
+    success = success && csp.ForwardCheckingStep(fc_a) && fc_a.search_nodes == split_a.search_nodes &&
+        fc_a.GetInstVarValue(start) == split_a.GetInstVarValue(start) && fc_a.GetInstVarValue(end) == split_a.GetInstVarValue(end);
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\nsplit solve in " << split_a.search_nodes << " nodes and " << split_count << " splits, ascending values paused after " << min_a.search_nodes << " nodes.\n";
+
+    return success;
+}
+bool ModelEditTest(const int num_queen, const unsigned long long expected_count)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens model edit test : ";
+
+    // Rows first: queens are only pairwise different, num_queen! solutions
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> qvars;
+    qvars.resize(num_queen);
+    for (int i = 0; i < num_queen; i++)
+    {
+        qvars[i] = csp.AddIntVar(0, num_queen);
+    }
+    for (int i = 0; i < num_queen; i++)
+    {
+        for (int j = i + 1; j < num_queen; j++)
+        {
+            csp.AddConstraint(dequan::OpConstraint(qvars[i], qvars[j], dequan::OpConstraint::Op::NotEqual, 0));
+        }
+    }
+    csp.FinalizeModel();
+    unsigned long long factorial = 1;
+    for (int i = 2; i <= num_queen; i++)
+    {
+        factorial *= i;
+    }
+
+    dequan::Assignment a;
+    a.Reset(csp);
+    bool success = csp.CountSolutions(a) == factorial;
+
+    // Diagonals added to the finalized model
+    dequan::Array<int> diagonal_ids;
+    for (int i = 0; i < num_queen; i++)
+    {
+        for (int j = i + 1; j < num_queen; j++)
+        {
+            diagonal_ids.push_back((int)csp.constraints.size());
+            csp.AddConstraint(dequan::OpConstraint(qvars[i], qvars[j], dequan::OpConstraint::Op::NotEqual, j - i));
+            diagonal_ids.push_back((int)csp.constraints.size());
+            csp.AddConstraint(dequan::OpConstraint(qvars[i], qvars[j], dequan::OpConstraint::Op::NotEqual, i - j));
+        }
+    }
+    a.Rewind();
+    unsigned long long queens_count = csp.CountSolutions(a);
+    success = success && queens_count == expected_count;
+
+    // Disabled diagonals are ignored, and enabled again
+    for (int c_idx = 0; c_idx < (int)diagonal_ids.size(); c_idx++)
+    {
+        csp.DisableConstraint(diagonal_ids[c_idx]);
+    }
+    a.Rewind();
+    success = success && csp.CountSolutions(a) == factorial;
+    for (int c_idx = 0; c_idx < (int)diagonal_ids.size(); c_idx++)
+    {
+        csp.EnableConstraint(diagonal_ids[c_idx]);
+    }
+    a.Rewind();
+    success = success && csp.CountSolutions(a) == expected_count;
+
+    // Fixed queen retracted by restoring its domain
+    dequan::Domain full_domain = csp.domains[qvars[0]];
+    unsigned long long fixed_count = 0;
+    for (int row = 0; row < num_queen; row++)
+    {
+        csp.SetVarDomain(qvars[0], dequan::Domain(dequan::DomainType::Values, { row }));
+        a.Rewind();
+        fixed_count += csp.CountSolutions(a);
+    }
+    csp.SetVarDomain(qvars[0], full_domain);
+    a.Rewind();
+    success = success && fixed_count == expected_count && csp.CountSolutions(a) == expected_count;
+
+    // New var linked to the first queen only
+    dequan::VarId extra_var = csp.AddIntVar(0, num_queen);
+    csp.AddConstraint(dequan::OpConstraint(extra_var, qvars[0], dequan::OpConstraint::Op::NotEqual, 0));
+    a.Rewind();
+    success = success && csp.CountSolutions(a) == expected_count * (num_queen - 1);
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\n" << csp.constraints.size() << " constraints after edits, " << queens_count << " solutions.\n";
+
+    return success;
+}
+bool PresolveTest(const int num_queen)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens presolve test : ";
+
+    // Redundant model: each diagonal constraint is also added mirrored, the first queen is constrained through fixed vars,
+    // and the last one is copied along a chain of equalities. Once the first queen is off row 0, one of its diagonals is entailed too.
+    auto BuildQueens = [num_queen](dequan::CSP& csp, bool presolve)
+    {
+        dequan::Array<dequan::VarId> qvars;
+        BuildNQueens(csp, num_queen, qvars);
+        for (int i = 0; i < num_queen; i++)
+        {
+            for (int j = i + 1; j < num_queen; j++)
+            {
+                csp.AddConstraint(dequan::OpConstraint(qvars[j], qvars[i], dequan::OpConstraint::Op::NotEqual, i - j));
+            }
+        }
+        dequan::VarId zero = csp.AddFixedVar(0);
+        dequan::VarId two = csp.AddFixedVar(2);
+        csp.AddConstraint(dequan::LinearConstraint({ qvars[0], zero, two }, { 1, 5, 1 }, dequan::OpConstraint::Op::SupEqual, 3));
+        csp.AddConstraint(dequan::OpConstraint(qvars[0], zero, dequan::OpConstraint::Op::NotEqual, 0));
+        dequan::VarId copy = qvars[num_queen - 1];
+        for (int c_idx = 0; c_idx < 3; c_idx++)
+        {
+            dequan::VarId next_copy = csp.AddIntVar(0, num_queen);
+            csp.AddConstraint(dequan::EqualityConstraint(next_copy, copy));
+            copy = next_copy;
+        }
+        csp.AddConstraint(dequan::OpConstraint(copy, qvars[0], dequan::OpConstraint::Op::NotEqual, 0));
+        csp.AddConstraint(dequan::OpConstraint(copy, qvars[1], dequan::OpConstraint::Op::Inf, num_queen + 1));
+        csp.FinalizeModel(presolve);
+    };
+    auto CountEnabled = [](const dequan::CSP& csp)
+    {
+        int enabled_count = 0;
+        for (int c_idx = 0; c_idx < (int)csp.constraints.size(); c_idx++)
+        {
+            enabled_count += csp.IsConstraintEnabled(c_idx) ? 1 : 0;
+        }
+        return enabled_count;
+    };
+
+    dequan::CSP csp;
+    BuildQueens(csp, false);
+    dequan::Assignment a;
+    a.Reset(csp);
+    unsigned long long expected_count = csp.CountSolutions(a);
+
+    dequan::CSP presolved_csp;
+    BuildQueens(presolved_csp, true);
+    const dequan::PresolveStats& stats = presolved_csp.presolve_stats;
+    dequan::Assignment presolved_a;
+    presolved_a.Reset(presolved_csp);
+    unsigned long long count = presolved_csp.CountSolutions(presolved_a);
+    unsigned long long search_nodes = presolved_a.search_nodes;
+    int enabled_count = CountEnabled(presolved_csp);
+    bool success = count == expected_count && expected_count > 0 && search_nodes <= a.search_nodes && !stats.infeasible
+        && stats.aliased_vars == 3 && stats.substituted_terms == 2 && stats.merged_constraints == num_queen * (num_queen - 1) / 2 + 1
+        && stats.entailed_constraints == 4 && enabled_count < CountEnabled(csp) && presolved_csp.domains[0].Min() == 1;
+
+    // Solutions of the presolved model are solutions of the original one
+    presolved_a.Reset(presolved_csp);
+    while (success && presolved_csp.Solve(presolved_a) == dequan::SearchStatus::Solved)
+    {
+        for (int c_idx = 0; success && c_idx < (int)csp.constraints.size(); c_idx++)
+        {
+            int first_link = csp.constraint_vars_offsets[c_idx];
+            success = csp.constraints[c_idx]->Evaluate(presolved_a.inst_vars, csp.constraint_vars[first_link], 0) == dequan::Constraint::Eval::Passed;
+        }
+    }
+
+    // A chain of equalities between two different constants is caught by the root propagation
+    dequan::CSP infeasible_csp;
+    dequan::VarId v0 = infeasible_csp.AddFixedVar(0);
+    dequan::VarId v1 = infeasible_csp.AddIntVar(0, 4);
+    dequan::VarId v2 = infeasible_csp.AddFixedVar(1);
+    infeasible_csp.AddConstraint(dequan::EqualityConstraint(v0, v1));
+    infeasible_csp.AddConstraint(dequan::EqualityConstraint(v2, v1));
+    infeasible_csp.FinalizeModel(true);
+    dequan::Assignment infeasible_a;
+    infeasible_a.Reset(infeasible_csp);
+    success = success && infeasible_csp.presolve_stats.infeasible && infeasible_csp.CountSolutions(infeasible_a) == 0;
+
+    // User constraints that are only applied on assignments are left to the search
+    dequan::CSP user_csp;
+    dequan::VarId x = user_csp.AddIntVar(0, 3);
+    dequan::VarId y = user_csp.AddIntVar(0, 3);
+    user_csp.AddConstraint(AssignedCopyConstraint(x, y));
+    user_csp.FinalizeModel(true);
+    dequan::Assignment user_a;
+    user_a.Reset(user_csp);
+    success = success && !user_csp.presolve_stats.infeasible && user_csp.IsConstraintEnabled(0) && user_csp.CountSolutions(user_a) == 3;
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\n" << enabled_count << " of " << presolved_csp.constraints.size() << " constraints enabled, "
+        << search_nodes << " nodes, " << a.search_nodes << " without presolve.\n";
+
+    return success;
+}
+bool SerializationTest(const int num_queen)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens serialization test : ";
+
+    // One constraint of each built-in kind, some of them added or disabled after FinalizeModel()
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> qvars;
+    BuildNQueens(csp, num_queen, qvars);
+    dequan::VarId extra_var = csp.AddIntVar(dequan::Domain(dequan::DomainType::Values, { 9, -5, 3 }));
+    dequan::VarId wide_var = csp.AddIntVar(-1000, 1000);
+    csp.domains[wide_var].Exclude(-500);
+    csp.AddConstraint(dequan::AllDifferentConstraint(qvars, dequan::AllDifferentConstraint::Filtering::Domain));
+    csp.AddConstraint(dequan::LinearConstraint({ qvars[0], qvars[1] }, { 1, 1 }, dequan::OpConstraint::Op::Inf, num_queen));
+    csp.AddConstraint(dequan::OrRangeConstraint(extra_var, qvars[2], 0, 4));
+    csp.AddConstraint(dequan::EqualityConstraint(wide_var, qvars[3]));
+    csp.AddConstraint(dequan::CombinedEqualityConstraint(wide_var, qvars[3], qvars[4], qvars[4]));
+    csp.AddConstraint(dequan::OrEqualityConstraint(wide_var, qvars[5], qvars[3]));
+    csp.FinalizeModel();
+    dequan::Array<int> tuples;
+    for (int a = 0; a < num_queen; a++)
+    {
+        for (int b = 0; b < num_queen; b++)
+        {
+            if ((a + b) % 3 != 0)
+            {
+                tuples.push_back(a);
+                tuples.push_back(b);
+            }
+        }
+    }
+    csp.AddConstraint(dequan::TableConstraint({ qvars[0], qvars[num_queen - 1] }, tuples));
+    csp.AddConstraint(dequan::LexConstraint({ qvars[1], qvars[2] }, { qvars[num_queen - 1], qvars[num_queen - 2] }, true, -1, num_queen - 1));
+    csp.AddConstraint(dequan::OpConstraint(qvars[0], qvars[1], dequan::OpConstraint::Op::Equal, 0));
+    csp.DisableConstraint((int)csp.constraints.size() - 1);
+
+    dequan::Assignment a;
+    a.Reset(csp);
+    unsigned long long expected_count = csp.CountSolutions(a);
+
+    dequan::Array<unsigned char> bytes;
+    bool success = csp.SaveModel(bytes) && expected_count > 0;
+
+    // Load from a file mapping, the search must be the same
+    const char* path = "dequan_serialization_test.bin";
+    FILE* file = fopen(path, "wb");
+    success = success && file != nullptr && fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    if (file != nullptr)
+    {
+        fclose(file);
+    }
+    dequan::MappedFile mapping;
+    dequan::CSP loaded_csp;
+    success = success && mapping.Open(path) && loaded_csp.LoadModel(mapping.GetData(), mapping.GetSize());
+    unsigned long long loaded_count = 0;
+    if (success)
+    {
+        dequan::Assignment loaded_a;
+        loaded_a.Reset(loaded_csp);
+        loaded_count = loaded_csp.CountSolutions(loaded_a);
+        success = loaded_count == expected_count && loaded_a.search_nodes == a.search_nodes && !loaded_csp.IsConstraintEnabled((int)loaded_csp.constraints.size() - 1);
+
+        // Domain values and payloads are referenced in the mapping, copies of them own their values
+        const unsigned char* image = (const unsigned char*)mapping.GetData();
+        auto InImage = [&](const void* ptr) { return (const unsigned char*)ptr >= image && (const unsigned char*)ptr < image + mapping.GetSize(); };
+        const dequan::Domain& extra_dom = loaded_csp.domains[extra_var];
+        success = success && extra_dom.values.IsReferenced() && InImage(extra_dom.values.begin()) && InImage(loaded_csp.alldiff_constraints[0].alldiff_vars.begin())
+            && InImage(loaded_csp.linear_constraints[0].coefs.begin()) && InImage(loaded_csp.table_constraints[0].supports.begin())
+            && InImage(loaded_csp.lex_constraints[0].vars1.begin());
+        dequan::Domain copied_dom = extra_dom;
+        success = success && !copied_dom.values.IsReferenced() && copied_dom.values.Size() == extra_dom.values.Size() && !InImage(copied_dom.values.begin());
+
+        // A loaded model can be saved again and edited like any finalized model, without writing to the read-only mapping
+        dequan::Array<unsigned char> saved_again;
+        success = success && loaded_csp.SaveModel(saved_again) && saved_again == bytes;
+        loaded_csp.domains[wide_var].Exclude(0);
+        success = success && !loaded_csp.domains[wide_var].values.IsReferenced() && !loaded_csp.domains[wide_var].Contains(0) && loaded_csp.domains[wide_var].Contains(1);
+        loaded_csp.EnableConstraint((int)loaded_csp.constraints.size() - 1);
+        loaded_a.Reset(loaded_csp);
+        success = success && loaded_csp.CountSolutions(loaded_a) == 0;
+    }
+    mapping.Close();
+    remove(path);
+
+    // Truncated or foreign images are rejected, user constraints can't be saved
+    success = success && !loaded_csp.LoadModel(bytes.data(), bytes.size() - 8) && loaded_csp.vars.size() == 0;
+    dequan::Array<unsigned char> bad_version = bytes;
+    bad_version[4]++;
+    success = success && !loaded_csp.LoadModel(bad_version.data(), bad_version.size());
+
+    // So are domain records whose values are not sorted or whose bitset overflows
+    auto LoadsCorrupted = [&](dequan::VarId vid, int corruption)
+    {
+        dequan::Array<unsigned char> corrupted = bytes;
+        const dequan::ModelFileHeader& header = *(const dequan::ModelFileHeader*)corrupted.data();
+        dequan::ModelDomainRecord& record = ((dequan::ModelDomainRecord*)(corrupted.data() + header.section_offsets[dequan::MODEL_SECTION_DOMAINS]))[vid];
+        int* values = (int*)(corrupted.data() + header.section_offsets[dequan::MODEL_SECTION_INTS]) + record.values_offset;
+        switch (corruption)
+        {
+        case 0: std::swap(values[0], values[1]); break;
+        case 1: record.values_count--; break;
+        case 2: values[1] = values[0]; break;
+        case 3: values[2] = values[1]; break;
+        default: record.bits_min = INT_MAX - 32; break;
+        }
+        return loaded_csp.LoadModel(corrupted.data(), corrupted.size()) || loaded_csp.vars.size() != 0;
+    };
+    success = success && !LoadsCorrupted(extra_var, 0) && !LoadsCorrupted(wide_var, 1) && !LoadsCorrupted(wide_var, 2)
+        && !LoadsCorrupted(wide_var, 3) && !LoadsCorrupted(qvars[0], 4);
+    dequan::CSP user_csp;
+    user_csp.AddIntVar(0, 2);
+    user_csp.AddIntVar(0, 2);
+    user_csp.AddConstraint(PaddedNotEqualConstraint(0, 1));
+    user_csp.FinalizeModel();
+    dequan::Array<unsigned char> user_bytes;
+    success = success && !user_csp.SaveModel(user_bytes);
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\n" << bytes.size() << " bytes, " << loaded_count << " solutions.\n";
+
+    return success;
+}
+
+bool DomainFilteringTest(const int iteration_count)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << iteration_count << "-iterations domain filtering test : ";
+
+    // Random sequences of filterings on wide domains of each type, checked against a plain set of values
+    dequan::Random random(7);
+    auto RandomValue = [&random]() -> int { return (int)random.Next(4000) - 2000; };
+    bool success = true;
+    unsigned long long op_count = 0;
+    for (int it_idx = 0; it_idx < iteration_count && success; it_idx++)
+    {
+        std::set<int> expected;
+        dequan::Domain dom;
+        int dom_type = it_idx % 3;
+        if (dom_type == 0)
+        {
+            for (int v_idx = 0; v_idx < 3000; v_idx++)
+            {
+                expected.insert(RandomValue());
+            }
+            dom = dequan::Domain(dequan::DomainType::Values, dequan::Array<int>(expected.begin(), expected.end()));
+        }
+        else if (dom_type == 1)
+        {
+            dequan::Array<int> ranges;
+            for (int start = -2000; start < 2000; start += 5 + (int)random.Next(40))
+            {
+                int end = start + 1 + (int)random.Next(4);
+                ranges.push_back(start);
+                ranges.push_back(end);
+                for (int val = start; val < end; val++)
+                {
+                    expected.insert(val);
+                }
+            }
+            dom = dequan::Domain(dequan::DomainType::Ranges, ranges);
+        }
+        else
+        {
+            int min_val = RandomValue() / 10;
+            dom = dequan::Domain::MakeBitset(min_val, min_val + 256);
+            for (int val = min_val; val < min_val + 256; val++)
+            {
+                expected.insert(val);
+            }
+        }
+
+        while (success && !expected.empty())
+        {
+            int val0 = RandomValue() / (dom_type == 2 ? 10 : 1), val1 = val0 + (int)random.Next(dom_type == 2 ? 60 : 1500);
+            switch (random.Next(6))
+            {
+            case 0:
+                dom.ExcludeSup(val1);
+                expected.erase(expected.lower_bound(val1), expected.end());
+                break;
+            case 1:
+                dom.ExcludeInf(val0);
+                expected.erase(expected.begin(), expected.lower_bound(val0));
+                break;
+            case 2:
+                dom.IntersectRange(val0, val1);
+                expected.erase(expected.lower_bound(val1), expected.end());
+                expected.erase(expected.begin(), expected.lower_bound(val0));
+                break;
+            case 3:
+            {
+                // Keep two existing values, or one and a random one
+                int kept = *std::next(expected.begin(), random.Next((unsigned int)expected.size()));
+                dom.Intersect(val1, kept);
+                std::set<int> kept_values;
+                kept_values.insert(kept);
+                if (expected.count(val1))
+                {
+                    kept_values.insert(val1);
+                }
+                expected = kept_values;
+                break;
+            }
+            case 4:
+            {
+                int removed = *std::next(expected.begin(), random.Next((unsigned int)expected.size()));
+                dom.Exclude(removed);
+                expected.erase(removed);
+                break;
+            }
+            default:
+                dom.Exclude(val0);
+                expected.erase(val0);
+                break;
+            }
+            op_count++;
+
+            dequan::Array<int> dom_values;
+            int val = INT_MIN;
+            while (dom.NextValue(val, val))
+            {
+                dom_values.push_back(val);
+            }
+            success = dom_values == dequan::Array<int>(expected.begin(), expected.end()) && dom.Size() == (int)expected.size() && dom.IsEmpty() == expected.empty()
+                && (expected.empty() || (dom.Min() == *expected.begin() && dom.Max() == *expected.rbegin() && dom.Contains(*expected.begin()) && !dom.Contains(*expected.begin() - 1)))
+                && dom.Contains(val0) == (expected.count(val0) > 0);
+        }
+    }
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\nchecked " << op_count << " filterings.\n";
+
+    return success;
+}
+
+bool TrailTest(const int iteration_count)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << iteration_count << "-iterations trail test : ";
+
+    // Wide domains of each type filtered through the Assignment helpers in nested steps, each step restore is checked against the values before it
+    dequan::Random random(11);
+    dequan::CSP csp;
+    dequan::Array<int> wide_values;
+    for (int val = -3000; val < 3000; val += 2)
+    {
+        wide_values.push_back(val);
+    }
+    csp.AddIntVar(dequan::Domain(dequan::DomainType::Values, wide_values));
+    csp.AddIntVar(dequan::Domain(dequan::DomainType::Ranges, { -3000, -2000, -1000, 1000, 1500, 3000 }));
+    csp.AddIntVar(0, 256);
+    csp.FinalizeModel();
+    dequan::Assignment a;
+    a.Reset(csp);
+
+    auto GetValues = [&a](dequan::VarId vid)
+    {
+        std::vector<int> values;
+        int val = INT_MIN;
+        while (a.current_domains[vid].NextValue(val, val))
+        {
+            values.push_back(val);
+        }
+        return values;
+    };
+    // Excluding a value of a value-list domain only backs up that value, and the bound cuts of a range domain only the dropped range and the cut bound
+    a.PushSavedDomainStep();
+    size_t pool_size = a.trail_values.size();
+    bool success = a.ExcludeVar(0, 0) && a.trail_values.size() == pool_size + 1 && a.ExcludeVarInf(1, -1500) && a.trail_values.size() == pool_size + 3
+        && a.ExcludeVarSup(1, 2000) && a.trail_values.size() == pool_size + 4;
+    a.PopSavedDomainStep();
+    success = success && GetValues(0).size() == wide_values.size() && a.current_domains[1].values.Size() == 6 && a.current_domains[1].Min() == -3000
+        && a.current_domains[1].Max() == 2999;
+
+    std::vector<std::vector<std::vector<int>>> saved_values;
+    unsigned long long op_count = 0;
+    for (int it_idx = 0; it_idx < iteration_count && success; it_idx++)
+    {
+        unsigned int action = random.Next(10);
+        if ((action == 0 && saved_values.size() < 8) || saved_values.empty())
+        {
+            saved_values.push_back({ GetValues(0), GetValues(1), GetValues(2) });
+            a.PushSavedDomainStep();
+            continue;
+        }
+        if (action == 1)
+        {
+            a.PopSavedDomainStep();
+            for (dequan::VarId vid = 0; vid < 3; vid++)
+            {
+                success = success && GetValues(vid) == saved_values.back()[vid];
+            }
+            saved_values.pop_back();
+            continue;
+        }
+        dequan::VarId vid = (dequan::VarId)random.Next(3);
+        std::vector<int> values = GetValues(vid);
+        if (values.empty())
+        {
+            continue;
+        }
+        int val = values[random.Next((unsigned int)values.size())];
+        switch (action % 5)
+        {
+        case 0:
+            a.ExcludeVarInf(vid, val);
+            values.erase(values.begin(), std::lower_bound(values.begin(), values.end(), val));
+            break;
+        case 1:
+            a.ExcludeVarSup(vid, val + 1);
+            values.erase(std::upper_bound(values.begin(), values.end(), val), values.end());
+            break;
+        case 2:
+            if (random.Next(4) == 0)
+            {
+                a.IntersectVar(vid, val);
+                values = { val };
+            }
+            else
+            {
+                // Keep one value out of two
+                std::vector<int> kept;
+                for (size_t v_idx = random.Next(2); v_idx < values.size(); v_idx += 2)
+                {
+                    kept.push_back(values[v_idx]);
+                }
+                a.IntersectVarValues(vid, kept.empty() ? nullptr : &kept[0], (int)kept.size());
+                values = kept;
+            }
+            break;
+        case 3:
+            // Like a user constraint, the whole domain is backed up
+            a.EnsureSavedDomain(vid, a.current_domains[vid]);
+            a.current_domains[vid].Exclude(val);
+            values.erase(std::lower_bound(values.begin(), values.end(), val));
+            break;
+        default:
+            a.ExcludeVar(vid, val);
+            values.erase(std::lower_bound(values.begin(), values.end(), val));
+            break;
+        }
+        a.ClearDomainEvents();
+        op_count++;
+        success = GetValues(vid) == values;
+    }
+    while (success && !saved_values.empty())
+    {
+        a.PopSavedDomainStep();
+        for (dequan::VarId vid = 0; vid < 3; vid++)
+        {
+            success = success && GetValues(vid) == saved_values.back()[vid];
+        }
+        saved_values.pop_back();
+    }
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\nchecked " << op_count << " filterings.\n";
+
+    return success;
+}
+
+bool PropagationFixpointTest(const int num_vars)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_vars << "-chain propagation fixpoint test : ";
+
+    // v0 > v1 > ... > vn-1, all in [0, n): the only solution is vi = n - 1 - i.
+    // Smallest values are tried first, so each wrong value of v0 must be refuted by propagation along the whole chain.
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> vars;
+    vars.resize(num_vars);
+
+    for (int i = 0; i < num_vars; i++)
+    {
+        vars[i] = csp.AddIntVar(0, num_vars);
+    }
+    for (int i = 0; i + 1 < num_vars; i++)
+    {
+        csp.AddConstraint(dequan::OpConstraint(vars[i], vars[i + 1], dequan::OpConstraint::Op::Sup, 0));
+    }
+    csp.FinalizeModel();
+
+    dequan::Assignment a;
+    a.Reset(csp);
+    bool success = csp.Solve(a) == dequan::SearchStatus::Solved;
+    for (int i = 0; success && i < num_vars; i++)
+    {
+        success = a.GetInstVarValue(vars[i]) == num_vars - 1 - i;
+    }
+    // One node per value of v0, then the remaining vars are already fixed
+    success = success && a.search_nodes == (unsigned long long)(2 * num_vars - 1);
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\nsolved in " << a.search_nodes << " nodes.\n";
+
+    return success;
+}
+bool AllDifferentFilteringTest(const int num_queen, dequan::AllDifferentConstraint::Filtering filtering)
+{
+    const char* filtering_names[] = { "value", "bounds", "domain" };
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens " << filtering_names[(int)filtering] << " alldiff test : ";
+
+    // Queens on distinct rows and diagonals, diagonals are auxiliary vars equal to row +/- col
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> qvars, diag0_vars, diag1_vars;
+    qvars.resize(num_queen);
+    diag0_vars.resize(num_queen);
+    diag1_vars.resize(num_queen);
+
+    for (int i = 0; i < num_queen; i++)
+    {
+        qvars[i] = csp.AddIntVar(0, num_queen);
+        diag0_vars[i] = csp.AddIntVar(i, num_queen + i);
+        diag1_vars[i] = csp.AddIntVar(-i, num_queen - i);
+        csp.AddConstraint(dequan::OpConstraint(diag0_vars[i], qvars[i], dequan::OpConstraint::Op::Equal, i));
+        csp.AddConstraint(dequan::OpConstraint(diag1_vars[i], qvars[i], dequan::OpConstraint::Op::Equal, -i));
+    }
+    csp.AddConstraint(dequan::AllDifferentConstraint(qvars, filtering));
+    csp.AddConstraint(dequan::AllDifferentConstraint(diag0_vars, filtering));
+    csp.AddConstraint(dequan::AllDifferentConstraint(diag1_vars, filtering));
+    csp.FinalizeModel();
+
+    dequan::Assignment a;
+    a.params.var_heuristic = dequan::VarHeuristic::Dom;
+    a.Reset(csp);
+    bool success = csp.Solve(a) == dequan::SearchStatus::Solved;
+    for (int i = 0; success && i < num_queen; i++)
+    {
+        for (int j = i + 1; success && j < num_queen; j++)
+        {
+            int qi = a.GetInstVarValue(qvars[i]), qj = a.GetInstVarValue(qvars[j]);
+            success = qi != qj && qi + i != qj + j && qi - i != qj - j;
+        }
+    }
+    unsigned long long solve_nodes = a.search_nodes;
+
+    // Pigeonhole: one more var than values, the matching or Hall intervals prove it on the first propagation
+    dequan::CSP pigeon_csp;
+    dequan::Array<dequan::VarId> pigeon_vars;
+    for (int i = 0; i <= num_queen; i++)
+    {
+        pigeon_vars.push_back(pigeon_csp.AddIntVar(0, num_queen));
+    }
+    pigeon_csp.AddConstraint(dequan::AllDifferentConstraint(pigeon_vars, filtering));
+    pigeon_csp.FinalizeModel();
+
+    dequan::Assignment pigeon_a;
+    pigeon_a.Reset(pigeon_csp);
+    dequan::SearchBudget budget;
+    budget.max_nodes = 100000;
+    dequan::SearchStatus pigeon_status = pigeon_csp.Solve(pigeon_a, budget);
+    if (filtering == dequan::AllDifferentConstraint::Filtering::Value)
+    {
+        success = success && pigeon_status != dequan::SearchStatus::Solved;
+    }
+    else
+    {
+        success = success && pigeon_status == dequan::SearchStatus::Infeasible && pigeon_a.search_nodes == (unsigned long long)num_queen;
+    }
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\nsolved in " << solve_nodes << " nodes, pigeonhole in " << pigeon_a.search_nodes << " nodes.\n";
+
+    return success;
+}
+bool CountSolutionsTest(const int num_queen, const unsigned long long expected_count)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens count solutions test : ";
+
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> qvars;
+    BuildNQueens(csp, num_queen, qvars);
+    csp.FinalizeModel();
+
+    dequan::Assignment a;
+    a.Reset(csp);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    unsigned long long count = csp.CountSolutions(a);
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    // Stream the first solutions and check that they come in lexicographic order, hence are all different
+    a.Reset(csp);
+    dequan::Array<long long> first_rows;
+    unsigned long long streamed_count = csp.EnumerateSolutions(a,
+        [&first_rows, &qvars](const dequan::Array<dequan::InstVar>& inst_vars) -> bool
+        {
+            long long rows = 0;
+            for (int col_idx = 0; col_idx < (int)qvars.size(); col_idx++)
+            {
+                rows = rows * qvars.size() + inst_vars[qvars[col_idx]].value;
+            }
+            first_rows.push_back(rows);
+            return true;
+        }, 10);
+
+    // Count again with a parallel tree search
+    dequan::Array<dequan::Assignment> assignments;
+    assignments.resize(4);
+    unsigned long long parallel_count = csp.CountSolutionsParallel(assignments);
+
+    bool success = count == expected_count && parallel_count == expected_count && streamed_count == 10;
+    for (int s_idx = 1; success && s_idx < (int)first_rows.size(); s_idx++)
+    {
+        success = first_rows[s_idx - 1] < first_rows[s_idx];
+    }
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\nsolutions: " << count;
+
+    std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
+    std::cout << "\nCountSolutions took " << time_span.count() << " seconds.\n";
+
+    return success;
+}
+bool SymmetryTest(const int num_queen)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens symmetry breaking test : ";
+
+    auto BuildQueens = [num_queen](dequan::CSP& csp, dequan::Array<dequan::VarId>& qvars)
+    {
+        BuildNQueens(csp, num_queen, qvars);
+        csp.AddConstraint(dequan::AllDifferentConstraint(qvars));
+    };
+
+    // Reference: solutions that are lexicographically lowest among their images by the mirrors and the half turn
+    auto IsLeader = [num_queen](const dequan::Array<dequan::InstVar>& inst_vars, const dequan::Array<dequan::VarId>& qvars)
+    {
+        for (int s_idx = 1; s_idx < 4; s_idx++)
+        {
+            for (int i = 0; i < num_queen; i++)
+            {
+                int val = inst_vars[qvars[i]].value;
+                int image = inst_vars[qvars[(s_idx & 1) ? num_queen - 1 - i : i]].value;
+                image = (s_idx & 2) ? num_queen - 1 - image : image;
+                if (val != image)
+                {
+                    if (val > image)
+                    {
+                        return false;
+                    }
+                    break;
+                }
+            }
+        }
+        return true;
+    };
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> qvars;
+    BuildQueens(csp, qvars);
+    csp.FinalizeModel();
+    dequan::Assignment a;
+    a.Reset(csp);
+    unsigned long long all_count = 0, expected_count = 0;
+    csp.EnumerateSolutions(a,
+        [&](const dequan::Array<dequan::InstVar>& inst_vars) -> bool
+        {
+            all_count++;
+            expected_count += IsLeader(inst_vars, qvars) ? 1 : 0;
+            return true;
+        });
+
+    // Vertical mirror, horizontal mirror and half turn, the last ones added after FinalizeModel()
+    dequan::CSP sym_csp;
+    dequan::Array<dequan::VarId> sym_qvars;
+    BuildQueens(sym_csp, sym_qvars);
+    dequan::Array<dequan::VarId> mirrored(sym_qvars.rbegin(), sym_qvars.rend());
+    bool success = sym_csp.AddVarSymmetry(sym_qvars, mirrored);
+    sym_csp.FinalizeModel();
+    success = success && sym_csp.AddVarSymmetry(sym_qvars, sym_qvars, true, num_queen - 1) && sym_csp.AddVarSymmetry(sym_qvars, mirrored, true, num_queen - 1);
+    success = success && !sym_csp.AddVarSymmetry(sym_qvars, { sym_qvars[0] }) && !sym_csp.AddVarSymmetry({ sym_qvars[0], sym_qvars[1] }, { sym_qvars[0], sym_qvars[0] });
+    dequan::Assignment sym_a;
+    sym_a.Reset(sym_csp);
+    unsigned long long sym_count = sym_csp.CountSolutions(sym_a);
+    sym_a.Reset(sym_csp);
+    unsigned long long leader_count = sym_csp.EnumerateSolutions(sym_a,
+        [&](const dequan::Array<dequan::InstVar>& inst_vars) -> bool
+        {
+            success = success && IsLeader(inst_vars, sym_qvars);
+            return true;
+        });
+    success = success && sym_count == expected_count && leader_count == expected_count && sym_count < all_count;
+
+    // Interchangeable vars: multisets, then subsets when they are all different
+    const int var_count = 4, domain_size = 6;
+    for (int d_idx = 0; d_idx < 2; d_idx++)
+    {
+        dequan::CSP set_csp;
+        dequan::Array<dequan::VarId> set_vars;
+        for (int i = 0; i < var_count; i++)
+        {
+            set_vars.push_back(set_csp.AddIntVar(0, domain_size));
+        }
+        if (d_idx == 1)
+        {
+            set_csp.AddConstraint(dequan::AllDifferentConstraint(set_vars));
+        }
+        set_csp.AddInterchangeableVars({ set_vars[2], set_vars[0], set_vars[3], set_vars[1] }, d_idx == 1);
+        set_csp.FinalizeModel();
+        dequan::Assignment set_a;
+        set_a.Reset(set_csp);
+        success = success && set_csp.CountSolutions(set_a) == (d_idx == 0 ? 126ull : 15ull);
+    }
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\n" << sym_count << " of " << all_count << " solutions, " << sym_a.search_nodes << " nodes.\n";
+
+    return success;
+}
+bool LinearConstraintTest(const int num_vars, const int domain_size)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_vars << "-terms linear constraint test : ";
+
+    // Count the solutions of a signed linear sum for every operator, and compare with a brute force enumeration
+    const int coef_pattern[] = { 3, -2, 5, 1, -4, 0, 2 };
+    dequan::Array<int> coefs;
+    coefs.resize(num_vars);
+    for (int i = 0; i < num_vars; i++)
+    {
+        coefs[i] = coef_pattern[i % 7];
+    }
+    const int rhs = 4;
+
+    const dequan::OpConstraint::Op ops[] = { dequan::OpConstraint::Op::Equal, dequan::OpConstraint::Op::NotEqual,
+        dequan::OpConstraint::Op::Sup, dequan::OpConstraint::Op::SupEqual, dequan::OpConstraint::Op::Inf, dequan::OpConstraint::Op::InfEqual };
+
+    bool success = true;
+    for (dequan::OpConstraint::Op op : ops)
+    {
+        dequan::CSP csp;
+        dequan::Array<dequan::VarId> vars;
+        vars.resize(num_vars);
+        for (int i = 0; i < num_vars; i++)
+        {
+            vars[i] = csp.AddIntVar(0, domain_size);
+        }
+        csp.AddConstraint(dequan::LinearConstraint(vars, coefs, op, rhs));
+        csp.FinalizeModel();
+
+        dequan::Assignment a;
+        a.Reset(csp);
+        unsigned long long count = csp.CountSolutions(a);
+
+        unsigned long long expected_count = 0;
+        dequan::Array<int> values;
+        values.resize(num_vars, 0);
+        while (true)
+        {
+            long long sum = 0;
+            for (int i = 0; i < num_vars; i++)
+            {
+                sum += coefs[i] * values[i];
+            }
+            switch (op)
+            {
+            case dequan::OpConstraint::Op::Equal:       expected_count += sum == rhs; break;
+            case dequan::OpConstraint::Op::NotEqual:    expected_count += sum != rhs; break;
+            case dequan::OpConstraint::Op::Sup:         expected_count += sum > rhs; break;
+            case dequan::OpConstraint::Op::SupEqual:    expected_count += sum >= rhs; break;
+            case dequan::OpConstraint::Op::Inf:         expected_count += sum < rhs; break;
+            case dequan::OpConstraint::Op::InfEqual:    expected_count += sum <= rhs; break;
+            }
+            int i = 0;
+            while (i < num_vars && ++values[i] == domain_size)
+            {
+                values[i++] = 0;
+            }
+            if (i == num_vars)
+            {
+                break;
+            }
+        }
+
+        success = success && count == expected_count;
+    }
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+
+    return success;
+}
+bool TableConstraintTest(const int num_vars, const int domain_size)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_vars << "-vars table constraint test : ";
+
+    // Each triple of consecutive vars (a, b, c) must satisfy (a + 2b + 3c) % 5 == 0 and a != c, given as allowed tuples
+    auto IsAllowed = [](int a, int b, int c) -> bool { return (a + 2 * b + 3 * c) % 5 == 0 && a != c; };
+    dequan::Array<int> tuples;
+    for (int a = 0; a < domain_size; a++)
+    {
+        for (int b = 0; b < domain_size; b++)
+        {
+            for (int c = 0; c < domain_size; c++)
+            {
+                if (IsAllowed(a, b, c))
+                {
+                    tuples.push_back(a);
+                    tuples.push_back(b);
+                    tuples.push_back(c);
+                }
+            }
+        }
+    }
+
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> vars;
+    vars.resize(num_vars);
+    for (int i = 0; i < num_vars; i++)
+    {
+        vars[i] = csp.AddIntVar(0, domain_size);
+    }
+    for (int i = 0; i + 2 < num_vars; i++)
+    {
+        csp.AddConstraint(dequan::TableConstraint({ vars[i], vars[i + 1], vars[i + 2] }, tuples));
+    }
+    csp.FinalizeModel();
+
+    dequan::Assignment a;
+    a.Reset(csp);
+    unsigned long long count = csp.CountSolutions(a);
+
+    unsigned long long expected_count = 0;
+    dequan::Array<int> values;
+    values.resize(num_vars, 0);
+    while (true)
+    {
+        bool allowed = true;
+        for (int i = 0; i + 2 < num_vars && allowed; i++)
+        {
+            allowed = IsAllowed(values[i], values[i + 1], values[i + 2]);
+        }
+        expected_count += allowed;
+        int i = 0;
+        while (i < num_vars && ++values[i] == domain_size)
+        {
+            values[i++] = 0;
+        }
+        if (i == num_vars)
+        {
+            break;
+        }
+    }
+
+    bool success = count == expected_count;
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\nsolutions: " << count << ", " << a.search_nodes << " nodes.\n";
+
+    return success;
+}
+bool OptimizeTest(const int num_items)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_items << "-items knapsack optimize test : ";
+
+    // 0/1 knapsack: maximize the total profit under a capacity, and minimize the weight reaching a profit target
+    dequan::Array<int> weights, profits;
+    for (int i = 0; i < num_items; i++)
+    {
+        weights.push_back(3 + (i * 7) % 11);
+        profits.push_back(2 + (i * 5) % 13);
+    }
+    int total_weight = 0, total_profit = 0;
+    for (int i = 0; i < num_items; i++)
+    {
+        total_weight += weights[i];
+        total_profit += profits[i];
+    }
+    const int capacity = total_weight / 3;
+    const int profit_target = total_profit / 2;
+
+    // Brute force optima
+    int best_profit = -1, best_weight = INT_MAX;
+    for (int mask = 0; mask < (1 << num_items); mask++)
+    {
+        int weight = 0, profit = 0;
+        for (int i = 0; i < num_items; i++)
+        {
+            if (mask & (1 << i))
+            {
+                weight += weights[i];
+                profit += profits[i];
+            }
+        }
+        if (weight <= capacity && profit > best_profit)
+        {
+            best_profit = profit;
+        }
+        if (profit >= profit_target && weight < best_weight)
+        {
+            best_weight = weight;
+        }
+    }
+
+    bool success = true;
+    unsigned long long total_nodes = 0;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const bool maximize_profit = pass == 0;
+        dequan::CSP csp;
+        dequan::Array<dequan::VarId> item_vars;
+        for (int i = 0; i < num_items; i++)
+        {
+            item_vars.push_back(csp.AddBoolVar());
+        }
+        dequan::VarId objective_var = csp.AddIntVar(0, (maximize_profit ? total_profit : total_weight) + 1);
+
+        // objective == sum of the objective terms, and the other sum is constrained
+        dequan::Array<dequan::VarId> sum_vars = item_vars;
+        sum_vars.push_back(objective_var);
+        dequan::Array<int> objective_coefs = maximize_profit ? profits : weights;
+        objective_coefs.push_back(-1);
+        csp.AddConstraint(dequan::LinearConstraint(sum_vars, objective_coefs, dequan::OpConstraint::Op::Equal, 0));
+        if (maximize_profit)
+        {
+            csp.AddConstraint(dequan::LinearConstraint(item_vars, weights, dequan::OpConstraint::Op::InfEqual, capacity));
+        }
+        else
+        {
+            csp.AddConstraint(dequan::LinearConstraint(item_vars, profits, dequan::OpConstraint::Op::SupEqual, profit_target));
+        }
+        csp.FinalizeModel();
+
+        dequan::Assignment a;
+        a.Reset(csp);
+        int incumbent_count = 0;
+        int last_value = maximize_profit ? -1 : INT_MAX;
+        bool improving = true;
+        dequan::SearchStatus status = csp.Optimize(a, objective_var, maximize_profit ? dequan::ObjectiveSense::Maximize : dequan::ObjectiveSense::Minimize,
+            [&](const dequan::Array<dequan::InstVar>& solution) -> bool
+            {
+                int value = solution[objective_var].value;
+                improving = improving && (maximize_profit ? value > last_value : value < last_value);
+                last_value = value;
+                incumbent_count++;
+                return true;
+            });
+        int expected_value = maximize_profit ? best_profit : best_weight;
+        success = success && improving && status == dequan::SearchStatus::Solved && a.has_incumbent && a.incumbent_value == expected_value;
+        success = success && incumbent_count > 0 && last_value == expected_value;
+        total_nodes += a.search_nodes;
+
+        // Interrupted optimization keeps the incumbent and resumes to the same optimum
+        dequan::Assignment budget_a;
+        budget_a.Reset(csp);
+        dequan::SearchBudget budget;
+        budget.max_nodes = 5;
+        dequan::SearchStatus budget_status = dequan::SearchStatus::Paused;
+        int slice_count = 0;
+        while (budget_status == dequan::SearchStatus::Paused)
+        {
+            budget_status = csp.Optimize(budget_a, objective_var, maximize_profit ? dequan::ObjectiveSense::Maximize : dequan::ObjectiveSense::Minimize, budget);
+            slice_count++;
+        }
+        success = success && slice_count > 1 && budget_status == dequan::SearchStatus::Solved && budget_a.incumbent_value == expected_value;
+    }
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\nbest profit " << best_profit << ", best weight " << best_weight << ", " << total_nodes << " nodes.\n";
+
+    return success;
+}
+bool PortfolioTest(const int num_queen, const int num_thread)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens portfolio test : ";
+
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> qvars;
+    BuildNQueens(csp, num_queen, qvars);
+    csp.FinalizeModel();
+
+    dequan::Array<dequan::Assignment> assignments;
+    assignments.resize(num_thread);
+    for (int t_idx = 0; t_idx < num_thread; t_idx++)
+    {
+        assignments[t_idx].params = dequan::SearchParams::MakePortfolioParams(t_idx);
+    }
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    int winner_idx = -1;
+    dequan::SearchStatus status = csp.SolvePortfolio(assignments, winner_idx);
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    bool success = status == dequan::SearchStatus::Solved && winner_idx >= 0;
+    for (int i = 0; success && i < num_queen; i++)
+    {
+        for (int j = i + 1; success && j < num_queen; j++)
+        {
+            int qi = assignments[winner_idx].GetInstVarValue(qvars[i]);
+            int qj = assignments[winner_idx].GetInstVarValue(qvars[j]);
+            success = qi != qj && qi != qj + j - i && qi != qj + i - j;
+        }
+    }
+
+    // An external stop flag is forwarded to the workers, and doesn't change the search while it is not raised
+    std::atomic<bool> external_stop(false);
+    dequan::SearchBudget stop_budget;
+    stop_budget.stop_flag = &external_stop;
+    success = success && csp.SolvePortfolio(assignments, winner_idx, stop_budget) == dequan::SearchStatus::Solved && winner_idx >= 0;
+    const int num_holes = 11;
+    dequan::CSP pigeon_csp;
+    for (int p_idx = 0; p_idx <= num_holes; p_idx++)
+    {
+        pigeon_csp.AddIntVar(0, num_holes);
+    }
+    for (int p_idx = 0; p_idx <= num_holes; p_idx++)
+    {
+        for (int q_idx = p_idx + 1; q_idx <= num_holes; q_idx++)
+        {
+            pigeon_csp.AddConstraint(dequan::OpConstraint(p_idx, q_idx, dequan::OpConstraint::Op::NotEqual, 0));
+        }
+    }
+    pigeon_csp.FinalizeModel();
+    external_stop.store(true);
+    int cancelled_idx = 0;
+    success = success && pigeon_csp.SolvePortfolio(assignments, cancelled_idx, stop_budget) == dequan::SearchStatus::Cancelled && cancelled_idx == -1;
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\nwinner: " << winner_idx;
+
+    std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
+    std::cout << "\nSolvePortfolio took " << time_span.count() << " seconds.\n";
+
+    return success;
+}
+
+bool BatchSolveTest(const int num_queen, const int num_thread)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens batch solve test : ";
+
+    auto BuildQueens = [](dequan::CSP& csp, const int n)
+    {
+        dequan::Array<dequan::VarId> qvars;
+        BuildNQueens(csp, n, qvars);
+        csp.FinalizeModel();
+    };
+    dequan::CSP csp;
+    BuildQueens(csp, num_queen);
+
+    // One instance per position of the first two queens, many of them infeasible right away
+    dequan::Array<int> fixed_offsets;
+    dequan::Array<dequan::VarId> fixed_vars;
+    dequan::Array<int> fixed_values;
+    for (int row0 = 0; row0 < num_queen; row0++)
+    {
+        for (int row1 = 0; row1 < num_queen; row1++)
+        {
+            fixed_offsets.push_back((int)fixed_vars.size());
+            fixed_vars.push_back(0);
+            fixed_values.push_back(row0);
+            fixed_vars.push_back(1);
+            fixed_values.push_back(row1);
+        }
+    }
+    fixed_offsets.push_back((int)fixed_vars.size());
+    const int instance_count = (int)fixed_offsets.size() - 1;
+
+    dequan::Array<dequan::Assignment> assignments;
+    assignments.resize(num_thread);
+    for (int t_idx = 0; t_idx < num_thread; t_idx++)
+    {
+        assignments[t_idx].params.var_heuristic = dequan::VarHeuristic::Dom;
+    }
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    dequan::BatchResults results;
+    csp.SolveBatch(assignments, fixed_offsets, fixed_vars, fixed_values, results);
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    // Each instance is solved exactly like by a fresh assignment, whatever the thread and the instances solved before on it
+    bool success = (int)results.results.size() == instance_count;
+    int solved_count = 0;
+    unsigned long long total_nodes = 0;
+    for (int i_idx = 0; success && i_idx < instance_count; i_idx++)
+    {
+        dequan::Assignment ref_a;
+        ref_a.params.var_heuristic = dequan::VarHeuristic::Dom;
+        ref_a.Reset(csp);
+        for (int f_idx = fixed_offsets[i_idx]; f_idx < fixed_offsets[i_idx + 1]; f_idx++)
+        {
+            ref_a.FixVar(fixed_vars[f_idx], fixed_values[f_idx]);
+        }
+        dequan::SearchStatus ref_status = csp.Solve(ref_a);
+        const dequan::BatchResult& result = results.results[i_idx];
+        success = result.status == ref_status && result.search_nodes == ref_a.search_nodes;
+        for (int v_idx = 0; success && ref_status == dequan::SearchStatus::Solved && v_idx < num_queen; v_idx++)
+        {
+            success = results.values[result.values_offset + v_idx] == ref_a.GetInstVarValue(v_idx);
+        }
+        solved_count += result.status == dequan::SearchStatus::Solved;
+        total_nodes += result.search_nodes;
+    }
+
+    // Independent models of different sizes, reusing the assignments and the results of the previous batch
+    dequan::Array<dequan::CSP> models;
+    models.resize(2 * num_queen);
+    dequan::Array<const dequan::CSP*> model_ptrs;
+    for (int m_idx = 0; m_idx < (int)models.size(); m_idx++)
+    {
+        BuildQueens(models[m_idx], 1 + m_idx % num_queen);
+        model_ptrs.push_back(&models[m_idx]);
+    }
+    dequan::CSP::SolveBatch(assignments, model_ptrs, results);
+    success = success && results.results.size() == models.size();
+    for (int m_idx = 0; success && m_idx < (int)models.size(); m_idx++)
+    {
+        const int n = 1 + m_idx % num_queen;
+        const dequan::BatchResult& result = results.results[m_idx];
+        success = result.status == (n == 2 || n == 3 ? dequan::SearchStatus::Infeasible : dequan::SearchStatus::Solved);
+        for (int i = 0; success && result.status == dequan::SearchStatus::Solved && i < n; i++)
+        {
+            for (int j = i + 1; success && j < n; j++)
+            {
+                int qi = results.values[result.values_offset + i];
+                int qj = results.values[result.values_offset + j];
+                success = qi != qj && qi != qj + j - i && qi != qj + i - j;
+            }
+        }
+    }
+
+    // A raised stop flag cancels the instances not started yet
+    std::atomic<bool> stop_flag(true);
+    dequan::SearchBudget stopped_budget;
+    stopped_budget.stop_flag = &stop_flag;
+    csp.SolveBatch(assignments, fixed_offsets, fixed_vars, fixed_values, results, stopped_budget);
+    for (int i_idx = 0; success && i_idx < instance_count; i_idx++)
+    {
+        success = results.results[i_idx].status == dequan::SearchStatus::Cancelled;
+    }
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
+    std::cout << "\n" << instance_count << " instances, " << solved_count << " solved in " << total_nodes << " nodes, SolveBatch took " << time_span.count() << " seconds.\n";
+
+    return success;
+}
+
+bool PoolAllocatorTest(const int num_queen)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_queen << "-queens pool allocator test : ";
+
+    // A freed block is handed out again by the next allocation of its size class, large blocks bypass the cache
+    const int* first_block = nullptr;
+    {
+        dequan::Array<int> values(100);
+        first_block = values.data();
+    }
+    dequan::Array<int> same_class(120);
+    bool success = same_class.data() == first_block && dequan::PoolCache::GetSizeClass(1 << 20) == -1;
+
+    // A thread that frees blocks before allocating any still releases its cache when it exits
+    dequan::Array<int>* moved_values = new dequan::Array<int>(100);
+    bool registered_on_free = false;
+    std::thread free_thread([moved_values, &registered_on_free]()
+    {
+        delete moved_values;
+        registered_on_free = dequan::PoolCache::Get().registered;
+    });
+    free_thread.join();
+    success = success && registered_on_free;
+
+    // Assignments allocated from the blocks of the previous ones search the same way
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> qvars;
+    BuildNQueens(csp, num_queen, qvars);
+    csp.FinalizeModel();
+    unsigned long long nodes[2] = {};
+    for (int r_idx = 0; success && r_idx < 2; r_idx++)
+    {
+        dequan::Assignment a;
+        a.Reset(csp);
+        success = csp.Solve(a) == dequan::SearchStatus::Solved;
+        nodes[r_idx] = a.search_nodes;
+    }
+    success = success && nodes[0] == nodes[1];
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\n2 solves in " << nodes[0] << " nodes each.\n";
+
+    return success;
+}
+
+bool UserConstraintTest(const int num_vars)
+{
+    std::cout << "\n\n----------------------------\n";
+    std::cout << num_vars << "-clique user constraint test : ";
+
+    // Complete graph coloring with as many colors as vertices, every solution is a permutation
+    dequan::CSP csp;
+    dequan::Array<dequan::VarId> vars;
+    vars.resize(num_vars);
+
+    for (int i = 0; i < num_vars; i++)
+    {
+        vars[i] = csp.AddIntVar(0, num_vars);
+    }
+    for (int i = 0; i < num_vars; i++)
+    {
+        for (int j = i + 1; j < num_vars; j++)
+        {
+            csp.AddConstraint(PaddedNotEqualConstraint(vars[i], vars[j]));
+            csp.AddConstraint(dequan::OpConstraint(vars[i], vars[j], dequan::OpConstraint::Op::NotEqual, 0));
+        }
+    }
+    csp.FinalizeModel();
+
+    bool success = true;
+    for (int c_idx = 0; c_idx < (int)csp.constraints.size(); c_idx++)
+    {
+        dequan::Constraint* con = csp.constraints[c_idx];
+        success = success && con->con_id == c_idx;
+        if (con->kind == dequan::ConstraintKind::User)
+        {
+            success = success && ((uintptr_t)con % alignof(PaddedNotEqualConstraint)) == 0;
+        }
+    }
+
+    dequan::Assignment a;
+    a.Reset(csp);
+    unsigned long long solution_count = csp.CountSolutions(a);
+    unsigned long long expected_count = 1;
+    for (int i = 2; i <= num_vars; i++)
+    {
+        expected_count *= i;
+    }
+    success = success && solution_count == expected_count;
+
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    std::cout << "\nfound " << solution_count << " solutions in " << a.search_nodes << " nodes.\n";
+
+    return success;
+}
 
 int main()
 {
     OpInequalityTest();
     NQueensTest(8);
+    NQueensTest(30, dequan::VarHeuristic::Dom);
+    NQueensTest(30, dequan::VarHeuristic::DomWDeg);
+    NQueensTest(30, dequan::VarHeuristic::Activity);
+    ResumableSolveTest(12);
+    SearchLimitsTest(12);
+    RestartTest(8, 92);
+    ProfileTest(8, 92);
+    WarmStartTest(12);
+    VarBoundsTest(12);
+    ValueOrderTest(86400);
+    ModelEditTest(6, 4);
+    PresolveTest(8);
+    SerializationTest(8);
+    DomainFilteringTest(300);
+    TrailTest(20000);
+    PropagationFixpointTest(100);
+    UserConstraintTest(6);
+    LinearConstraintTest(7, 5);
+    TableConstraintTest(7, 7);
+    OptimizeTest(14);
+    AllDifferentFilteringTest(20, dequan::AllDifferentConstraint::Filtering::Value);
+    AllDifferentFilteringTest(20, dequan::AllDifferentConstraint::Filtering::Bounds);
+    AllDifferentFilteringTest(20, dequan::AllDifferentConstraint::Filtering::Domain);
+    CountSolutionsTest(8, 92);
+    CountSolutionsTest(10, 724);
+    SymmetryTest(8);
+    PortfolioTest(30, 4);
+    BatchSolveTest(8, 4);
+    PoolAllocatorTest(12);
     SudokuTest();
 }
\ No newline at end of file